@@ -6,25 +6,46 @@
 #include "execution_fsm.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "StepperMotor.hpp"
+#include "motion_controller.h"
 #include "gcode_parser.h"
 #include <string.h>
+#include <algorithm>
 #include <cmath>
 
 static const char *TAG = "EXEC_FSM";
 
+// Time for the solder to flow after a feed when there is no tip temperature
+#define EXEC_SOLDER_FLOW_MS 1000
+
+// Oldest tip reading the dwell still trusts; the sensor is read every 250 ms
+#define EXEC_TIP_SAMPLE_MAX_AGE_MS 1000
+
+// Longest a G-Code tick keeps running steps that complete immediately
+#define EXEC_GCODE_TICK_BUDGET_US 5000
+
+// Solder fed by an S command without an amount (S steps)
+#define EXEC_DEFAULT_FEED_STEPS 300
+
 extern StepperMotor* motor_x;
 extern StepperMotor* motor_y;
 extern StepperMotor* motor_z;
 extern StepperMotor* motor_s;
 extern SemaphoreHandle_t g_gcode_mutex;
+extern motion_controller_handle_t g_motion_controller;
+
+// Wire pulled back at the last lift, pushed out again before the next feed.
+// Kept across jobs: the wire stays back between them.
+static int32_t s_wire_retracted = 0;
 
 static const char* state_names[] = {
     "IDLE",
     "MOVE_TO_POINT",
+    "SETTLE",
     "MOVE_DOWN",
     "SOLDERING",
     "MOVE_UP",
@@ -32,6 +53,19 @@ static const char* state_names[] = {
     "COMPLETE"
 };
 
+static const char* gcode_step_names[] = {
+    "FETCH",
+    "RAISE_Z",
+    "TRAVEL",
+    "FINISH_TRAVEL",
+    "LOWER_Z",
+    "SETTLE",
+    "FEED",
+    "FLOW",
+    "RETRACT_Z",
+    "DWELL"
+};
+
 static inline uint32_t get_time_ms(void) {
     return (uint32_t)(esp_timer_get_time() / 1000);
 }
@@ -52,9 +86,14 @@ execution_config_t exec_sub_fsm_get_default_config(void) {
     execution_config_t config = {
         .safe_z_height = 16000,
         .soldering_z_height = 18000,
+        .z_hop = 500,
+        .z_clearance = 300,
         .home_x = 0,
         .home_y = 0,
-        .home_z = 0
+        .home_z = 0,
+        .feed_pre_advance_pct = 0,
+        .feed_time_ms = 0,
+        .feed_retract = 0
     };
     return config;
 }
@@ -70,9 +109,178 @@ void exec_sub_fsm_init(execution_sub_fsm_t* fsm, const execution_config_t* confi
         fsm->config = exec_sub_fsm_get_default_config();
     }
 
-    ESP_LOGI(TAG, "Init: safe_z=%ld, solder_z=%ld, home=(%ld,%ld,%ld)",
-             fsm->config.safe_z_height, fsm->config.soldering_z_height,
-             fsm->config.home_x, fsm->config.home_y, fsm->config.home_z);
+    ESP_LOGI(TAG, "Init: safe_z=%ld, solder_z=%ld, hop=%ld, clearance=%ld, home=(%ld,%ld,%ld)",
+             fsm->config.safe_z_height, fsm->config.soldering_z_height, fsm->config.z_hop,
+             fsm->config.z_clearance, fsm->config.home_x, fsm->config.home_y, fsm->config.home_z);
+    ESP_LOGI(TAG, "Feed: %lu%% pre-advance, main feed %lu ms, retract %ld steps",
+             fsm->config.feed_pre_advance_pct, fsm->config.feed_time_ms, fsm->config.feed_retract);
+}
+
+bool exec_sub_fsm_set_z_heights(execution_sub_fsm_t* fsm, int32_t soldering_z_height, int32_t z_hop) {
+    // Safe height has to stay on the same side of the pad as before
+    int32_t old_span = fsm->config.safe_z_height - fsm->config.soldering_z_height;
+    int32_t new_span = fsm->config.safe_z_height - soldering_z_height;
+    if (soldering_z_height < 0 || z_hop < 0 || new_span == 0 || (old_span > 0) != (new_span > 0)) {
+        ESP_LOGW(TAG, "Rejected Z heights: solder_z=%ld, hop=%ld (safe_z=%ld)",
+                 soldering_z_height, z_hop, fsm->config.safe_z_height);
+        return false;
+    }
+
+    fsm->config.soldering_z_height = soldering_z_height;
+    fsm->config.z_hop = z_hop;
+    ESP_LOGI(TAG, "Z heights: solder_z=%ld, hop=%ld", soldering_z_height, z_hop);
+    return true;
+}
+
+bool exec_sub_fsm_add_obstacle(execution_sub_fsm_t* fsm, const exec_region_t* region) {
+    if (region == NULL || region->x_max < region->x_min || region->y_max < region->y_min) {
+        ESP_LOGW(TAG, "Rejected empty obstacle region");
+        return false;
+    }
+    if (fsm->obstacle_count >= EXEC_MAX_OBSTACLES) {
+        ESP_LOGW(TAG, "Too many obstacle regions (max %d)", EXEC_MAX_OBSTACLES);
+        return false;
+    }
+
+    fsm->obstacles[fsm->obstacle_count++] = *region;
+    ESP_LOGI(TAG, "Obstacle %lu: (%.3f, %.3f) - (%.3f, %.3f)", fsm->obstacle_count,
+             coord_um_to_mm(region->x_min), coord_um_to_mm(region->y_min),
+             coord_um_to_mm(region->x_max), coord_um_to_mm(region->y_max));
+    return true;
+}
+
+void exec_sub_fsm_update_temperature(execution_sub_fsm_t* fsm, double temperature, double setpoint) {
+    if (temperature <= 0 || setpoint <= 0) {
+        return;     // Read failed or heater off: the dwell falls back to the fixed time
+    }
+
+    fsm->tip_temperature = temperature;
+    fsm->tip_setpoint = setpoint;
+    fsm->tip_sample_time = get_time_ms();
+    if (fsm->gcode_step == EXEC_GCODE_FEED || fsm->gcode_step == EXEC_GCODE_FLOW) {
+        fsm->tip_dip_min = std::min(fsm->tip_dip_min, temperature);
+    }
+}
+
+/**
+ * @brief Time to let the axes settle after they stopped at a solder point
+ *
+ * Zero when every axis ramped down to rest; otherwise the longest settle
+ * time of the axes that stopped abruptly. Each wait is logged and added
+ * to the job's settle total.
+ */
+static uint32_t settle_time_ms(execution_sub_fsm_t* fsm) {
+    const struct {
+        StepperMotor* motor;
+        const char* name;
+        uint32_t settle_ms;
+    } axes[] = {
+        { motor_x, "X", CONFIG_MOTION_SETTLE_X_MS },
+        { motor_y, "Y", CONFIG_MOTION_SETTLE_Y_MS },
+        { motor_z, "Z", CONFIG_MOTION_SETTLE_Z_MS },
+    };
+
+    uint32_t wait_ms = 0;
+    char abrupt[8] = "";
+    for (const auto& axis : axes) {
+        if (axis.motor->stoppedAbruptly()) {
+            wait_ms = std::max(wait_ms, axis.settle_ms);
+            strcat(abrupt, axis.name);
+        }
+    }
+
+    fsm->settle_count++;
+    fsm->settle_total_ms += wait_ms;
+    if (wait_ms > 0) {
+        ESP_LOGI(TAG, "Settling %lu ms after abrupt stop of %s (%lu ms in total)",
+                 wait_ms, abrupt, fsm->settle_total_ms);
+    } else {
+        ESP_LOGD(TAG, "Axes ramped down to rest, no settling");
+    }
+    return wait_ms;
+}
+
+/**
+ * @brief Push the current joint's pre-advance out as Z comes down
+ *
+ * Called right after a Z descent of z_steps has started. The wire waits on
+ * a hold in its own segment queue, so its move ends as Z lands. Wire
+ * retracted at the last lift goes out with it.
+ */
+static void start_pre_advance(execution_sub_fsm_t* fsm, uint32_t z_steps) {
+    int32_t steps = fsm->feed.pre_advance + s_wire_retracted;
+    fsm->feed_advanced = false;
+    if (steps <= 0) {
+        return;
+    }
+
+    uint32_t z_us = motor_z->moveTimeUs(z_steps, z_steps);
+    uint32_t s_us = motor_s->moveTimeUs(static_cast<uint32_t>(steps), static_cast<uint32_t>(steps));
+    uint32_t hold_us = z_us > s_us ? z_us - s_us : 0;
+
+    // Queues are idle between joints: none of these wait
+    int32_t target = motor_s->getPosition() + steps;
+    motor_s->setTargetPosition(target);
+    if ((hold_us == 0 || motor_s->queueHold(hold_us, 0)) && motor_s->queueMoveTo(target, 0)) {
+        ESP_LOGI(TAG, "Pre-advancing %ld steps during the last %lu ms of the descent", steps, s_us / 1000);
+        s_wire_retracted = 0;
+        fsm->feed_advanced = true;
+    } else {
+        ESP_LOGW(TAG, "Pre-advance rejected, feeding it at soldering height");
+    }
+}
+
+/**
+ * @brief Start the main feed of the current joint at soldering height
+ *
+ * Runs behind a pre-advance that is still going. With a feed time the
+ * cruise speed is chosen so the trapezoid takes that long: t = v/a + n/v.
+ */
+static void start_main_feed(execution_sub_fsm_t* fsm) {
+    int32_t steps = fsm->feed.feed;
+    if (!fsm->feed_advanced) {
+        steps += fsm->feed.pre_advance + s_wire_retracted;
+        s_wire_retracted = 0;
+    }
+    fsm->feed_advanced = false;
+    if (steps <= 0) {
+        return;
+    }
+
+    // S runs at the stepper defaults, nothing sets limits for it
+    stepper_motor_segment_t profile = {};
+    profile.acceleration = STEPPER_DEFAULT_ACCELERATION;
+    profile.max_velocity = 1000000.0 / STEPPER_DEFAULT_STEP_TIME_US;
+    if (fsm->feed.feed_time_ms > 0) {
+        double a = profile.acceleration;
+        double t = fsm->feed.feed_time_ms / 1000.0;
+        double discriminant = a * a * t * t - 4.0 * a * steps;
+        if (discriminant >= 0.0) {
+            profile.max_velocity = std::min(profile.max_velocity, (a * t - sqrt(discriminant)) / 2.0);
+        }
+    }
+
+    int32_t base = motor_s->isMoving() ? motor_s->getTargetPosition() : motor_s->getPosition();
+    motor_s->setTargetPosition(base + steps);
+    if (!motor_s->queueSegmentTo(base + steps, profile, 0)) {
+        ESP_LOGW(TAG, "Solder feed rejected");
+    }
+}
+
+/**
+ * @brief Pull the wire back off the tip as Z lifts after a feed
+ */
+static void start_wire_retract(const execution_sub_fsm_t* fsm) {
+    int32_t steps = fsm->feed.retract;
+    if (steps <= 0 || motor_s->isMoving()) {
+        return;
+    }
+
+    int32_t target = motor_s->getPosition() - steps;
+    motor_s->setTargetPosition(target);
+    if (motor_s->queueMoveTo(target, 0)) {
+        s_wire_retracted += steps;
+    }
 }
 
 void exec_sub_fsm_process(execution_sub_fsm_t* fsm, const solder_point_t* points, int num_points) {
@@ -105,32 +313,44 @@ void exec_sub_fsm_process(execution_sub_fsm_t* fsm, const solder_point_t* points
             bool y_reached = (motor_y->getPosition() == target->y);
             bool z_safe = (motor_z->getPosition() == fsm->config.safe_z_height);
 
-            // Test code for s axis, remove later
-            // If you see this and user have asked to clean up code, remove this
-            // or notify user to remove this test code
-            motor_s->setTargetPosition(motor_s->getPosition() + 300);
-            motor_s->stepMultipleToTarget(300);
-
+            // Moves run in the background: each tick only (re)starts idle axes.
+            // Z reaches safe height before XY travel begins.
             if (!x_reached || !y_reached || !z_safe) {
-                if (!x_reached) {
-                    motor_x->stepMultipleToTarget(static_cast<uint32_t>(std::abs(motor_x->getPosition() - motor_x->getTargetPosition())));
-                }
-                if (!y_reached) {
-                    motor_y->stepMultipleToTarget(static_cast<uint32_t>(std::abs(motor_y->getPosition() - motor_y->getTargetPosition())));
-                }
                 if (!z_safe) {
                     motor_z->stepMultipleToTarget(static_cast<uint32_t>(std::abs(motor_z->getPosition() - motor_z->getTargetPosition())));
+                } else if (!motor_z->isMoving()) {
+                    StepperMotor* const xy[] = { motor_x, motor_y };
+                    StepperMotor::stepLinearToTarget(xy, 2);
                 }
             } else {
-                vTaskDelay(pdMS_TO_TICKS(200));
-                transition_to_state(fsm, EXEC_STATE_MOVE_DOWN);
+                fsm->gcode_wait_ms = settle_time_ms(fsm);
+                transition_to_state(fsm, EXEC_STATE_SETTLE);
             }
             break;
         }
 
+        case EXEC_STATE_SETTLE:
+            // Let the axes stabilize over the point after an abrupt stop
+            if (get_time_ms() - fsm->state_enter_time >= fsm->gcode_wait_ms) {
+                transition_to_state(fsm, EXEC_STATE_MOVE_DOWN);
+            }
+            break;
+
         case EXEC_STATE_MOVE_DOWN: {
             if (!fsm->operation_in_progress) {
+                const solder_point_t* point = &points[fsm->current_point_index];
+                fsm->feed = point->solder ? point->feed : solder_feed_t{};
+                fsm->feed_advanced = false;
+
                 motor_z->setTargetPosition(fsm->config.soldering_z_height);
+                uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition() - fsm->config.soldering_z_height));
+                if (z_steps > 0) {
+                    motor_z->stepMultipleToTarget(z_steps);
+                }
+                motor_s->setEnable(true);
+                if (point->solder) {
+                    start_pre_advance(fsm, z_steps);
+                }
                 fsm->operation_in_progress = true;
             }
 
@@ -145,32 +365,17 @@ void exec_sub_fsm_process(execution_sub_fsm_t* fsm, const solder_point_t* points
         }
 
         case EXEC_STATE_SOLDERING: {
-            const solder_point_t* solder_pos = &points[fsm->current_point_index];
-            uint32_t solder_duration = solder_pos->solder_time_ms;
-
             if (!fsm->operation_in_progress) {
-                motor_s->setEnable(true);
-
-                int32_t feed_amount = solder_duration / 10;
-                fsm->solder_start_pos = motor_s->getPosition();
-                motor_s->setTargetPosition(fsm->solder_start_pos + feed_amount);
-                fsm->solder_start_time = get_time_ms();
-
+                if (points[fsm->current_point_index].solder) {
+                    start_main_feed(fsm);
+                }
                 fsm->operation_in_progress = true;
             }
 
-            uint32_t elapsed = get_time_ms() - fsm->solder_start_time;
-
-            if (elapsed < solder_duration) {
-                if (motor_s->getPosition() != motor_s->getTargetPosition()) {
-                    motor_s->stepMultipleToTarget(static_cast<uint32_t>(std::abs(motor_s->getPosition() - motor_s->getTargetPosition())));
-                }
-            } else {
-                int32_t feed_amount = motor_s->getPosition() - fsm->solder_start_pos;
-                ESP_LOGI(TAG, "Soldered: %ld steps fed in %.1fs",
-                         feed_amount, solder_duration / 1000.0f);
-                motor_s->setEnable(false);
-
+            // S keeps holding: the wire is pulled back as Z goes up
+            if (!motor_s->isMoving()) {
+                ESP_LOGI(TAG, "Soldered: %ld steps fed, %lu ms at the joint",
+                         fsm->feed.pre_advance + fsm->feed.feed, get_time_ms() - fsm->state_enter_time);
                 fsm->solder_points_completed++;
                 transition_to_state(fsm, EXEC_STATE_MOVE_UP);
             }
@@ -180,6 +385,11 @@ void exec_sub_fsm_process(execution_sub_fsm_t* fsm, const solder_point_t* points
         case EXEC_STATE_MOVE_UP: {
             if (!fsm->operation_in_progress) {
                 motor_z->setTargetPosition(fsm->config.safe_z_height);
+                uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition() - fsm->config.safe_z_height));
+                if (z_steps > 0) {
+                    motor_z->stepMultipleToTarget(z_steps);
+                }
+                start_wire_retract(fsm);
                 fsm->operation_in_progress = true;
             }
 
@@ -299,131 +509,472 @@ bool exec_sub_fsm_load_gcode_from_ram(execution_sub_fsm_t* fsm, const char* gcod
 }
 
 /**
- * @brief Execute a single GCode command
+ * @brief Enter the next G-Code execution step
  */
-static bool execute_gcode_command(execution_sub_fsm_t* fsm, const gcode_command_t* cmd) {
-    if (!cmd) return false;
+static void set_gcode_step(execution_sub_fsm_t* fsm, exec_gcode_step_t step) {
+    if (fsm->gcode_step != step) {
+        ESP_LOGD(TAG, "GCode step: %s -> %s",
+                 gcode_step_names[fsm->gcode_step], gcode_step_names[step]);
+        fsm->gcode_step = step;
+    }
+    fsm->gcode_step_enter_time = get_time_ms();
+}
 
-    switch (cmd->type) {
-        case GCODE_CMD_MOVE: {
-            // G0/G1 - Move to position with proper Z height management
-            bool has_xy_move = false;
+/**
+ * @brief Start a Z move to an absolute height without waiting for it
+ */
+static void start_z_move(int32_t height) {
+    motor_z->setTargetPosition(height);
+    uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition() - height));
+    if (z_steps > 0) {
+        motor_z->stepMultipleToTarget(z_steps);
+    }
+}
 
-            // Step 1: Move Z to safe height first (if not already there)
-            int32_t current_z = motor_z->getPosition();
-            if (current_z != fsm->config.safe_z_height) {
-                ESP_LOGI(TAG, "Moving Z to safe height: %ld steps", fsm->config.safe_z_height);
-                motor_z->setTargetPosition(fsm->config.safe_z_height);
-                uint32_t z_steps = static_cast<uint32_t>(std::abs(current_z - fsm->config.safe_z_height));
-                if (z_steps > 0) motor_z->stepMultipleToTarget(z_steps);
-            }
+/**
+ * @brief Feed profile of a G-Code S command, split as configured
+ */
+static void set_gcode_feed(execution_sub_fsm_t* fsm, const gcode_command_t* cmd) {
+    int32_t amount = cmd->has_s ? static_cast<int32_t>(cmd->s) : EXEC_DEFAULT_FEED_STEPS;
+    fsm->feed.pre_advance = static_cast<int32_t>(static_cast<int64_t>(amount) * fsm->config.feed_pre_advance_pct / 100);
+    fsm->feed.feed = amount - fsm->feed.pre_advance;
+    fsm->feed.feed_time_ms = fsm->config.feed_time_ms;
+    fsm->feed.retract = fsm->config.feed_retract;
+}
 
-            // Step 2: Move X and Y to target position
-            if (cmd->has_x) {
-                int32_t target_x = motor_x->mm_to_microsteps(cmd->x);
-                motor_x->setTargetPosition(target_x);
-                has_xy_move = true;
-            }
+/**
+ * @brief Raise Z on its own to the given height, after soldering
+ */
+static void start_retract(execution_sub_fsm_t* fsm, int32_t height) {
+    ESP_LOGI(TAG, "Moving Z back up: %ld steps", height);
+    start_z_move(height);
+    set_gcode_step(fsm, EXEC_GCODE_RETRACT_Z);
+}
 
-            if (cmd->has_y) {
-                int32_t target_y = motor_y->mm_to_microsteps(cmd->y);
-                motor_y->setTargetPosition(target_y);
-                has_xy_move = true;
-            }
+/**
+ * @brief Convert Z steps to coordinates for the motion controller
+ */
+static constexpr coord_um_t z_steps_to_um(int32_t steps) {
+    return coord_steps_to_um(steps, motion_coord::steps_per_mm_z);
+}
 
-            if (has_xy_move) {
-                ESP_LOGI(TAG, "Moving to XY: X=%.2f Y=%.2f (Z at safe height)",
-                         cmd->has_x ? cmd->x : motor_x->microsteps_to_mm(motor_x->getPosition()),
-                         cmd->has_y ? cmd->y : motor_y->microsteps_to_mm(motor_y->getPosition()));
+static constexpr int32_t z_um_to_steps(coord_um_t um) {
+    return coord_um_to_steps(um, motion_coord::steps_per_mm_z);
+}
 
-                // Execute XY movements
-                if (cmd->has_x) {
-                    uint32_t steps = static_cast<uint32_t>(std::abs(motor_x->getPosition() - motor_x->getTargetPosition()));
-                    if (steps > 0) motor_x->stepMultipleToTarget(steps);
-                }
-                if (cmd->has_y) {
-                    uint32_t steps = static_cast<uint32_t>(std::abs(motor_y->getPosition() - motor_y->getTargetPosition()));
-                    if (steps > 0) motor_y->stepMultipleToTarget(steps);
-                }
+/**
+ * @brief Z height the given distance above the pad (towards the safe height)
+ */
+static int32_t height_above_pad(const execution_sub_fsm_t* fsm, int32_t distance) {
+    bool up_is_less = fsm->config.safe_z_height < fsm->config.soldering_z_height;
+    return fsm->config.soldering_z_height + (up_is_less ? -distance : distance);
+}
 
-                // Step 3: After reaching XY position, lower Z to soldering height
-                // This prepares for the next solder feed command (S command)
-                ESP_LOGI(TAG, "Lowering Z to soldering height: %ld steps (%.2f mm)",
-                         fsm->config.soldering_z_height,
-                         motor_z->microsteps_to_mm(fsm->config.soldering_z_height));
-                motor_z->setTargetPosition(fsm->config.soldering_z_height);
-                uint32_t z_steps_down = static_cast<uint32_t>(std::abs(motor_z->getPosition() - fsm->config.soldering_z_height));
-                if (z_steps_down > 0) {
-                    motor_z->stepMultipleToTarget(z_steps_down);
-                }
+/**
+ * @brief Check whether Z height a is further from the pad than b
+ */
+static bool is_higher(const execution_sub_fsm_t* fsm, int32_t a, int32_t b) {
+    return std::abs(a - fsm->config.soldering_z_height) > std::abs(b - fsm->config.soldering_z_height);
+}
+
+/**
+ * @brief Travel height between points on the board: the Z hop, capped at the safe height
+ */
+static int32_t hop_height(const execution_sub_fsm_t* fsm) {
+    int32_t span = std::abs(fsm->config.safe_z_height - fsm->config.soldering_z_height);
+    if (fsm->config.z_hop <= 0 || fsm->config.z_hop >= span) {
+        return fsm->config.safe_z_height;
+    }
+    return height_above_pad(fsm, fsm->config.z_hop);
+}
 
-                // Wait for Z axis to stabilize at soldering position
-                vTaskDelay(pdMS_TO_TICKS(200));
-                ESP_LOGI(TAG, "Z-axis at soldering position - ready for soldering");
+/**
+ * @brief Check whether the segment from (x0, y0) to (x1, y1) touches a region
+ *
+ * Liang-Barsky clipping of the segment against the rectangle. The clip
+ * parameters are kept as fractions, so the test is exact.
+ */
+static bool segment_crosses(coord_um_t x0, coord_um_t y0, coord_um_t x1, coord_um_t y1,
+                            const exec_region_t* region) {
+    int64_t dx = static_cast<int64_t>(x1) - x0;
+    int64_t dy = static_cast<int64_t>(y1) - y0;
+    int64_t p[4] = { -dx, dx, -dy, dy };
+    int64_t q[4] = {
+        static_cast<int64_t>(x0) - region->x_min, static_cast<int64_t>(region->x_max) - x0,
+        static_cast<int64_t>(y0) - region->y_min, static_cast<int64_t>(region->y_max) - y0,
+    };
+    // t_enter = enter_num / enter_den, t_exit = exit_num / exit_den (denominators > 0)
+    int64_t enter_num = 0, enter_den = 1;
+    int64_t exit_num = 1, exit_den = 1;
+
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            if (q[i] < 0) {
+                return false;   // Parallel to this edge and outside it
             }
-            break;
+            continue;
+        }
+        int64_t num = p[i] < 0 ? -q[i] : q[i];
+        int64_t den = p[i] < 0 ? -p[i] : p[i];
+        if (p[i] < 0) {
+            if (num * enter_den > enter_num * den) {
+                enter_num = num;
+                enter_den = den;
+            }
+        } else if (num * exit_den < exit_num * den) {
+            exit_num = num;
+            exit_den = den;
+        }
+    }
+    return enter_num * exit_den <= exit_num * enter_den;
+}
+
+/**
+ * @brief Z height a travel command needs, from the end of the queued path
+ *
+ * Hops just above the board unless the straight XY path crosses a declared
+ * obstacle region, which needs the full safe height.
+ */
+static int32_t travel_height(const execution_sub_fsm_t* fsm, const gcode_command_t* cmd) {
+    position_t from = motion_controller_get_queued_position(g_motion_controller);
+    coord_um_t x = cmd->has_x ? cmd->x : from.x;
+    coord_um_t y = cmd->has_y ? cmd->y : from.y;
+
+    for (uint32_t i = 0; i < fsm->obstacle_count; i++) {
+        if (segment_crosses(from.x, from.y, x, y, &fsm->obstacles[i])) {
+            ESP_LOGI(TAG, "Travel to X=%.3f Y=%.3f crosses obstacle %lu, full retract",
+                     coord_um_to_mm(x), coord_um_to_mm(y), i + 1);
+            return fsm->config.safe_z_height;
         }
+    }
+    return hop_height(fsm);
+}
 
-        case GCODE_CMD_HOME: {
-            // G28 - Home axes
-            ESP_LOGI(TAG, "Homing axes");
-            motor_x->setTargetPosition(0);
-            motor_y->setTargetPosition(0);
-            motor_z->setTargetPosition(0);
+/**
+ * @brief Height above the pad where XY may move, or false if blending is off
+ */
+static bool get_clearance_height(const execution_sub_fsm_t* fsm, int32_t travel_z, int32_t* height) {
+    int32_t span = std::abs(travel_z - fsm->config.soldering_z_height);
+    if (fsm->config.z_clearance <= 0 || fsm->config.z_clearance >= span) {
+        return false;
+    }
+    *height = height_above_pad(fsm, fsm->config.z_clearance);
+    return true;
+}
 
-            motor_x->calibrate();
-            motor_y->calibrate();
-            motor_z->calibrate();
+/**
+ * @brief Apply a program header command (M850, M851)
+ */
+static void apply_program_setting(execution_sub_fsm_t* fsm, const gcode_command_t* cmd) {
+    if (cmd->type == GCODE_CMD_SET_Z_HEIGHTS) {
+        int32_t soldering = cmd->has_z ? z_um_to_steps(cmd->z) : fsm->config.soldering_z_height;
+        int32_t hop = cmd->has_h ? z_um_to_steps(cmd->h) : fsm->config.z_hop;
+        exec_sub_fsm_set_z_heights(fsm, soldering, hop);
+    } else {
+        exec_region_t region = { cmd->x, cmd->y, cmd->i, cmd->j };
+        exec_sub_fsm_add_obstacle(fsm, &region);
+    }
+}
+
+/**
+ * @brief Current command done, fetch the next one
+ */
+static void finish_command(execution_sub_fsm_t* fsm) {
+    fsm->has_gcode_cmd = false;
+    fsm->solder_points_completed++;
+    set_gcode_step(fsm, EXEC_GCODE_FETCH);
+}
+
+/**
+ * @brief Start the fetched command
+ *
+ * Travel moves are only queued, so a run of G0 lines blends into one path.
+ * The chain ends at the first command that is not XY travel (or at the end
+ * of the program); only then does Z go down for soldering.
+ *
+ * Between points Z only hops a little above the board; travel that crosses
+ * an obstacle region goes up to the safe height.
+ *
+ * After soldering, Z goes up with the next command. If that is travel, the
+ * lift is blended with it: XY starts as soon as Z is past the clearance
+ * height, and the chain's end brings Z back down to clearance height while
+ * XY is still arriving.
+ */
+static void start_gcode_command(execution_sub_fsm_t* fsm) {
+    const gcode_command_t* cmd = &fsm->gcode_cmd;
+    bool is_travel = (cmd->type == GCODE_CMD_MOVE) && (cmd->has_x || cmd->has_y);
+
+    // Settings take effect right away and do not end a travel chain
+    if (cmd->type == GCODE_CMD_SET_Z_HEIGHTS || cmd->type == GCODE_CMD_OBSTACLE) {
+        apply_program_setting(fsm, cmd);
+        finish_command(fsm);
+        return;
+    }
+
+    if (!is_travel && fsm->z_lower_pending) {
+        set_gcode_step(fsm, EXEC_GCODE_FINISH_TRAVEL);
+        return;
+    }
+
+    bool retract = fsm->z_retract_pending;
+    fsm->z_retract_pending = false;
+    if (retract) {
+        start_wire_retract(fsm);    // Whichever way Z goes up below
+    }
+    if (retract && !is_travel) {
+        start_retract(fsm, hop_height(fsm));
+        return;
+    }
+
+    switch (cmd->type) {
+        case GCODE_CMD_MOVE: {
+            // G0 - Z to travel height first (if not already there), then XY
+            int32_t travel_z = travel_height(fsm, cmd);
+            int32_t clear = 0;
+            if (retract && get_clearance_height(fsm, travel_z, &clear) &&
+                motion_controller_queue_lift(g_motion_controller, z_steps_to_um(travel_z),
+                                             z_steps_to_um(clear))) {
+                ESP_LOGI(TAG, "Lifting Z to travel height: %ld steps, XY from %ld steps", travel_z, clear);
+                fsm->travel_z_height = travel_z;
+                fsm->z_blended = true;
+                set_gcode_step(fsm, EXEC_GCODE_TRAVEL);
+            } else if (fsm->z_lower_pending ? is_higher(fsm, travel_z, fsm->travel_z_height)
+                                            : motor_z->getPosition() != travel_z) {
+                // A running chain stays as high as its highest move
+                ESP_LOGI(TAG, "Moving Z to travel height: %ld steps", travel_z);
+                fsm->travel_z_height = travel_z;
+                set_gcode_step(fsm, EXEC_GCODE_RAISE_Z);
+            } else {
+                if (!fsm->z_lower_pending) {
+                    fsm->travel_z_height = travel_z;
+                }
+                set_gcode_step(fsm, EXEC_GCODE_TRAVEL);
+            }
             break;
         }
 
-        case GCODE_CMD_DWELL: {
+        case GCODE_CMD_DWELL:
             // G4 - Dwell/pause
-            if (cmd->has_t) {
-                uint32_t dwell_ms = (uint32_t)(cmd->t * 1000);  // Convert seconds to ms
-                ESP_LOGI(TAG, "Dwelling for %d ms", dwell_ms);
-                vTaskDelay(pdMS_TO_TICKS(dwell_ms));
-            }
+            fsm->gcode_wait_ms = cmd->has_t ? (uint32_t)(cmd->t * 1000) : 0;  // Convert seconds to ms
+            ESP_LOGI(TAG, "Dwelling for %lu ms", fsm->gcode_wait_ms);
+            set_gcode_step(fsm, EXEC_GCODE_DWELL);
             break;
-        }
 
-        case GCODE_CMD_SET_TEMPERATURE: {
+        case GCODE_CMD_SET_TEMPERATURE:
             // M104/M109 - Set temperature
             if (cmd->has_s) {
-                ESP_LOGI(TAG, "Set temperature: %d°C (not implemented)", cmd->s);
+                ESP_LOGI(TAG, "Set temperature: %lu°C (not implemented)", cmd->s);
                 // TODO: Implement temperature control
             }
+            finish_command(fsm);
             break;
-        }
 
         case GCODE_CMD_FEED_SOLDER: {
-            // Custom - Feed solder
-            ESP_LOGI(TAG, "Feeding solder (amount: %d)", cmd->s);
+            // Custom - Feed solder; Z is already at soldering height, the
+            // pre-advance (if any) went out on the way down
+            if (!fsm->feed_advanced) {
+                set_gcode_feed(fsm, cmd);
+            }
+            ESP_LOGI(TAG, "Feeding solder (amount: %ld, %ld of it pre-advanced)",
+                     fsm->feed.pre_advance + fsm->feed.feed, fsm->feed_advanced ? fsm->feed.pre_advance : 0);
+            start_main_feed(fsm);
+            fsm->tip_dip_min = fsm->tip_temperature;
+            set_gcode_step(fsm, EXEC_GCODE_FEED);
+            break;
+        }
 
-            // Z should already be at soldering height from previous move command
-            // Feed solder wire
-            int32_t feed_amount = cmd->has_s ? cmd->s : 300;  // Use specified amount or default
-            motor_s->setTargetPosition(motor_s->getPosition() + feed_amount);
-            motor_s->stepMultipleToTarget(feed_amount);
+        default:
+            ESP_LOGW(TAG, "Unsupported command type: %d", cmd->type);
+            finish_command(fsm);
+            break;
+    }
+}
 
-            // Dwell for solder to flow
-            vTaskDelay(pdMS_TO_TICKS(1000));
+/**
+ * @brief Run one G-Code execution step
+ *
+ * @return true if the step finished and the next one can run right away,
+ *         false if it is waiting for motion or time to pass
+ */
+static bool run_gcode_step(execution_sub_fsm_t* fsm) {
+    uint32_t elapsed = get_time_ms() - fsm->gcode_step_enter_time;
+
+    switch (fsm->gcode_step) {
+        case EXEC_GCODE_FETCH: {
+            if (fsm->has_gcode_cmd) {
+                start_gcode_command(fsm);
+                return true;
+            }
 
-            // Move Z back to safe height after soldering
-            ESP_LOGI(TAG, "Moving Z back to safe height: %ld steps", fsm->config.safe_z_height);
-            motor_z->setTargetPosition(fsm->config.safe_z_height);
-            uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition() - fsm->config.safe_z_height));
-            if (z_steps > 0) motor_z->stepMultipleToTarget(z_steps);
+            gcode_parser_handle_t parser = (gcode_parser_handle_t)fsm->gcode_parser_handle;
+            if (gcode_parser_get_next_command(parser, &fsm->gcode_cmd)) {
+                ESP_LOGI(TAG, "Executing line %lu", gcode_parser_get_line_number(parser));
+                fsm->has_gcode_cmd = true;
+                start_gcode_command(fsm);
+                return true;
+            }
 
-            break;
+            // No more commands - lower Z after the last travel, then done
+            if (fsm->z_lower_pending) {
+                set_gcode_step(fsm, EXEC_GCODE_FINISH_TRAVEL);
+                return true;
+            }
+            if (fsm->z_retract_pending) {
+                fsm->z_retract_pending = false;
+                start_wire_retract(fsm);
+                start_retract(fsm, fsm->config.safe_z_height);
+                return true;
+            }
+            ESP_LOGI(TAG, "GCode execution complete (%lu ticks, worst tick %lu us, "
+                     "settled %lu ms at %lu points)", fsm->tick_count, fsm->tick_max_us,
+                     fsm->settle_total_ms, fsm->settle_count);
+            transition_to_state(fsm, EXEC_STATE_COMPLETE);
+            return false;
         }
 
+        case EXEC_GCODE_RAISE_Z:
+            // A running chain has to stop before Z goes higher
+            if (!motion_controller_try_flush(g_motion_controller) ||
+                motion_controller_is_moving(g_motion_controller)) {
+                return false;
+            }
+            if (motor_z->getPosition() != fsm->travel_z_height) {
+                start_z_move(fsm->travel_z_height);
+                return false;
+            }
+            set_gcode_step(fsm, EXEC_GCODE_TRAVEL);
+            return true;
+
+        case EXEC_GCODE_TRAVEL: {
+            const gcode_command_t* cmd = &fsm->gcode_cmd;
+            if (!(cmd->has_x || cmd->has_y)) {
+                finish_command(fsm);
+                return true;
+            }
+            if (!motion_controller_can_queue(g_motion_controller)) {
+                return false;   // Planner full, motors busy
+            }
+
+            // Consecutive travel moves blend at the corners
+            position_t target = motion_controller_get_queued_position(g_motion_controller);
+            if (cmd->has_x) {
+                target.x = cmd->x;
+            }
+            if (cmd->has_y) {
+                target.y = cmd->y;
+            }
+
+            ESP_LOGI(TAG, "Moving to XY: X=%.3f Y=%.3f (Z at travel height)",
+                     coord_um_to_mm(target.x), coord_um_to_mm(target.y));
+            if (motion_controller_queue_move(g_motion_controller, &target)) {
+                fsm->z_lower_pending = true;
+            }
+            finish_command(fsm);
+            return true;
+        }
+
+        case EXEC_GCODE_FINISH_TRAVEL: {
+            // A blended chain also starts Z down to clearance height on the way
+            int32_t clear = 0;
+            bool flushed = (fsm->z_blended && get_clearance_height(fsm, fsm->travel_z_height, &clear))
+                ? motion_controller_try_flush_approach(g_motion_controller, z_steps_to_um(clear))
+                : motion_controller_try_flush(g_motion_controller);
+            if (!flushed || motion_controller_is_moving(g_motion_controller)) {
+                return false;
+            }
+            fsm->z_lower_pending = false;
+            fsm->z_blended = false;
+
+            // After reaching XY position, lower Z to soldering height
+            // This prepares for the next solder feed command (S command)
+            ESP_LOGI(TAG, "Lowering Z to soldering height: %ld steps (%.2f mm)",
+                     fsm->config.soldering_z_height,
+                     coord_um_to_mm(z_steps_to_um(fsm->config.soldering_z_height)));
+            uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition() - fsm->config.soldering_z_height));
+            start_z_move(fsm->config.soldering_z_height);
+
+            // The command that ended the chain is already fetched: a feed
+            // starts its wire on the way down
+            if (fsm->has_gcode_cmd && fsm->gcode_cmd.type == GCODE_CMD_FEED_SOLDER) {
+                set_gcode_feed(fsm, &fsm->gcode_cmd);
+                start_pre_advance(fsm, z_steps);
+            }
+            set_gcode_step(fsm, EXEC_GCODE_LOWER_Z);
+            return true;
+        }
+
+        case EXEC_GCODE_LOWER_Z:
+            if (motor_z->isMoving()) {
+                return false;
+            }
+            fsm->gcode_wait_ms = settle_time_ms(fsm);
+            set_gcode_step(fsm, EXEC_GCODE_SETTLE);
+            return true;
+
+        case EXEC_GCODE_SETTLE:
+            // Let the axes stabilize at soldering position after an abrupt stop
+            if (elapsed < fsm->gcode_wait_ms) {
+                return false;
+            }
+            ESP_LOGI(TAG, "Z-axis at soldering position - ready for soldering");
+            set_gcode_step(fsm, EXEC_GCODE_FETCH);   // Runs the command that ended the travel
+            return true;
+
+        case EXEC_GCODE_FEED:
+            if (motor_s->isMoving()) {
+                return false;
+            }
+            set_gcode_step(fsm, EXEC_GCODE_FLOW);
+            return true;
+
+        case EXEC_GCODE_FLOW: {
+            // Dwell for solder to flow: until the tip has recovered from the
+            // heat the joint drew, within the minimum and maximum dwell
+            if (elapsed < CONFIG_SOLDERING_DWELL_MIN_MS) {
+                return false;
+            }
+            uint32_t now = get_time_ms();
+            bool sensed = fsm->tip_sample_time != 0 &&
+                          now - fsm->tip_sample_time <= EXEC_TIP_SAMPLE_MAX_AGE_MS;
+            bool fresh = sensed && fsm->tip_sample_time >= fsm->gcode_step_enter_time;
+            bool recovered = fresh && fsm->tip_temperature >=
+                             fsm->tip_setpoint * CONFIG_SOLDERING_DWELL_RECOVERY_PCT / 100.0;
+            if (!recovered && elapsed < CONFIG_SOLDERING_DWELL_MAX_MS &&
+                (sensed || elapsed < EXEC_SOLDER_FLOW_MS)) {
+                return false;
+            }
+            if (!sensed) {
+                ESP_LOGW(TAG, "No tip temperature, fixed dwell %lu ms", elapsed);
+            } else {
+                ESP_LOGI(TAG, "Dwell %lu ms: tip dipped to %.1f°C, %s %.1f°C (setpoint %.1f°C)",
+                         elapsed, fsm->tip_dip_min, recovered ? "recovered to" : "timed out at",
+                         fsm->tip_temperature, fsm->tip_setpoint);
+            }
+            // Z goes up with the next command, blended with it if that is travel
+            fsm->z_retract_pending = true;
+            finish_command(fsm);
+            return true;
+        }
+
+        case EXEC_GCODE_RETRACT_Z:
+            if (motor_z->isMoving()) {
+                return false;
+            }
+            set_gcode_step(fsm, EXEC_GCODE_FETCH);   // Runs the command that was waiting for Z
+            return true;
+
+        case EXEC_GCODE_DWELL:
+            if (elapsed < fsm->gcode_wait_ms) {
+                return false;
+            }
+            finish_command(fsm);
+            return true;
+
         default:
-            ESP_LOGW(TAG, "Unsupported command type: %d", cmd->type);
+            ESP_LOGW(TAG, "Unknown GCode step: %d", fsm->gcode_step);
+            set_gcode_step(fsm, EXEC_GCODE_FETCH);
             return false;
     }
-
-    return true;
 }
 
 /**
@@ -435,25 +986,33 @@ void exec_sub_fsm_process_gcode(execution_sub_fsm_t* fsm) {
         return;
     }
 
-    gcode_parser_handle_t parser = (gcode_parser_handle_t)fsm->gcode_parser_handle;
+    if (fsm->sub_state == EXEC_STATE_COMPLETE) {
+        return;
+    }
 
-    // Get next command
-    gcode_command_t cmd;
-    if (gcode_parser_get_next_command(parser, &cmd)) {
-        uint32_t line_num = gcode_parser_get_line_number(parser);
-        ESP_LOGI(TAG, "Executing line %d", line_num);
+    // Run steps until one has to wait, or the tick budget is used up
+    int64_t start = esp_timer_get_time();
+    while (run_gcode_step(fsm) &&
+           esp_timer_get_time() - start < EXEC_GCODE_TICK_BUDGET_US) {
+    }
 
-        // Execute command
-        if (!execute_gcode_command(fsm, &cmd)) {
-            ESP_LOGW(TAG, "Command execution failed at line %d", line_num);
-        }
+    uint32_t duration = static_cast<uint32_t>(esp_timer_get_time() - start);
+    fsm->tick_count++;
+    fsm->tick_last_us = duration;
+    if (duration > fsm->tick_max_us) {
+        fsm->tick_max_us = duration;
+    }
+}
 
-        fsm->solder_points_completed++;
-    } else {
-        // No more commands - done
-        ESP_LOGI(TAG, "GCode execution complete");
-        transition_to_state(fsm, EXEC_STATE_COMPLETE);
+const char* exec_sub_fsm_get_gcode_step_name(exec_gcode_step_t step) {
+    if (step < EXEC_GCODE_STEP_COUNT) {
+        return gcode_step_names[step];
     }
+    return "UNKNOWN";
+}
+
+uint32_t exec_sub_fsm_get_max_tick_us(const execution_sub_fsm_t* fsm) {
+    return fsm->tick_max_us;
 }
 
 /**
@@ -4,9 +4,9 @@
  *
  * Handles physical movement sequence:
  * - Move XY to solder point at safe Z height
- * - Lower Z to soldering height
- * - Feed solder wire for specified duration
- * - Raise Z to safe height
+ * - Lower Z to soldering height, pre-advancing solder wire on the way
+ * - Feed solder wire over the set time
+ * - Raise Z to safe height, pulling the wire back
  * - Return all axes to home position
  *
  * Note: Post-execution cleanup (cooldown, safety checks) handled by parent FSM
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>  // For size_t
+#include "gcode_parser.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,6 +28,8 @@ extern "C" {
  * Execution Sub-FSM States:
  * IDLE         - Initial state
  * MOVE_TO_POINT - Move XY at safe Z height
+ * SETTLE       - Let the axes settle over the point (only after an abrupt
+ *                stop, see CONFIG_MOTION_SETTLE_X_MS)
  * MOVE_DOWN    - Lower Z to soldering height
  * SOLDERING    - Feed solder wire
  * MOVE_UP      - Raise Z to safe height
@@ -36,6 +39,7 @@ extern "C" {
 typedef enum {
     EXEC_STATE_IDLE = 0,        // Waiting to start
     EXEC_STATE_MOVE_TO_POINT,   // Move XY to next point (Z safe)
+    EXEC_STATE_SETTLE,          // Wait for the axes to settle
     EXEC_STATE_MOVE_DOWN,       // Lower Z to solder position
     EXEC_STATE_SOLDERING,       // Feed solder wire
     EXEC_STATE_MOVE_UP,         // Raise Z to safe height
@@ -44,33 +48,122 @@ typedef enum {
     EXEC_STATE_COUNT
 } exec_sub_state_t;
 
+/**
+ * G-Code execution steps (one command at a time, polled every tick):
+ * FETCH         - Read the next command and start it
+ * RAISE_Z       - Z to travel height before XY travel (after a running
+ *                 travel chain, if it has to go higher)
+ * TRAVEL        - Hand the XY move to the look-ahead planner
+ * FINISH_TRAVEL - Travel chain over: flush the planner, wait for XY
+ * LOWER_Z       - Z to soldering height, pre-advancing the wire if a feed
+ *                 follows
+ * SETTLE        - Let the axes settle at soldering height (only after an
+ *                 abrupt stop, see CONFIG_MOTION_SETTLE_X_MS)
+ * FEED          - Main feed of solder wire, over the set feed time
+ * FLOW          - Let the solder flow until the tip temperature has
+ *                 recovered (see exec_sub_fsm_update_temperature())
+ * RETRACT_Z     - Z back to safe height after soldering, before a command
+ *                 that is not travel (the wire is pulled back with every
+ *                 lift after a feed)
+ * DWELL         - G4 pause
+ */
+typedef enum {
+    EXEC_GCODE_FETCH = 0,
+    EXEC_GCODE_RAISE_Z,
+    EXEC_GCODE_TRAVEL,
+    EXEC_GCODE_FINISH_TRAVEL,
+    EXEC_GCODE_LOWER_Z,
+    EXEC_GCODE_SETTLE,
+    EXEC_GCODE_FEED,
+    EXEC_GCODE_FLOW,
+    EXEC_GCODE_RETRACT_Z,
+    EXEC_GCODE_DWELL,
+    EXEC_GCODE_STEP_COUNT
+} exec_gcode_step_t;
+
+/**
+ * @brief Solder wire fed at one joint (S steps)
+ *
+ * The pre-advance runs during the last part of the Z descent, so the wire
+ * reaches the tip as it lands; the main feed runs at soldering height over
+ * feed_time_ms; the retract pulls the wire back while Z lifts, so it does
+ * not drip on the way to the next joint. The next pre-advance (or feed)
+ * first pushes the retracted wire out again.
+ */
+typedef struct {
+    int32_t pre_advance;
+    int32_t feed;                   // Main feed at soldering height
+    uint32_t feed_time_ms;          // Length of the main feed (0 = as fast as S goes)
+    int32_t retract;
+} solder_feed_t;
+
 typedef struct {
     int32_t x;
     int32_t y;
     int32_t z;
     bool solder;
-    uint32_t solder_time_ms;
+    solder_feed_t feed;
 } solder_point_t;
 
+/**
+ * @brief Obstacle region declared by the program (M851)
+ *
+ * Travel whose straight XY path crosses a region goes up to the safe height
+ * instead of hopping just above the board.
+ */
+typedef struct {
+    coord_um_t x_min;
+    coord_um_t y_min;
+    coord_um_t x_max;
+    coord_um_t y_max;
+} exec_region_t;
+
+#define EXEC_MAX_OBSTACLES 8
+
 typedef struct {
-    int32_t safe_z_height;          // Z height for XY movements (steps)
+    int32_t safe_z_height;          // Z height clear of everything (steps)
     int32_t soldering_z_height;     // Z height for soldering (steps)
+    int32_t z_hop;                  // Travel height above soldering height between points (steps, 0 = safe height)
+    int32_t z_clearance;            // Distance from soldering height where XY may move (steps, 0 = no blending)
     int32_t home_x;                 // Home X coordinate (steps)
     int32_t home_y;                 // Home Y coordinate (steps)
     int32_t home_z;                 // Home Z coordinate (steps)
+    uint32_t feed_pre_advance_pct;  // Share of each G-Code feed pushed out while Z comes down
+    uint32_t feed_time_ms;          // Length of the main feed of a G-Code joint (0 = as fast as S goes)
+    int32_t feed_retract;           // Wire pulled back while Z lifts after a feed (S steps)
 } execution_config_t;
 
 typedef struct {
     exec_sub_state_t sub_state;
     int current_point_index;
     uint32_t state_enter_time;
-    uint32_t solder_start_time;
-    int32_t solder_start_pos;
     int solder_points_completed;
     bool operation_in_progress;
     execution_config_t config;      // Configuration parameters
     void* gcode_parser_handle;      // GCode parser handle (opaque)
     bool use_gcode;                 // True if executing from GCode, false for point array
+    bool z_lower_pending;           // XY travel queued, Z goes down when the chain ends
+    bool z_retract_pending;         // Soldered, Z goes up with the next command
+    bool z_blended;                 // Travel chain started during the Z lift, Z approaches during it
+    solder_feed_t feed;             // Feed of the current joint
+    bool feed_advanced;             // Its pre-advance was started during the Z descent
+    int32_t travel_z_height;        // Z height of the current travel chain (steps)
+    exec_region_t obstacles[EXEC_MAX_OBSTACLES];
+    uint32_t obstacle_count;
+    exec_gcode_step_t gcode_step;   // Progress of the current G-Code command
+    gcode_command_t gcode_cmd;      // Command being executed
+    bool has_gcode_cmd;             // gcode_cmd is fetched but not finished
+    uint32_t gcode_step_enter_time; // get_time_ms() when gcode_step was entered
+    uint32_t gcode_wait_ms;         // Length of the current DWELL or SETTLE (of either path)
+    uint32_t settle_count;          // Stops at a solder point
+    uint32_t settle_total_ms;       // Time spent settling at them
+    double tip_temperature;         // Last tip reading (°C)
+    double tip_setpoint;            // Target temperature at that reading (°C)
+    uint32_t tip_sample_time;       // get_time_ms() of that reading (0 = none yet)
+    double tip_dip_min;             // Lowest reading since the current feed started (°C)
+    uint32_t tick_count;            // exec_sub_fsm_process_gcode() calls
+    uint32_t tick_last_us;          // Duration of the last call
+    uint32_t tick_max_us;           // Worst-case duration of a call
 } execution_sub_fsm_t;
 
 void exec_sub_fsm_init(execution_sub_fsm_t* fsm, const execution_config_t* config);
@@ -80,9 +173,48 @@ int exec_sub_fsm_get_completed_count(const execution_sub_fsm_t* fsm);
 const char* exec_sub_fsm_get_state_name(exec_sub_state_t state);
 execution_config_t exec_sub_fsm_get_default_config(void);
 
+/**
+ * @brief Set the board's soldering height and Z hop (as M850 does)
+ *
+ * @param soldering_z_height Z height for soldering (steps)
+ * @param z_hop Travel height above it between points (steps, 0 = safe height)
+ * @return false if the soldering height is not below the safe height
+ */
+bool exec_sub_fsm_set_z_heights(execution_sub_fsm_t* fsm, int32_t soldering_z_height, int32_t z_hop);
+
+/**
+ * @brief Declare an obstacle region that travel has to clear at safe height (as M851 does)
+ *
+ * @return false if the region is empty or EXEC_MAX_OBSTACLES are declared
+ */
+bool exec_sub_fsm_add_obstacle(execution_sub_fsm_t* fsm, const exec_region_t* region);
+
+/**
+ * @brief Pass a new tip temperature reading to the solder dwell
+ *
+ * FLOW ends once a reading taken during it is back to
+ * CONFIG_SOLDERING_DWELL_RECOVERY_PCT of the setpoint, no sooner than
+ * CONFIG_SOLDERING_DWELL_MIN_MS and no later than CONFIG_SOLDERING_DWELL_MAX_MS
+ * after the feed. Without readings it lasts a fixed time.
+ *
+ * @param temperature Tip temperature (°C); negative if the read failed
+ * @param setpoint Target temperature (°C)
+ */
+void exec_sub_fsm_update_temperature(execution_sub_fsm_t* fsm, double temperature, double setpoint);
+
 // GCode execution functions
 bool exec_sub_fsm_load_gcode_from_ram(execution_sub_fsm_t* fsm, const char* gcode_buffer, size_t buffer_size);
+
+/**
+ * @brief Advance G-Code execution by one tick
+ *
+ * Starts or polls the asynchronous moves of the current command and returns
+ * without waiting for them; several commands (e.g. a run of travel moves)
+ * may be handled in one call, within a bounded time budget.
+ */
 void exec_sub_fsm_process_gcode(execution_sub_fsm_t* fsm);
+const char* exec_sub_fsm_get_gcode_step_name(exec_gcode_step_t step);
+uint32_t exec_sub_fsm_get_max_tick_us(const execution_sub_fsm_t* fsm);
 void exec_sub_fsm_cleanup_gcode(execution_sub_fsm_t* fsm);
 
 #ifdef __cplusplus
@@ -73,6 +73,7 @@ static const state_transition_t state_transitions[] = {
     {FSM_STATE_IDLE, FSM_EVENT_SELECT_MANUAL, FSM_STATE_MANUAL_CONTROL},
     {FSM_STATE_IDLE, FSM_EVENT_TASK_SENT, FSM_STATE_CALIBRATION},
     {FSM_STATE_IDLE, FSM_EVENT_REQUEST_CALIBRATION, FSM_STATE_CALIBRATION},
+    {FSM_STATE_IDLE, FSM_EVENT_REQUEST_TUNING, FSM_STATE_TUNING},
 
     // From MANUAL_CONTROL
     {FSM_STATE_MANUAL_CONTROL, FSM_EVENT_EXIT_MANUAL, FSM_STATE_IDLE},
@@ -81,6 +82,10 @@ static const state_transition_t state_transitions[] = {
     {FSM_STATE_CALIBRATION, FSM_EVENT_CALIBRATION_SUCCESS, FSM_STATE_READY},
     {FSM_STATE_CALIBRATION, FSM_EVENT_CALIBRATION_ERROR, FSM_STATE_CALIBRATION_ERROR},
 
+    // From TUNING
+    {FSM_STATE_TUNING, FSM_EVENT_TUNING_DONE, FSM_STATE_IDLE},
+    {FSM_STATE_TUNING, FSM_EVENT_CALIBRATION_ERROR, FSM_STATE_CALIBRATION_ERROR},
+
     // From READY
     {FSM_STATE_READY, FSM_EVENT_CANCEL_TASK, FSM_STATE_IDLE},
     {FSM_STATE_READY, FSM_EVENT_CALIBRATION_DONE, FSM_STATE_IDLE},
@@ -120,6 +125,7 @@ static const char* state_names[] = {
     "IDLE",
     "MANUAL_CONTROL",
     "CALIBRATION",
+    "TUNING",
     "READY",
     "HEATING",
     "EXECUTING",
@@ -153,7 +159,9 @@ static const char* event_names[] = {
     "EXIT_REQUEST",
     "CONTINUE_TASK",
     "COOLDOWN_COMPLETE",
-    "COOLING_ERROR"
+    "COOLING_ERROR",
+    "REQUEST_TUNING",
+    "TUNING_DONE"
 };
 
 // Forward declarations
@@ -410,6 +418,7 @@ fsm_state_color_t fsm_controller_get_state_color(fsm_state_t state) {
             return FSM_COLOR_YELLOW;
 
         case FSM_STATE_CALIBRATION:
+        case FSM_STATE_TUNING:
         case FSM_STATE_HEATING:
         case FSM_STATE_EXECUTING:
         case FSM_STATE_NORMAL_EXIT:
@@ -27,6 +27,7 @@ typedef enum {
     FSM_STATE_IDLE,                  // Idle/standby state (Yellow)
     FSM_STATE_MANUAL_CONTROL,        // Manual control mode (Other)
     FSM_STATE_CALIBRATION,           // Calibration process (Green)
+    FSM_STATE_TUNING,                // Speed and acceleration tuning (Green)
     FSM_STATE_READY,                 // Ready to execute (Yellow)
     FSM_STATE_HEATING,               // Heating soldering iron (Green)
     FSM_STATE_EXECUTING,             // Executing soldering task (Green)
@@ -62,6 +63,8 @@ typedef enum {
     FSM_EVENT_CONTINUE_TASK,         // Continue task from pause
     FSM_EVENT_COOLDOWN_COMPLETE,     // Iron cooldown completed successfully
     FSM_EVENT_COOLING_ERROR,         // Cooling error occurred
+    FSM_EVENT_REQUEST_TUNING,        // Speed and acceleration tuning requested
+    FSM_EVENT_TUNING_DONE,           // Tuning finished, limits stored
     FSM_EVENT_COUNT                  // Total number of events
 } fsm_event_t;
 
@@ -63,10 +63,67 @@ static const char* skip_whitespace(const char* str) {
     return str;
 }
 
+// Largest integer part accepted by parse_fixed(); keeps thousandths in an int32_t
+#define GCODE_MAX_WHOLE 2000000
+
+/**
+ * @brief Parse a decimal number in thousandths (e.g. "23.25" -> 23250)
+ *
+ * Integer-only, so a coordinate in mm comes out as exact micrometres.
+ * Digits past the third decimal are rounded, the integer part is clamped
+ * to GCODE_MAX_WHOLE.
+ */
+static const char* parse_fixed(const char* ptr, int32_t* value) {
+    bool negative = false;
+    if (*ptr == '+' || *ptr == '-') {
+        negative = (*ptr == '-');
+        ptr++;
+    }
+
+    int32_t whole = 0;
+    bool digits = false;
+    while (isdigit((unsigned char)*ptr)) {
+        whole = whole * 10 + (*ptr - '0');
+        if (whole > GCODE_MAX_WHOLE) {
+            whole = GCODE_MAX_WHOLE;
+        }
+        digits = true;
+        ptr++;
+    }
+
+    int32_t frac = 0;
+    int32_t scale = 1000;
+    bool round_up = false;
+    if (*ptr == '.') {
+        ptr++;
+        while (isdigit((unsigned char)*ptr)) {
+            if (scale > 1) {
+                scale /= 10;
+                frac += (*ptr - '0') * scale;
+            } else if (scale == 1) {
+                round_up = (*ptr >= '5');
+                scale = 0;
+            }
+            digits = true;
+            ptr++;
+        }
+    }
+
+    if (!digits) {
+        return NULL;
+    }
+
+    int32_t magnitude = whole * 1000 + frac + (round_up ? 1 : 0);
+    *value = negative ? -magnitude : magnitude;
+    return ptr;
+}
+
 /**
  * @brief Parse a single parameter (e.g., X10.5, F100)
+ *
+ * @param value Parameter value in thousandths (micrometres for coordinates)
  */
-static bool parse_parameter(const char** line, char* param_char, double* value) {
+static bool parse_parameter(const char** line, char* param_char, int32_t* value) {
     const char* ptr = *line;
 
     // Get parameter letter
@@ -77,10 +134,9 @@ static bool parse_parameter(const char** line, char* param_char, double* value)
     ptr++;
 
     // Parse numeric value
-    char* end;
-    *value = strtod(ptr, &end);
+    const char* end = parse_fixed(ptr, value);
 
-    if (end == ptr) {
+    if (end == NULL) {
         // No number found
         return false;
     }
@@ -138,9 +194,21 @@ bool gcode_parser_parse_line(gcode_parser_handle_t handle, const char* line, gco
         line++;
         int m_code = atoi(line);
 
-        // All M-codes are ignored (system handles these)
-        ESP_LOGD(TAG, "Ignoring M-code M%d (handled by system)", m_code);
-        return false;  // Skip this line
+        switch (m_code) {
+            case 850:
+                cmd->type = GCODE_CMD_SET_Z_HEIGHTS;
+                break;
+            case 851:
+                cmd->type = GCODE_CMD_OBSTACLE;
+                break;
+            default:
+                // All other M-codes are ignored (system handles these)
+                ESP_LOGD(TAG, "Ignoring M-code M%d (handled by system)", m_code);
+                return false;  // Skip this line
+        }
+
+        // Skip the number
+        while (isdigit((unsigned char)*line)) line++;
     }
     else if (toupper(*line) == 'S') {
         // Custom command: S<amount> - Feed solder
@@ -175,7 +243,7 @@ bool gcode_parser_parse_line(gcode_parser_handle_t handle, const char* line, gco
         }
 
         char param_char;
-        double value;
+        int32_t value;
 
         if (parse_parameter(&line, &param_char, &value)) {
             switch (param_char) {
@@ -196,12 +264,24 @@ bool gcode_parser_parse_line(gcode_parser_handle_t handle, const char* line, gco
                 case 'F':
                     // F (feed rate) parameter is parsed but ignored (feed rates are system-configured)
                     cmd->has_f = true;
-                    cmd->f = value;
+                    cmd->f = value / 1000.0;
                     ESP_LOGD(TAG, "F parameter ignored (feed rates handled by system)");
                     break;
                 case 'S':
                     cmd->has_s = true;
-                    cmd->s = (uint32_t)value;
+                    cmd->s = value > 0 ? (uint32_t)(value / 1000) : 0;
+                    break;
+                case 'H':
+                    cmd->has_h = true;
+                    cmd->h = value;
+                    break;
+                case 'I':
+                    cmd->has_i = true;
+                    cmd->i = value;
+                    break;
+                case 'J':
+                    cmd->has_j = true;
+                    cmd->j = value;
                     break;
                 case 'T':
                 case 'P':
@@ -228,7 +308,7 @@ bool gcode_parser_validate_command(gcode_parser_handle_t handle, const gcode_com
         return false;
     }
 
-    // Basic validation - only G0 (move) and S (feed solder) are supported
+    // Basic validation - G0 (move), S (feed solder) and the M850/M851 header
     switch (cmd->type) {
         case GCODE_CMD_MOVE:
             // X and Y coordinates are required for G0 (Z is system-configured)
@@ -246,6 +326,28 @@ bool gcode_parser_validate_command(gcode_parser_handle_t handle, const gcode_com
             }
             break;
 
+        case GCODE_CMD_SET_Z_HEIGHTS:
+            if (!cmd->has_z && !cmd->has_h) {
+                ESP_LOGW(TAG, "M850 requires Z (soldering height) or H (Z hop)");
+                return false;
+            }
+            if ((cmd->has_z && cmd->z < 0) || (cmd->has_h && cmd->h < 0)) {
+                ESP_LOGW(TAG, "M850 heights must not be negative");
+                return false;
+            }
+            break;
+
+        case GCODE_CMD_OBSTACLE:
+            if (!cmd->has_x || !cmd->has_y || !cmd->has_i || !cmd->has_j) {
+                ESP_LOGW(TAG, "M851 obstacle requires X, Y, I and J");
+                return false;
+            }
+            if (cmd->i < cmd->x || cmd->j < cmd->y) {
+                ESP_LOGW(TAG, "M851 obstacle corners must be X <= I and Y <= J");
+                return false;
+            }
+            break;
+
         case GCODE_CMD_HOME:
         case GCODE_CMD_DWELL:
         case GCODE_CMD_SET_TEMPERATURE:
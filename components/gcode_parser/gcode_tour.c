@@ -0,0 +1,432 @@
+/**
+ * @file gcode_tour.c
+ * @brief Nearest-neighbour tour improved by 2-opt and Or-opt
+ *
+ * The tour is open: it starts at the configured head position, which stays
+ * fixed, and ends at whichever point comes last. The hop cost is symmetric,
+ * so reversing part of the tour leaves the cost inside it unchanged.
+ */
+
+#include "gcode_tour.h"
+#include "gcode_parser.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include "esp_timer.h"
+
+static const char *TAG = "GCODE_TOUR";
+
+// Smallest saving that counts as an improvement (s)
+#define TOUR_EPSILON_S 1e-6
+
+// Longest run of points Or-opt moves at once
+#define TOUR_OR_OPT_MAX 3
+
+/**
+ * @brief One solder point and the program text that belongs to it
+ */
+typedef struct {
+    size_t start;               // Offset of the G0 line
+    size_t end;                 // Offset past the point's last line
+    double x;
+    double y;
+} tour_point_t;
+
+/**
+ * @brief Working state of one optimization
+ */
+typedef struct {
+    tour_point_t* points;       // points[0] is the start position (no text)
+    uint32_t count;             // Solder points, not counting the start
+    uint32_t capacity;
+    uint32_t* order;            // order[0] = 0, then a permutation of 1..count
+    size_t header_end;          // Offset of the first G0 line
+    const gcode_tour_config_t* config;
+    int64_t deadline_us;
+    bool budget_exceeded;
+} tour_t;
+
+/**
+ * @brief Add a point, growing the array as needed
+ */
+static bool add_point(tour_t* tour, size_t start, double x, double y) {
+    if (tour->count + 1 >= tour->capacity) {
+        uint32_t capacity = tour->capacity ? tour->capacity * 2 : 64;
+        tour_point_t* points = (tour_point_t*)realloc(tour->points, capacity * sizeof(tour_point_t));
+        if (!points) {
+            return false;
+        }
+        tour->points = points;
+        tour->capacity = capacity;
+    }
+
+    tour_point_t* point = &tour->points[++tour->count];
+    point->start = start;
+    point->end = start;
+    point->x = x;
+    point->y = y;
+    return true;
+}
+
+/**
+ * @brief Split the program into header and points
+ *
+ * @return false if the order of the program has to be kept (or out of memory)
+ */
+static bool collect_points(tour_t* tour, const char* program, size_t length) {
+    gcode_parser_handle_t parser = gcode_parser_init();
+    if (!parser) {
+        return false;
+    }
+
+    tour->header_end = length;
+    if (!add_point(tour, 0, tour->config->start_x, tour->config->start_y)) {
+        gcode_parser_deinit(parser);
+        return false;
+    }
+    tour->count = 0;    // points[0] is the start, not a solder point
+
+    bool ok = true;
+    bool has_feed = true;       // Nothing to check before the first point
+    size_t pos = 0;
+    while (pos < length) {
+        size_t line_start = pos;
+        char line[256];
+        size_t n = 0;
+
+        while (pos < length && program[pos] != '\n' && program[pos] != '\r') {
+            if (n < sizeof(line) - 1) {
+                line[n++] = program[pos];
+            }
+            pos++;
+        }
+        if (pos < length && program[pos] == '\r') {
+            pos++;
+        }
+        if (pos < length && program[pos] == '\n') {
+            pos++;
+        }
+        line[n] = '\0';
+
+        gcode_command_t cmd;
+        if (!gcode_parser_parse_line(parser, line, &cmd)) {
+            continue;   // Comment, blank or ignored line: stays with its point
+        }
+
+        if (cmd.type == GCODE_CMD_MOVE) {
+            if (!cmd.has_x || !cmd.has_y || !has_feed) {
+                ESP_LOGI(TAG, "Travel without a feed at offset %u, keeping file order", (unsigned)line_start);
+                ok = false;
+                break;
+            }
+            if (tour->count == 0) {
+                tour->header_end = line_start;
+            } else {
+                tour->points[tour->count].end = line_start;
+            }
+            if (!add_point(tour, line_start, coord_um_to_mm(cmd.x), coord_um_to_mm(cmd.y))) {
+                ESP_LOGW(TAG, "Out of memory for points");
+                ok = false;
+                break;
+            }
+            has_feed = false;
+        } else if (cmd.type == GCODE_CMD_FEED_SOLDER) {
+            has_feed = true;
+        } else if (tour->count > 0) {
+            ESP_LOGI(TAG, "Header command after the first point, keeping file order");
+            ok = false;
+            break;
+        }
+    }
+
+    if (ok && tour->count > 0) {
+        tour->points[tour->count].end = length;
+        ok = has_feed;
+    }
+
+    gcode_parser_deinit(parser);
+    return ok;
+}
+
+/**
+ * @brief Time one axis takes to cover a distance from rest to rest
+ */
+static double axis_time(double distance, double velocity, double acceleration) {
+    if (distance * acceleration < velocity * velocity) {
+        return 2.0 * sqrt(distance / acceleration);     // Triangle: never reaches cruise
+    }
+    return distance / velocity + velocity / acceleration;
+}
+
+/**
+ * @brief Travel time between two points: the slower axis decides
+ */
+static double hop_time(const tour_t* tour, uint32_t a, uint32_t b) {
+    const tour_point_t* p = &tour->points[a];
+    const tour_point_t* q = &tour->points[b];
+    const gcode_tour_config_t* config = tour->config;
+    return fmax(axis_time(fabs(q->x - p->x), config->max_velocity_x, config->max_acceleration),
+                axis_time(fabs(q->y - p->y), config->max_velocity_y, config->max_acceleration));
+}
+
+/**
+ * @brief Time of the hop leaving tour position k (none after the last point)
+ */
+static double leg_time(const tour_t* tour, uint32_t k) {
+    return k < tour->count ? hop_time(tour, tour->order[k], tour->order[k + 1]) : 0.0;
+}
+
+static double tour_time(const tour_t* tour) {
+    double total = 0.0;
+    for (uint32_t k = 0; k < tour->count; k++) {
+        total += leg_time(tour, k);
+    }
+    return total;
+}
+
+static bool out_of_time(tour_t* tour) {
+    if (esp_timer_get_time() > tour->deadline_us) {
+        tour->budget_exceeded = true;
+    }
+    return tour->budget_exceeded;
+}
+
+static void reverse(uint32_t* items, uint32_t count) {
+    for (uint32_t i = 0, j = count - 1; i < j; i++, j--) {
+        uint32_t tmp = items[i];
+        items[i] = items[j];
+        items[j] = tmp;
+    }
+}
+
+/**
+ * @brief Greedy start: always go to the closest point not visited yet
+ *
+ * Points left when the budget runs out keep their file order.
+ */
+static void nearest_neighbour(tour_t* tour) {
+    uint32_t* order = tour->order;
+    for (uint32_t k = 1; k < tour->count; k++) {
+        if (out_of_time(tour)) {
+            return;
+        }
+        uint32_t best = k;
+        double best_time = hop_time(tour, order[k - 1], order[k]);
+        for (uint32_t j = k + 1; j <= tour->count; j++) {
+            double time = hop_time(tour, order[k - 1], order[j]);
+            if (time < best_time) {
+                best_time = time;
+                best = j;
+            }
+        }
+        uint32_t tmp = order[k];
+        order[k] = order[best];
+        order[best] = tmp;
+    }
+}
+
+/**
+ * @brief Reverse every stretch of the tour whose reversal shortens it
+ */
+static bool two_opt_pass(tour_t* tour) {
+    uint32_t* order = tour->order;
+    uint32_t n = tour->count;
+    bool improved = false;
+
+    for (uint32_t i = 1; i < n; i++) {
+        if (out_of_time(tour)) {
+            return improved;
+        }
+        for (uint32_t j = i + 1; j <= n; j++) {
+            // Reversing order[i..j] swaps the hops into i and out of j
+            double before = hop_time(tour, order[i - 1], order[i]) + leg_time(tour, j);
+            double after = hop_time(tour, order[i - 1], order[j]) +
+                           (j < n ? hop_time(tour, order[i], order[j + 1]) : 0.0);
+            if (after < before - TOUR_EPSILON_S) {
+                reverse(&order[i], j - i + 1);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+/**
+ * @brief Move order[i..i+len-1] to just after position k, optionally reversed
+ */
+static void move_run(tour_t* tour, uint32_t i, uint32_t len, uint32_t k, bool reversed) {
+    uint32_t* order = tour->order;
+    uint32_t run[TOUR_OR_OPT_MAX];
+    memcpy(run, &order[i], len * sizeof(uint32_t));
+    if (reversed) {
+        reverse(run, len);
+    }
+
+    if (k < i) {
+        memmove(&order[k + 1 + len], &order[k + 1], (i - 1 - k) * sizeof(uint32_t));
+        memcpy(&order[k + 1], run, len * sizeof(uint32_t));
+    } else {
+        memmove(&order[i], &order[i + len], (k - i - len + 1) * sizeof(uint32_t));
+        memcpy(&order[k - len + 1], run, len * sizeof(uint32_t));
+    }
+}
+
+/**
+ * @brief Move short runs of points to where they fit best
+ */
+static bool or_opt_pass(tour_t* tour) {
+    uint32_t* order = tour->order;
+    uint32_t n = tour->count;
+    bool improved = false;
+
+    for (uint32_t len = 1; len <= TOUR_OR_OPT_MAX; len++) {
+        for (uint32_t i = 1; i + len - 1 <= n; i++) {
+            if (out_of_time(tour)) {
+                return improved;
+            }
+
+            uint32_t prev = order[i - 1];
+            uint32_t first = order[i];
+            uint32_t last = order[i + len - 1];
+            bool has_next = i + len <= n;
+
+            // Saved by taking the run out and joining its neighbours
+            double removed = hop_time(tour, prev, first);
+            if (has_next) {
+                uint32_t next = order[i + len];
+                removed += hop_time(tour, last, next) - hop_time(tour, prev, next);
+            }
+
+            double best_gain = TOUR_EPSILON_S;
+            uint32_t best_k = 0;
+            bool found = false;
+            bool best_reversed = false;
+
+            for (uint32_t k = 0; k <= n; k++) {
+                if (k + 1 >= i && k <= i + len - 1) {
+                    continue;   // Hops into, inside and out of the run
+                }
+                uint32_t a = order[k];
+                bool has_b = k < n;
+                uint32_t b = has_b ? order[k + 1] : 0;
+                double base = has_b ? hop_time(tour, a, b) : 0.0;
+                double forward = hop_time(tour, a, first) + (has_b ? hop_time(tour, last, b) : 0.0) - base;
+                double backward = hop_time(tour, a, last) + (has_b ? hop_time(tour, first, b) : 0.0) - base;
+
+                if (removed - forward > best_gain) {
+                    best_gain = removed - forward;
+                    best_k = k;
+                    best_reversed = false;
+                    found = true;
+                }
+                if (len > 1 && removed - backward > best_gain) {
+                    best_gain = removed - backward;
+                    best_k = k;
+                    best_reversed = true;
+                    found = true;
+                }
+            }
+
+            if (found) {
+                move_run(tour, i, len, best_k, best_reversed);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+/**
+ * @brief Write header and points in tour order
+ */
+static char* build_program(const tour_t* tour, const char* program, size_t* out_length) {
+    size_t size = tour->header_end + 1;
+    for (uint32_t k = 1; k <= tour->count; k++) {
+        const tour_point_t* point = &tour->points[k];
+        size += point->end - point->start + 1;
+    }
+
+    char* out = (char*)malloc(size);
+    if (!out) {
+        return NULL;
+    }
+
+    size_t length = tour->header_end;
+    memcpy(out, program, tour->header_end);
+    for (uint32_t k = 1; k <= tour->count; k++) {
+        const tour_point_t* point = &tour->points[tour->order[k]];
+        size_t span = point->end - point->start;
+        memcpy(out + length, program + point->start, span);
+        length += span;
+        if (span == 0 || out[length - 1] != '\n') {
+            out[length++] = '\n';   // Last point of the file may lack a newline
+        }
+    }
+    out[length] = '\0';
+
+    *out_length = length;
+    return out;
+}
+
+char* gcode_tour_optimize(const char* program, size_t length, const gcode_tour_config_t* config,
+                          gcode_tour_result_t* result, size_t* out_length) {
+    memset(result, 0, sizeof(*result));
+    if (!program || length == 0 || !config || !out_length ||
+        config->max_velocity_x <= 0 || config->max_velocity_y <= 0 || config->max_acceleration <= 0) {
+        return NULL;
+    }
+
+    int64_t start = esp_timer_get_time();
+    tour_t tour = {
+        .config = config,
+        .deadline_us = start + (int64_t)config->budget_ms * 1000,
+    };
+
+    char* out = NULL;
+    if (!collect_points(&tour, program, length) || tour.count < 3) {
+        goto done;
+    }
+
+    tour.order = (uint32_t*)malloc((tour.count + 1) * sizeof(uint32_t));
+    if (!tour.order) {
+        ESP_LOGW(TAG, "Out of memory for %lu points", (unsigned long)tour.count);
+        goto done;
+    }
+    for (uint32_t k = 0; k <= tour.count; k++) {
+        tour.order[k] = k;
+    }
+
+    result->points = tour.count;
+    result->travel_before_s = tour_time(&tour);
+
+    nearest_neighbour(&tour);
+    while (!tour.budget_exceeded) {
+        bool improved = two_opt_pass(&tour);
+        if (!or_opt_pass(&tour) && !improved) {
+            break;
+        }
+    }
+
+    result->travel_after_s = tour_time(&tour);
+    result->budget_exceeded = tour.budget_exceeded;
+
+    if (result->travel_after_s < result->travel_before_s - TOUR_EPSILON_S) {
+        out = build_program(&tour, program, out_length);
+    }
+    if (!out) {
+        result->travel_after_s = result->travel_before_s;
+    }
+    result->reordered = out != NULL;
+
+done:
+    result->elapsed_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    if (result->points > 0) {
+        ESP_LOGI(TAG, "%lu points: travel %.2f s -> %.2f s in %lu ms%s",
+                 (unsigned long)result->points, result->travel_before_s, result->travel_after_s,
+                 (unsigned long)result->elapsed_ms, result->budget_exceeded ? " (budget used up)" : "");
+    }
+    free(tour.order);
+    free(tour.points);
+    return out;
+}
@@ -8,6 +8,13 @@
  * - G0 X<pos> Y<pos> : Move to XY position (Z/F parameters ignored)
  * - S<amount>        : Feed solder (custom command)
  *
+ * PROGRAM HEADER (custom, may also appear later to change the settings):
+ * - M850 Z<mm> H<mm> : Soldering height of this board and Z hop above it
+ *                      for travel between points (either may be omitted)
+ * - M851 X<mm> Y<mm> I<mm> J<mm>
+ *                    : Obstacle region from (X, Y) to (I, J); travel that
+ *                      crosses it goes up to the full safe height
+ *
  * IGNORED/SYSTEM-HANDLED:
  * - Z coordinates: System controls Z movement (safe, approach, contact heights)
  * - F (feed rate): System uses configured feed rates
@@ -20,6 +27,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "motion_coord.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +46,8 @@ typedef enum {
     GCODE_CMD_SET_TEMPERATURE,   // M104/M109 - Ignored (system configured)
     GCODE_CMD_HOME,              // G28 - Ignored (system handles)
     GCODE_CMD_DWELL,             // G4 - Ignored (system handles)
+    GCODE_CMD_SET_Z_HEIGHTS,     // M850 - Board soldering height and Z hop (SUPPORTED)
+    GCODE_CMD_OBSTACLE,          // M851 - Obstacle region (SUPPORTED)
     GCODE_CMD_UNKNOWN
 } gcode_command_type_t;
 
@@ -48,9 +58,14 @@ typedef enum {
  * - type: Command type (GCODE_CMD_MOVE or GCODE_CMD_FEED_SOLDER)
  * - x, y: Position coordinates (for G0 move commands)
  * - s: Solder feed amount (for S commands)
+ * - z, h: Soldering height and Z hop (for M850)
+ * - x, y, i, j: Obstacle corners (for M851)
  *
  * PARSED BUT IGNORED:
- * - z, f, t: Parsed for compatibility but not used (system-configured)
+ * - z, f, t: Parsed for compatibility but not used by G0 (system-configured)
+ *
+ * Coordinates are read straight into micrometres, without going through
+ * floating point.
  */
 typedef struct {
     gcode_command_type_t type;
@@ -60,12 +75,18 @@ typedef struct {
     bool has_f;        // Parsed but ignored
     bool has_s;
     bool has_t;        // Parsed but ignored
-    double x;          // Used: X position
-    double y;          // Used: Y position
-    double z;          // Ignored: Z is system-configured
+    bool has_h;
+    bool has_i;
+    bool has_j;
+    coord_um_t x;      // Used: X position
+    coord_um_t y;      // Used: Y position
+    coord_um_t z;      // Ignored by G0: Z is system-configured
     double f;          // Ignored: Feed rate is system-configured
     uint32_t s;        // Used: Solder feed amount
     double t;          // Ignored: Timing is system-configured
+    coord_um_t h;      // M850: Z hop above soldering height
+    coord_um_t i;      // M851: Obstacle X max
+    coord_um_t j;      // M851: Obstacle Y max
 } gcode_command_t;
 
 /**
@@ -0,0 +1,72 @@
+/**
+ * @file gcode_tour.h
+ * @brief Solder point tour optimization for uploaded programs
+ *
+ * Reorders the solder points of a program so the head travels less between
+ * them. A point is a G0 line together with the lines after it up to the
+ * next G0 (its S feed, comments, ignored codes). Lines before the first G0
+ * form the program header (M850, M851) and stay in front.
+ *
+ * The cost of a hop is the time the XY move takes: every point starts and
+ * ends at rest, and the longer of the two axis times counts, each from its
+ * own trapezoidal ramp. A nearest-neighbour tour is improved with 2-opt and
+ * Or-opt moves until no move helps or the time budget runs out.
+ *
+ * Programs whose order carries meaning are left alone: travel waypoints
+ * without a feed, or header commands after the first point.
+ */
+
+#ifndef GCODE_TOUR_H
+#define GCODE_TOUR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Machine limits and start position for the travel time model
+ */
+typedef struct {
+    double max_velocity_x;      // mm/s
+    double max_velocity_y;      // mm/s
+    double max_acceleration;    // mm/s^2
+    double start_x;             // Head position before the first point (mm)
+    double start_y;
+    uint32_t budget_ms;         // Time allowed for the whole optimization
+} gcode_tour_config_t;
+
+/**
+ * @brief What the optimization did
+ */
+typedef struct {
+    uint32_t points;            // Solder points found (0 if the order is fixed)
+    bool reordered;             // A new program was returned
+    bool budget_exceeded;       // Stopped by the time budget, not at a local optimum
+    double travel_before_s;     // Estimated XY travel time in file order
+    double travel_after_s;      // Estimated XY travel time in the returned order
+    uint32_t elapsed_ms;        // Time spent
+} gcode_tour_result_t;
+
+/**
+ * @brief Reorder the solder points of a program
+ *
+ * @param program Program text (need not be NUL-terminated)
+ * @param length Program length in bytes
+ * @param config Travel time model and time budget
+ * @param result Filled in on every call
+ * @param out_length Length of the returned program
+ * @return New program (malloc'd, NUL-terminated; caller frees), or NULL if
+ *         the file order is kept (fixed order, no gain, out of memory)
+ */
+char* gcode_tour_optimize(const char* program, size_t length, const gcode_tour_config_t* config,
+                          gcode_tour_result_t* result, size_t* out_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GCODE_TOUR_H
@@ -11,18 +11,21 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "stepper_motor_hal.h"
+#include "motion_coord.h"
+#include "motion_shaper.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief 3D position structure
+ * @brief 3D position structure (micrometres)
  */
 typedef struct {
-    double x;
-    double y;
-    double z;
+    coord_um_t x;
+    coord_um_t y;
+    coord_um_t z;
 } position_t;
 
 /**
@@ -33,14 +36,110 @@ typedef struct {
     double max_velocity_y;
     double max_velocity_z;
     double max_acceleration;
-    double steps_per_mm_x;
-    double steps_per_mm_y;
-    double steps_per_mm_z;
-    double work_area_x_max;
-    double work_area_y_max;
-    double work_area_z_max;
+    double max_jerk;                // mm/s^3, used by S-curve axes
+    double junction_deviation;      // mm, corner blending of queued moves (0 = stop at corners)
+    stepper_profile_t profile_x;
+    stepper_profile_t profile_y;
+    stepper_profile_t profile_z;
+    int32_t steps_per_mm_x;
+    int32_t steps_per_mm_y;
+    int32_t steps_per_mm_z;
+    coord_um_t work_area_x_max;
+    coord_um_t work_area_y_max;
+    coord_um_t work_area_z_max;
+    double homing_seek_velocity;    // mm/s, fast approach to the endpoint switches
+    double homing_locate_velocity;  // mm/s, slow second approach that sets the zero
+    coord_um_t homing_pull_off;     // Back-off from the switch between the two approaches
+    motion_shaper_type_t shaper;    // Input shaping of trapezoidal moves (NONE = off)
+    double shaper_frequency_x;      // Hz, ringing of the X axis (0 = not shaped)
+    double shaper_frequency_y;      // Hz, ringing of the Y axis (0 = not shaped)
+    double shaper_damping_x;        // Damping ratio of the X ringing
+    double shaper_damping_y;        // Damping ratio of the Y ringing
 } motion_controller_config_t;
 
+/**
+ * @brief Look-ahead planner counters
+ */
+typedef struct {
+    uint32_t depth;                 // Moves considered at once (CONFIG_MOTION_LOOKAHEAD_DEPTH)
+    uint32_t moves_planned;         // Moves added since init
+    uint32_t last_recalc_us;        // Time of the last replan
+    uint32_t max_recalc_us;         // Longest replan since init
+} motion_planner_stats_t;
+
+/**
+ * @brief Progress of motion_controller_start_homing()
+ */
+typedef enum {
+    MOTION_HOMING_IDLE,             // Not started
+    MOTION_HOMING_RUNNING,
+    MOTION_HOMING_DONE,             // Every axis is at its switch, positions are 0
+    MOTION_HOMING_FAILED,           // An axis did not find or release its switch
+} motion_homing_state_t;
+
+/**
+ * @brief Homing result per axis (X, Y, Z)
+ */
+typedef struct {
+    motion_homing_state_t state;
+    bool verify;                    // Started with motion_controller_start_verify()
+    uint32_t axis_ms[3];            // Start to zero of each homed axis, 0 until it is done
+    coord_um_t axis_error[3];       // Verify only: trusted position where each switch closed (0 = no lost steps)
+    uint32_t total_ms;              // Start to the last axis done (or failed)
+    int failed_axis;                // Axis that failed, -1 if none
+} motion_homing_status_t;
+
+/**
+ * @brief Outcome of the last completed verification touch
+ */
+typedef struct {
+    uint32_t count;                 // Verifications completed since boot, 0 if none
+    coord_um_t axis_error[3];       // Trusted position where each switch closed (0 = no lost steps)
+    uint32_t age_ms;                // Time since the verification finished
+} motion_verify_result_t;
+
+/**
+ * @brief Speed and acceleration limit of each axis (X, Y, Z)
+ */
+typedef struct {
+    double max_velocity[3];         // mm/s
+    double max_acceleration[3];     // mm/s^2
+} motion_axis_limits_t;
+
+/**
+ * @brief Parameters of motion_controller_start_tuning()
+ */
+typedef struct {
+    coord_um_t travel;              // Length of the test moves, clamped to the work area
+    uint32_t cycles;                // Out-and-back test moves per round
+    double step;                    // Raise of the limits per round (0.25 = +25 %)
+    uint32_t max_rounds;            // Rounds before giving up on finding a limit
+    double margin;                  // Kept below the highest clean round (0.2 = 20 %)
+    coord_um_t tolerance;           // Largest switch error that still counts as clean
+} motion_tuning_config_t;
+
+/**
+ * @brief Progress of motion_controller_start_tuning()
+ */
+typedef enum {
+    MOTION_TUNING_IDLE,             // Not started
+    MOTION_TUNING_RUNNING,
+    MOTION_TUNING_DONE,             // Limits applied and stored
+    MOTION_TUNING_FAILED,           // Homing failed, configured limits kept
+} motion_tuning_state_t;
+
+/**
+ * @brief Tuning result per axis (X, Y, Z)
+ */
+typedef struct {
+    motion_tuning_state_t state;
+    uint32_t round;                 // Rounds started so far
+    double level[3];                // Highest clean round as a factor of the configured limits, 0 if none
+    bool searching[3];              // Axis still being raised
+    motion_axis_limits_t limits;    // Limits in use once done
+    uint32_t total_ms;
+} motion_tuning_status_t;
+
 /**
  * @brief Motion controller handle
  */
@@ -57,20 +156,237 @@ motion_controller_handle_t motion_controller_init(const motion_controller_config
 void motion_controller_deinit(motion_controller_handle_t handle);
 
 /**
- * @brief Move to absolute position
+ * @brief Move to absolute position along a straight line (non-blocking)
+ *
+ * X, Y and Z are stepped together under one velocity profile and arrive at
+ * the same time, so a diagonal takes as long as its longest axis rather than
+ * the sum of the axes. The speed is the highest one at which no axis exceeds
+ * its configured velocity and acceleration.
+ *
+ * @return true if the move was started, false if the target is outside the
+ *         work area or an axis is still moving
  */
 bool motion_controller_move_to(motion_controller_handle_t handle, const position_t* target);
 
+/**
+ * @brief Add a straight move to the look-ahead planner
+ *
+ * Consecutive queued moves are blended: the planner picks the highest
+ * speed at each corner allowed by the junction deviation and by the
+ * acceleration available to slow down before the end of the queue. Moves
+ * are handed to the motors once the look-ahead buffer is full; call
+ * motion_controller_flush() after the last one of a chain.
+ *
+ * @return false if the target is outside the work area or a motor rejected
+ *         a planned move
+ *
+ * @note Keep feeding moves (or flush) while the chain runs: a motor whose
+ *       queue runs dry mid-chain stops without decelerating.
+ */
+bool motion_controller_queue_move(motion_controller_handle_t handle, const position_t* target);
+
+/**
+ * @brief Hand all queued moves to the motors, the last one ending at rest
+ *
+ * Does not wait for the moves to finish; see motion_controller_wait_move_done().
+ */
+bool motion_controller_flush(motion_controller_handle_t handle);
+
+/**
+ * @brief Check whether motion_controller_queue_move() would return at once
+ *
+ * False while the next move would fill the look-ahead buffer and its oldest
+ * move cannot be handed to the motors without waiting for queue space (or for the axes
+ * to stop, before a move that has to start from rest).
+ */
+bool motion_controller_can_queue(motion_controller_handle_t handle);
+
+/**
+ * @brief Non-blocking motion_controller_flush() for callers that poll
+ *
+ * Hands over as many queued moves as possible without waiting. Once all
+ * of them are handed over and the axes have stopped, the stream ends: a
+ * move started after it does not count as running the queue dry.
+ *
+ * @return true once every queued move has been handed to the motors
+ */
+bool motion_controller_try_flush(motion_controller_handle_t handle);
+
+/**
+ * @brief Raise Z to travel height and let XY travel start at clearance height
+ *
+ * Queues the Z move and holds X and Y for exactly as long as Z's ramp
+ * takes to pass clear_z, so travel queued next with
+ * motion_controller_queue_move() starts while Z is still rising. Finish the
+ * travel chain with motion_controller_try_flush_approach().
+ *
+ * @param travel_z Travel height
+ * @param clear_z Lowest height at which XY may move, between the current
+ *                height and travel_z
+ * @return false if the lift cannot be blended (RMT backend, moves still
+ *         queued or running, clear_z not on the way); nothing was queued
+ */
+bool motion_controller_queue_lift(motion_controller_handle_t handle, coord_um_t travel_z, coord_um_t clear_z);
+
+/**
+ * @brief Non-blocking flush that also brings Z down to clearance height
+ *
+ * After a motion_controller_queue_lift(), Z is sent down to clear_z with a
+ * hold in front of the descent, timed so Z arrives at clear_z as X and Y
+ * arrive. Z never goes below clear_z here; the rest of the way down is up
+ * to the caller once the axes have stopped. Without a lift this is
+ * motion_controller_try_flush().
+ *
+ * @return true once every queued move has been handed to the motors
+ */
+bool motion_controller_try_flush_approach(motion_controller_handle_t handle, coord_um_t clear_z);
+
+/**
+ * @brief Read the look-ahead planner counters
+ */
+void motion_controller_get_planner_stats(motion_controller_handle_t handle, motion_planner_stats_t* stats);
+
+/**
+ * @brief Block until all axes have stopped
+ *
+ * @param timeout_ms Maximum time to wait
+ * @return true if every axis is idle, false on timeout
+ */
+bool motion_controller_wait_move_done(motion_controller_handle_t handle, uint32_t timeout_ms);
+
 /**
  * @brief Get current position
  */
 position_t motion_controller_get_position(motion_controller_handle_t handle);
 
 /**
- * @brief Home all axes
+ * @brief Get the position at the end of the last queued move
+ *
+ * Same as motion_controller_get_position() when nothing is queued.
+ */
+position_t motion_controller_get_queued_position(motion_controller_handle_t handle);
+
+/**
+ * @brief Start homing X, Y and Z together (non-blocking)
+ *
+ * Every axis seeks its endpoint switch at the homing seek speed, backs off
+ * by the pull-off distance and approaches again at the locate speed; the
+ * switch closing on that second approach is position 0. The axes go
+ * through the phases independently, so the total takes as long as the
+ * slowest axis. Drive it with motion_controller_poll_homing().
+ *
+ * @return false if an axis is moving or moves are still queued
+ */
+bool motion_controller_start_homing(motion_controller_handle_t handle);
+
+/**
+ * @brief Re-zero axes whose position is still trusted (non-blocking)
+ *
+ * Skips the long seek of a full homing: every axis goes fast to the
+ * pull-off distance, where its switch should just be open, and touches
+ * the switch at the locate speed. The zero is set again from that touch
+ * and axis_error in the status reports how far from the trusted 0 each
+ * switch closed. An axis whose switch closes early backs off and locates
+ * as in a full homing. Driven by motion_controller_poll_homing().
+ *
+ * @return false if an axis is not trusted (see motion_controller_is_homed()),
+ *         is moving or moves are still queued
+ */
+bool motion_controller_start_verify(motion_controller_handle_t handle);
+
+/**
+ * @brief Check whether X, Y and Z still count from the last homing
+ *
+ * Lost when a motor is disabled, a move is aborted (emergency stop), a
+ * switch is found where the position says it is not, homing fails, and on
+ * reboot (unless CONFIG_MOTION_HOME_SURVIVES_RESTART kept it).
+ */
+bool motion_controller_is_homed(motion_controller_handle_t handle);
+
+/**
+ * @brief Get the per-axis error found by the last verification touch
+ *
+ * Kept until the next motion_controller_start_verify() completes, so a
+ * check at the end of a job can be read back while the machine idles.
+ *
+ * @return false if no verification has completed since boot
+ */
+bool motion_controller_get_last_verify(motion_controller_handle_t handle, motion_verify_result_t* result);
+
+/**
+ * @brief Record that the homed axes rest at position 0, or not any more
+ *
+ * With CONFIG_MOTION_HOME_SURVIVES_RESTART the record is kept in RTC
+ * memory, and after a software restart the axes start out trusted.
+ * Ignored when the axes are not homed. Clear it before moving again.
+ */
+void motion_controller_set_parked(motion_controller_handle_t handle, bool parked);
+
+/**
+ * @brief Advance homing and report its progress
+ *
+ * Starts the next phase of every axis whose previous one has ended. Call
+ * it periodically until it returns MOTION_HOMING_DONE or
+ * MOTION_HOMING_FAILED; a failure stops all axes.
+ *
+ * @param status Filled in with the per-axis times (may be NULL)
+ */
+motion_homing_state_t motion_controller_poll_homing(motion_controller_handle_t handle,
+                                                    motion_homing_status_t* status);
+
+/**
+ * @brief Home all axes, blocking until done
+ *
+ * motion_controller_start_homing() and motion_controller_poll_homing() in
+ * a loop.
  */
 bool motion_controller_home(motion_controller_handle_t handle);
 
+/**
+ * @brief Get the speed and acceleration limits moves are planned with
+ *
+ * The configured ones, or the tuned ones stored in NVS if they were made
+ * for the same steps per mm.
+ */
+void motion_controller_get_limits(motion_controller_handle_t handle, motion_axis_limits_t* limits);
+
+/**
+ * @brief Plan moves with other speed and acceleration limits
+ *
+ * @param limits New limits, every one positive
+ * @param persist Store them in NVS so they are used after a restart
+ * @return false if a limit is not positive, moves are queued or an axis is moving
+ */
+bool motion_controller_set_limits(motion_controller_handle_t handle, const motion_axis_limits_t* limits,
+                                  bool persist);
+
+/**
+ * @brief Find the highest reliable limits of each axis (non-blocking)
+ *
+ * Homes first unless the position is trusted. Every round runs out-and-back
+ * test moves on each axis still being searched, with the configured limits
+ * raised by step per round, then touches the switches as in
+ * motion_controller_start_verify(). An axis whose switch is off by more
+ * than the tolerance, or whose touch fails, keeps the last clean round.
+ * The limits of that round less the margin are applied and stored in NVS.
+ * Driven by motion_controller_poll_tuning().
+ *
+ * @return false if the parameters are invalid, an axis is moving or moves
+ *         are still queued
+ */
+bool motion_controller_start_tuning(motion_controller_handle_t handle, const motion_tuning_config_t* config);
+
+/**
+ * @brief Advance tuning and report its progress
+ *
+ * Call it periodically until it returns MOTION_TUNING_DONE or
+ * MOTION_TUNING_FAILED. The axes end at their switches, zeroed.
+ *
+ * @param status Filled in with the rounds and levels so far (may be NULL)
+ */
+motion_tuning_state_t motion_controller_poll_tuning(motion_controller_handle_t handle,
+                                                    motion_tuning_status_t* status);
+
 /**
  * @brief Check if position is within work area
  */
@@ -0,0 +1,114 @@
+/**
+ * @file motion_shaper.h
+ * @brief ZV / ZVD input shaping of planned moves
+ *
+ * An input shaper is a short train of impulses whose responses cancel at
+ * one resonance: convolving a velocity profile with it leaves a motion
+ * that no longer excites the gantry's ringing at that frequency. A move
+ * gets longer by the length of the train (half a ringing period for ZV, a
+ * full one for ZVD), but acceleration can be raised without the tip
+ * oscillating once the move ends.
+ *
+ * A planned move is a trapezoid in path speed. Its shaped version is still
+ * piecewise linear in speed, so it is handed out as a list of pieces with
+ * constant acceleration, each of which the step generator runs as one
+ * queued segment. Entry and exit speeds are kept, so shaped moves blend at
+ * the same junction speeds as unshaped ones. Direction changes at the
+ * junctions themselves are left to the junction deviation.
+ *
+ * Pure arithmetic, no motor access; the host tool tools/shaper_sim uses it
+ * as it is.
+ */
+
+#ifndef MOTION_SHAPER_H
+#define MOTION_SHAPER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Two shapers combined: up to three impulses each
+#define MOTION_SHAPER_MAX_IMPULSES 9
+
+// Corners of a trapezoid times the impulses, less one
+#define MOTION_SHAPER_MAX_PIECES (4 * MOTION_SHAPER_MAX_IMPULSES - 1)
+
+/**
+ * @brief Shaper kind
+ */
+typedef enum {
+    MOTION_SHAPER_NONE,             // Single impulse, profiles pass unchanged
+    MOTION_SHAPER_ZV,               // Two impulses, half a period long
+    MOTION_SHAPER_ZVD,              // Three impulses, one period; tolerates a mistuned frequency
+} motion_shaper_type_t;
+
+/**
+ * @brief Impulse train, first impulse at 0 and amplitudes summing to 1
+ */
+typedef struct {
+    uint32_t count;
+    double amplitude[MOTION_SHAPER_MAX_IMPULSES];
+    double time[MOTION_SHAPER_MAX_IMPULSES];    // s, ascending
+} motion_shaper_t;
+
+/**
+ * @brief Stretch of a shaped move with constant acceleration
+ */
+typedef struct {
+    double duration;                // s
+    double start_speed;             // mm/s
+    double end_speed;               // mm/s
+} motion_shaper_piece_t;
+
+/**
+ * @brief Build the shaper for a resonance
+ *
+ * @param type Shaper kind; NONE (or a frequency of 0) gives a single impulse
+ * @param frequency Ringing frequency in Hz
+ * @param damping Damping ratio of the ringing (0.1 = 10 %), below 1
+ */
+void motion_shaper_init(motion_shaper_t* shaper, motion_shaper_type_t type, double frequency, double damping);
+
+/**
+ * @brief Shaper that cancels the resonances of both a and b
+ *
+ * The convolution of the two trains, with coinciding impulses merged.
+ */
+void motion_shaper_combine(const motion_shaper_t* a, const motion_shaper_t* b, motion_shaper_t* out);
+
+/**
+ * @brief Length of the impulse train in s
+ */
+static inline double motion_shaper_duration(const motion_shaper_t* shaper) {
+    return shaper->time[shaper->count - 1];
+}
+
+/**
+ * @brief Most pieces motion_shaper_plan() splits a move into
+ */
+static inline uint32_t motion_shaper_max_pieces(const motion_shaper_t* shaper) {
+    return 4 * shaper->count - 1;
+}
+
+/**
+ * @brief Shaped speed profile of one move
+ *
+ * The trapezoid from entry_speed to exit_speed under nominal_speed and
+ * acceleration is planned short by what the shaper's delay adds, then
+ * convolved with the shaper, so the pieces cover exactly length.
+ *
+ * @param pieces Room for MOTION_SHAPER_MAX_PIECES pieces
+ * @return Number of pieces, 0 if the move is too short to be shaped
+ *         between its entry and exit speed
+ */
+uint32_t motion_shaper_plan(const motion_shaper_t* shaper, double length, double entry_speed,
+                            double nominal_speed, double exit_speed, double acceleration,
+                            motion_shaper_piece_t* pieces);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_SHAPER_H
@@ -7,9 +7,1573 @@
 
 #include "motion_controller.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "StepperMotor.hpp"
+#include "stepper_accel_table.hpp"
+#include "motion_planner.h"
+#include "motion_shaper.h"
+
+static const char *TAG = "MOTION_CTRL";
+
+#if CONFIG_MOTION_HOME_SURVIVES_RESTART
+// Set while every axis rests homed at 0. RTC memory keeps it through
+// esp_restart(), not through power loss.
+#define MOTION_PARKED_MAGIC 0x484F4D45
+static RTC_NOINIT_ATTR uint32_t s_parked_magic;
+#endif
+
+// Longest wait for room in a motor's segment queue or for the axes to stop
+#define MOTION_QUEUE_TIMEOUT_MS 120000
+
+// Tuned limits in NVS; ignored when the steps per mm have changed since
+#define MOTION_NVS_NAMESPACE "motion"
+#define MOTION_NVS_LIMITS_KEY "limits"
+#define MOTION_NVS_LIMITS_VERSION 1
+
+// Global motor instances (defined in main.cpp)
+extern StepperMotor* motor_x;
+extern StepperMotor* motor_y;
+extern StepperMotor* motor_z;
+
+/**
+ * @brief Trapezoid ramps for the Kconfig limits, generated at compile time
+ *
+ * Kept in DRAM so the step ISR never reads flash. A motor whose runtime
+ * acceleration differs from Kconfig computes its intervals instead.
+ */
+using stepper_table::AccelTable;
+using stepper_table::makeAccelTable;
+
+DRAM_ATTR static constexpr AccelTable<STEPPER_ACCEL_TABLE_POINTS> accel_table_x =
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(
+        1.0 * CONFIG_MOTION_MAX_ACCELERATION_MM_S2 * CONFIG_MOTOR_X_MICROSTEPS_IN_MM,
+        1.0 * CONFIG_MOTION_MAX_VELOCITY_X_MM_S * CONFIG_MOTOR_X_MICROSTEPS_IN_MM);
+DRAM_ATTR static constexpr AccelTable<STEPPER_ACCEL_TABLE_POINTS> accel_table_y =
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(
+        1.0 * CONFIG_MOTION_MAX_ACCELERATION_MM_S2 * CONFIG_MOTOR_Y_MICROSTEPS_IN_MM,
+        1.0 * CONFIG_MOTION_MAX_VELOCITY_Y_MM_S * CONFIG_MOTOR_Y_MICROSTEPS_IN_MM);
+DRAM_ATTR static constexpr AccelTable<STEPPER_ACCEL_TABLE_POINTS> accel_table_z =
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(
+        1.0 * CONFIG_MOTION_MAX_ACCELERATION_MM_S2 * CONFIG_MOTOR_Z_MICROSTEPS_IN_MM,
+        1.0 * CONFIG_MOTION_MAX_VELOCITY_Z_MM_S * CONFIG_MOTOR_Z_MICROSTEPS_IN_MM);
+
+static constexpr stepper_accel_table_t accel_view_x = accel_table_x.view();
+static constexpr stepper_accel_table_t accel_view_y = accel_table_y.view();
+static constexpr stepper_accel_table_t accel_view_z = accel_table_z.view();
+
+/**
+ * @brief Phase of one axis while homing
+ */
+typedef enum {
+    HOMING_SEEK,                        // Fast approach to the switch
+    HOMING_BACK_OFF,                    // Pull-off until the switch opens
+    HOMING_LOCATE,                      // Slow approach that sets the zero
+    HOMING_DONE,
+    HOMING_FAILED,
+} homing_phase_t;
+
+typedef struct {
+    homing_phase_t phase;
+    uint32_t remaining;                 // Steps the current approach may still travel
+    int32_t burst_start;                // Position when the last seek was started
+    bool touched;                       // Verification: switch found, axis_error recorded
+} homing_axis_t;
+
+/**
+ * @brief Step of a tuning round
+ */
+typedef enum {
+    TUNING_HOME,                        // Full homing before the next round
+    TUNING_MOVES,                       // Test moves at the raised limits
+    TUNING_VERIFY,                      // Switch touch after the test moves
+} tuning_phase_t;
+
+/**
+ * @brief Limits as kept in NVS
+ */
+typedef struct {
+    uint32_t version;
+    int32_t steps_per_mm[MOTION_PLANNER_AXES];
+    motion_axis_limits_t limits;
+} stored_limits_t;
+
 /**
  * @brief Internal structure for motion controller handle
  */
 struct motion_controller_handle_s {
-    
+    motion_controller_config_t config;
+    motion_planner_limits_t limits;
+    motion_planner_t planner;
+    int32_t steps_per_mm[MOTION_PLANNER_AXES];  // Coordinate to step factors
+    bool emitted_isolated;              // Last move handed to the motors runs from rest to rest
+    bool streaming;                     // Motors have planned moves in their queues
+    bool z_blend;                       // Z lift queued, approach still to come; Z takes no holds
+    int64_t timeline_us[MOTION_PLANNER_AXES];   // esp_timer time each axis runs out of queued work
+    bool timeline_valid;                // timeline_us is exact (no S-curve move since the lift)
+    motion_planner_stats_t stats;
+    homing_axis_t homing[MOTION_PLANNER_AXES];
+    motion_homing_status_t homing_status;
+    int64_t homing_start_us;
+    bool homing_verify;                 // Trusted axes: seek only to the pull-off, then touch
+    motion_verify_result_t last_verify;
+    int64_t last_verify_us;             // esp_timer time the last verification finished
+    motion_tuning_config_t tuning_config;
+    motion_tuning_status_t tuning_status;
+    tuning_phase_t tuning_phase;
+    double tuning_test[MOTION_PLANNER_AXES];    // Factor of the configured limits under test
+    uint32_t tuning_moves[MOTION_PLANNER_AXES]; // Test moves still to run this round
+    int64_t tuning_start_us;
+    motion_shaper_t shapers[4];         // By the X/Y bits of a move's axis mask: none, X, Y, both
+    motion_shaper_piece_t pieces[MOTION_SHAPER_MAX_PIECES];     // emit_block(), too big for the FSM task's stack
 };
+
+static StepperMotor* axis_motor(int axis) {
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    return axes[axis];
+}
+
+/**
+ * @brief Push per-axis speed and acceleration limits down to the motors
+ *
+ * Every move planned by a motor afterwards uses a trapezoidal profile
+ * (triangular when the move is too short to reach cruise speed) built
+ * from these limits, or a jerk-limited S-curve for axes that select it.
+ */
+static void apply_axis_limits(motion_controller_handle_t handle) {
+    const motion_controller_config_t* config = &handle->config;
+    const stepper_profile_t profiles[] = { config->profile_x, config->profile_y, config->profile_z };
+    const stepper_accel_table_t* const tables[] = { &accel_view_x, &accel_view_y, &accel_view_z };
+
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        StepperMotor* motor = axis_motor(axis);
+        if (motor) {
+            motor->setMotionLimits(handle->limits.max_velocity[axis], handle->limits.max_acceleration[axis]);
+            motor->setMotionProfile(profiles[axis], config->max_jerk);
+            motor->setAccelTable(tables[axis]);
+        }
+    }
+}
+
+/**
+ * @brief Limits from the configuration, before any tuning
+ */
+static void config_limits(const motion_controller_config_t* config, motion_axis_limits_t* limits) {
+    limits->max_velocity[0] = config->max_velocity_x;
+    limits->max_velocity[1] = config->max_velocity_y;
+    limits->max_velocity[2] = config->max_velocity_z;
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        limits->max_acceleration[axis] = config->max_acceleration;
+    }
+}
+
+static bool limits_valid(const motion_axis_limits_t* limits) {
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        if (!(limits->max_velocity[axis] > 0) || !(limits->max_acceleration[axis] > 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Plan and run moves with these limits from now on
+ */
+static void use_limits(motion_controller_handle_t handle, const motion_axis_limits_t* limits) {
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        handle->limits.max_velocity[axis] = limits->max_velocity[axis];
+        handle->limits.max_acceleration[axis] = limits->max_acceleration[axis];
+    }
+    apply_axis_limits(handle);
+}
+
+/**
+ * @brief Read tuned limits from NVS
+ *
+ * @return false if none are stored or they were tuned for other steps per mm
+ */
+static bool load_limits(motion_controller_handle_t handle, motion_axis_limits_t* limits) {
+    nvs_handle_t nvs;
+    if (nvs_open(MOTION_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+
+    stored_limits_t stored;
+    size_t size = sizeof(stored);
+    esp_err_t err = nvs_get_blob(nvs, MOTION_NVS_LIMITS_KEY, &stored, &size);
+    nvs_close(nvs);
+    if (err != ESP_OK || size != sizeof(stored) || stored.version != MOTION_NVS_LIMITS_VERSION ||
+        !limits_valid(&stored.limits)) {
+        return false;
+    }
+    if (memcmp(stored.steps_per_mm, handle->steps_per_mm, sizeof(stored.steps_per_mm)) != 0) {
+        ESP_LOGW(TAG, "Stored limits were tuned for other steps per mm, ignored");
+        return false;
+    }
+
+    *limits = stored.limits;
+    return true;
+}
+
+static bool store_limits(motion_controller_handle_t handle, const motion_axis_limits_t* limits) {
+    stored_limits_t stored = {};
+    stored.version = MOTION_NVS_LIMITS_VERSION;
+    memcpy(stored.steps_per_mm, handle->steps_per_mm, sizeof(stored.steps_per_mm));
+    stored.limits = *limits;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MOTION_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, MOTION_NVS_LIMITS_KEY, &stored, sizeof(stored));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store limits: %s", esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+motion_controller_handle_t motion_controller_init(const motion_controller_config_t* config) {
+    if (config == NULL) {
+        ESP_LOGE(TAG, "Configuration is NULL");
+        return NULL;
+    }
+
+    if (config->max_velocity_x <= 0 || config->max_velocity_y <= 0 ||
+        config->max_velocity_z <= 0 || config->max_acceleration <= 0) {
+        ESP_LOGE(TAG, "Velocity and acceleration limits must be positive");
+        return NULL;
+    }
+
+    if (config->steps_per_mm_x <= 0 || config->steps_per_mm_y <= 0 || config->steps_per_mm_z <= 0) {
+        ESP_LOGE(TAG, "Steps per mm must be positive");
+        return NULL;
+    }
+
+    if (config->homing_seek_velocity <= 0 || config->homing_locate_velocity <= 0 ||
+        config->homing_pull_off <= 0) {
+        ESP_LOGE(TAG, "Homing speeds and pull-off must be positive");
+        return NULL;
+    }
+
+    bool uses_s_curve = config->profile_x == STEPPER_PROFILE_S_CURVE ||
+                        config->profile_y == STEPPER_PROFILE_S_CURVE ||
+                        config->profile_z == STEPPER_PROFILE_S_CURVE;
+    if (uses_s_curve && config->max_jerk <= 0) {
+        ESP_LOGE(TAG, "S-curve axes need a positive jerk limit");
+        return NULL;
+    }
+
+    motion_controller_handle_t handle =
+        static_cast<motion_controller_handle_t>(calloc(1, sizeof(struct motion_controller_handle_s)));
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for motion controller handle");
+        return NULL;
+    }
+
+    handle->config = *config;
+
+    handle->limits.steps_per_mm[0] = config->steps_per_mm_x;
+    handle->limits.steps_per_mm[1] = config->steps_per_mm_y;
+    handle->limits.steps_per_mm[2] = config->steps_per_mm_z;
+    handle->steps_per_mm[0] = config->steps_per_mm_x;
+    handle->steps_per_mm[1] = config->steps_per_mm_y;
+    handle->steps_per_mm[2] = config->steps_per_mm_z;
+    handle->limits.junction_deviation = config->junction_deviation;
+    handle->limits.s_curve[0] = config->profile_x == STEPPER_PROFILE_S_CURVE;
+    handle->limits.s_curve[1] = config->profile_y == STEPPER_PROFILE_S_CURVE;
+    handle->limits.s_curve[2] = config->profile_z == STEPPER_PROFILE_S_CURVE;
+    handle->stats.depth = MOTION_PLANNER_DEPTH;
+    handle->homing_status.failed_axis = -1;
+
+    motion_axis_limits_t limits;
+    if (load_limits(handle, &limits)) {
+        ESP_LOGI(TAG, "Using tuned limits: X %.0f, Y %.0f, Z %.0f mm/s, %.0f/%.0f/%.0f mm/s^2",
+                 limits.max_velocity[0], limits.max_velocity[1], limits.max_velocity[2],
+                 limits.max_acceleration[0], limits.max_acceleration[1], limits.max_acceleration[2]);
+    } else {
+        config_limits(config, &limits);
+    }
+    use_limits(handle, &limits);
+
+    motion_shaper_init(&handle->shapers[0], MOTION_SHAPER_NONE, 0.0, 0.0);
+    motion_shaper_init(&handle->shapers[1], config->shaper, config->shaper_frequency_x, config->shaper_damping_x);
+    motion_shaper_init(&handle->shapers[2], config->shaper, config->shaper_frequency_y, config->shaper_damping_y);
+    if (config->shaper_frequency_x == config->shaper_frequency_y &&
+        config->shaper_damping_x == config->shaper_damping_y) {
+        handle->shapers[3] = handle->shapers[1];    // One resonance: shaping it once is enough
+    } else {
+        motion_shaper_combine(&handle->shapers[1], &handle->shapers[2], &handle->shapers[3]);
+    }
+    if (handle->shapers[3].count > 1) {
+        ESP_LOGI(TAG, "Input shaping: X %.1f Hz, Y %.1f Hz, XY moves %.1f ms longer",
+                 config->shaper_frequency_x, config->shaper_frequency_y,
+                 motion_shaper_duration(&handle->shapers[3]) * 1000.0);
+    }
+#if !CONFIG_STEPPER_BACKEND_RMT
+    for (int i = 1; i < 4; i++) {
+        // Room for two shaped moves, see block_shaper()
+        uint32_t slots = 2 * motion_shaper_max_pieces(&handle->shapers[i]);
+        if (handle->shapers[i].count > 1 && slots > CONFIG_STEPPER_SEGMENT_QUEUE_LEN) {
+            ESP_LOGW(TAG, "Shaped %s moves need %lu queue slots, only %d: they run unshaped",
+                     i == 3 ? "XY" : (i == 1 ? "X" : "Y"), slots, CONFIG_STEPPER_SEGMENT_QUEUE_LEN);
+        }
+    }
+#endif
+
+#if CONFIG_MOTION_HOME_SURVIVES_RESTART
+    if (s_parked_magic == MOTION_PARKED_MAGIC && esp_reset_reason() == ESP_RST_SW && motor_x && motor_y && motor_z) {
+        // Motors start at position 0, which is where they were parked
+        motor_x->setPositionTrusted(true);
+        motor_y->setPositionTrusted(true);
+        motor_z->setPositionTrusted(true);
+        ESP_LOGI(TAG, "Axes parked at home before restart, position trusted");
+    } else {
+        s_parked_magic = 0;
+    }
+#endif
+
+    ESP_LOGI(TAG, "Motion controller initialized (X %.0f, Y %.0f, Z %.0f mm/s, %.0f mm/s^2)",
+             config->max_velocity_x, config->max_velocity_y, config->max_velocity_z,
+             config->max_acceleration);
+
+    return handle;
+}
+
+void motion_controller_deinit(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        return;
+    }
+    free(handle);
+}
+
+/**
+ * @brief Convert a coordinate of an axis to the nearest motor step
+ */
+static int32_t um_to_steps(motion_controller_handle_t handle, int axis, coord_um_t um) {
+    return coord_um_to_steps(um, handle->steps_per_mm[axis]);
+}
+
+/**
+ * @brief Convert a step position of an axis to the nearest micrometre
+ */
+static coord_um_t steps_to_um(motion_controller_handle_t handle, int axis, int32_t steps) {
+    return coord_steps_to_um(steps, handle->steps_per_mm[axis]);
+}
+
+/**
+ * @brief Stop counting queue underruns once a chain of planned moves is over
+ */
+static void end_stream(motion_controller_handle_t handle) {
+    if (!handle->streaming) {
+        return;
+    }
+    motor_x->endQueue();
+    motor_y->endQueue();
+    motor_z->endQueue();
+    handle->streaming = false;
+}
+
+bool motion_controller_is_position_valid(motion_controller_handle_t handle, const position_t* pos) {
+    if (handle == NULL || pos == NULL) {
+        return false;
+    }
+
+    const motion_controller_config_t* config = &handle->config;
+    return pos->x >= 0 && pos->x <= config->work_area_x_max &&
+           pos->y >= 0 && pos->y <= config->work_area_y_max &&
+           pos->z >= 0 && pos->z <= config->work_area_z_max;
+}
+
+bool motion_controller_move_to(motion_controller_handle_t handle, const position_t* target) {
+    if (handle == NULL || target == NULL) {
+        ESP_LOGE(TAG, "Handle or target is NULL");
+        return false;
+    }
+
+    if (!motor_x || !motor_y || !motor_z) {
+        ESP_LOGE(TAG, "Motors not initialized");
+        return false;
+    }
+
+    if (!motion_controller_is_position_valid(handle, target)) {
+        ESP_LOGW(TAG, "Target (%.3f, %.3f, %.3f) outside work area", coord_um_to_mm(target->x),
+                 coord_um_to_mm(target->y), coord_um_to_mm(target->z));
+        return false;
+    }
+
+    if (handle->planner.count > 0) {
+        ESP_LOGW(TAG, "Queued moves pending, flush before a direct move");
+        return false;
+    }
+    end_stream(handle);
+
+    motor_x->setTargetPosition(um_to_steps(handle, 0, target->x));
+    motor_y->setTargetPosition(um_to_steps(handle, 1, target->y));
+    motor_z->setTargetPosition(um_to_steps(handle, 2, target->z));
+
+    // Longest axis leads, the others are interpolated onto the same line
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    if (!StepperMotor::stepLinearToTarget(axes, 3)) {
+        ESP_LOGW(TAG, "Move to (%.3f, %.3f, %.3f) rejected", coord_um_to_mm(target->x),
+                 coord_um_to_mm(target->y), coord_um_to_mm(target->z));
+        return false;
+    }
+
+    return true;
+}
+
+bool motion_controller_wait_move_done(motion_controller_handle_t handle, uint32_t timeout_ms) {
+    if (handle == NULL) {
+        return true;
+    }
+
+    bool done = true;
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    for (StepperMotor* motor : axes) {
+        if (motor && !motor->waitForMove(timeout_ms)) {
+            done = false;
+        }
+    }
+    return done;
+}
+
+position_t motion_controller_get_position(motion_controller_handle_t handle) {
+    position_t pos = {};
+    if (handle == NULL || !motor_x || !motor_y || !motor_z) {
+        return pos;
+    }
+
+    pos.x = steps_to_um(handle, 0, motor_x->getPosition());
+    pos.y = steps_to_um(handle, 1, motor_y->getPosition());
+    pos.z = steps_to_um(handle, 2, motor_z->getPosition());
+    return pos;
+}
+
+position_t motion_controller_get_queued_position(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        position_t pos = {};
+        return pos;
+    }
+
+    if (handle->planner.count == 0 && !(handle->streaming && motion_controller_is_moving(handle))) {
+        return motion_controller_get_position(handle);
+    }
+
+    position_t pos = {};
+    pos.x = steps_to_um(handle, 0, handle->planner.position[0]);
+    pos.y = steps_to_um(handle, 1, handle->planner.position[1]);
+    pos.z = steps_to_um(handle, 2, handle->planner.position[2]);
+    return pos;
+}
+
+bool motion_controller_is_moving(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        return false;
+    }
+
+    return (motor_x && motor_x->isMoving()) ||
+           (motor_y && motor_y->isMoving()) ||
+           (motor_z && motor_z->isMoving());
+}
+
+void motion_controller_emergency_stop(motion_controller_handle_t handle) {
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    for (StepperMotor* motor : axes) {
+        if (motor) {
+            motor->stop();
+        }
+    }
+
+    if (handle) {
+        handle->planner.count = 0;
+        handle->streaming = false;
+        handle->z_blend = false;
+        if (handle->homing_status.state == MOTION_HOMING_RUNNING) {
+            handle->homing_status.state = MOTION_HOMING_FAILED;
+        }
+        if (handle->tuning_status.state == MOTION_TUNING_RUNNING) {
+            handle->tuning_status.state = MOTION_TUNING_FAILED;
+            apply_axis_limits(handle);
+        }
+    }
+    for (StepperMotor* motor : axes) {
+        if (motor) {
+            motor->setPositionTrusted(false);
+        }
+    }
+    motion_controller_set_parked(handle, false);
+    ESP_LOGW(TAG, "Emergency stop");
+}
+
+static const char AXIS_NAMES[] = "XYZ";
+
+/**
+ * @brief Start the next approach of an axis towards its switch
+ */
+static bool homing_approach(motion_controller_handle_t handle, int axis, double velocity) {
+    homing_axis_t* homing = &handle->homing[axis];
+    StepperMotor* motor = axis_motor(axis);
+    homing->burst_start = motor->getPosition();
+    return motor->startHoming(velocity, homing->remaining);
+}
+
+/**
+ * @brief Give up homing: stop every axis and record the one that failed
+ */
+static void homing_fail(motion_controller_handle_t handle, int axis, const char* reason) {
+    ESP_LOGE(TAG, "Homing %c failed: %s", AXIS_NAMES[axis], reason);
+    for (int i = 0; i < MOTION_PLANNER_AXES; i++) {
+        axis_motor(i)->stop();
+        axis_motor(i)->setPositionTrusted(false);
+        if (handle->homing[i].phase != HOMING_DONE) {
+            handle->homing[i].phase = HOMING_FAILED;
+        }
+    }
+    handle->homing_status.state = MOTION_HOMING_FAILED;
+    handle->homing_status.failed_axis = axis;
+}
+
+/**
+ * @brief Move one axis on to its next homing phase once the last one ended
+ */
+static void homing_advance(motion_controller_handle_t handle, int axis, uint32_t elapsed_ms) {
+    homing_axis_t* homing = &handle->homing[axis];
+    StepperMotor* motor = axis_motor(axis);
+    const motion_controller_config_t* config = &handle->config;
+
+    if (homing->phase >= HOMING_DONE || motor->isMoving()) {
+        return;
+    }
+
+    int32_t pull_off = um_to_steps(handle, axis, config->homing_pull_off);
+    bool closed = motor->isEndpointReached();
+
+    switch (homing->phase) {
+    case HOMING_SEEK:
+    case HOMING_LOCATE:
+        if (closed) {
+            if (handle->homing_verify && !homing->touched) {
+                // First contact: where the tracked position put the switch
+                homing->touched = true;
+                handle->homing_status.axis_error[axis] = steps_to_um(handle, axis, motor->getEndpointError());
+            }
+            if (homing->phase == HOMING_LOCATE) {
+                motor->resetPosition();
+                motor->setPositionTrusted(true);
+                homing->phase = HOMING_DONE;
+                handle->homing_status.axis_ms[axis] = elapsed_ms;
+                ESP_LOGI(TAG, "%c homed in %lu ms", AXIS_NAMES[axis], elapsed_ms);
+                break;
+            }
+            // Position reads 0 on the switch; back off so the slow approach starts clear of it
+            motor->setTargetPosition(pull_off);
+            motor->stepMultipleToTarget(pull_off);
+            homing->phase = HOMING_BACK_OFF;
+            break;
+        }
+
+        // Switch still open: the seek ran its distance (or one RMT burst)
+        {
+            uint32_t moved = static_cast<uint32_t>(std::abs(motor->getPosition() - homing->burst_start));
+            homing->remaining = moved < homing->remaining ? homing->remaining - moved : 0;
+        }
+        if (homing->remaining == 0 && homing->phase == HOMING_SEEK && handle->homing_verify) {
+            // Verification seek stops at the pull-off, the slow touch follows
+            homing->phase = HOMING_LOCATE;
+            homing->remaining = 2 * pull_off;
+            if (!homing_approach(handle, axis, config->homing_locate_velocity)) {
+                homing_fail(handle, axis, "seek rejected");
+            }
+        } else if (homing->remaining == 0) {
+            homing_fail(handle, axis, "endpoint switch not found");
+        } else if (!homing_approach(handle, axis, homing->phase == HOMING_SEEK
+                                                      ? config->homing_seek_velocity
+                                                      : config->homing_locate_velocity)) {
+            homing_fail(handle, axis, "seek rejected");
+        }
+        break;
+
+    case HOMING_BACK_OFF:
+        if (closed) {
+            homing_fail(handle, axis, "switch still closed after pull-off");
+            break;
+        }
+        homing->phase = HOMING_LOCATE;
+        homing->remaining = 2 * pull_off;
+        if (!homing_approach(handle, axis, config->homing_locate_velocity)) {
+            homing_fail(handle, axis, "seek rejected");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Check that homing can start and reset its status
+ */
+static bool homing_begin(motion_controller_handle_t handle, bool verify) {
+    if (handle == NULL || !motor_x || !motor_y || !motor_z) {
+        ESP_LOGE(TAG, "Motion controller or motors not initialized");
+        return false;
+    }
+
+    if (handle->planner.count > 0 || motion_controller_is_moving(handle)) {
+        ESP_LOGW(TAG, "Axes busy, cannot start homing");
+        return false;
+    }
+    end_stream(handle);
+    handle->z_blend = false;
+    motion_controller_set_parked(handle, false);
+
+    handle->homing_status = {};
+    handle->homing_status.state = MOTION_HOMING_RUNNING;
+    handle->homing_status.verify = verify;
+    handle->homing_status.failed_axis = -1;
+    handle->homing_verify = verify;
+    handle->homing_start_us = esp_timer_get_time();
+    return true;
+}
+
+bool motion_controller_start_homing(motion_controller_handle_t handle) {
+    if (!homing_begin(handle, false)) {
+        return false;
+    }
+
+    const motion_controller_config_t* config = &handle->config;
+    const coord_um_t work_area[] = { config->work_area_x_max, config->work_area_y_max, config->work_area_z_max };
+
+    ESP_LOGI(TAG, "Homing X, Y, Z: seek %.1f mm/s, pull-off %.3f mm, locate %.1f mm/s",
+             config->homing_seek_velocity, coord_um_to_mm(config->homing_pull_off),
+             config->homing_locate_velocity);
+
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        homing_axis_t* homing = &handle->homing[axis];
+        homing->phase = HOMING_SEEK;
+        homing->touched = false;
+        axis_motor(axis)->setPositionTrusted(false);
+        // Whole travel with some margin: the head may sit anywhere after a power cycle
+        homing->remaining = static_cast<uint32_t>(
+            um_to_steps(handle, axis, work_area[axis] + work_area[axis] / 4 + config->homing_pull_off));
+        if (!homing_approach(handle, axis, config->homing_seek_velocity)) {
+            homing_fail(handle, axis, "seek rejected");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool motion_controller_start_verify(motion_controller_handle_t handle) {
+    if (!motion_controller_is_homed(handle)) {
+        ESP_LOGW(TAG, "Position not trusted, full homing needed");
+        return false;
+    }
+    if (!homing_begin(handle, true)) {
+        return false;
+    }
+
+    const motion_controller_config_t* config = &handle->config;
+    ESP_LOGI(TAG, "Verifying home: touch at %.1f mm/s from %.3f mm",
+             config->homing_locate_velocity, coord_um_to_mm(config->homing_pull_off));
+
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        homing_axis_t* homing = &handle->homing[axis];
+        StepperMotor* motor = axis_motor(axis);
+        int32_t pull_off = um_to_steps(handle, axis, config->homing_pull_off);
+        int32_t position = motor->getPosition();
+        homing->touched = false;
+
+        if (position > pull_off) {
+            // Fast to the pull-off; the seek still stops if the switch comes early
+            homing->phase = HOMING_SEEK;
+            homing->remaining = static_cast<uint32_t>(position - pull_off);
+            if (!homing_approach(handle, axis, config->homing_seek_velocity)) {
+                homing_fail(handle, axis, "seek rejected");
+                return false;
+            }
+        } else {
+            // Already closer than the pull-off: move out to it first
+            homing->phase = HOMING_BACK_OFF;
+            motor->setTargetPosition(pull_off);
+            motor->stepMultipleToTarget(pull_off);
+        }
+    }
+
+    return true;
+}
+
+bool motion_controller_is_homed(motion_controller_handle_t handle) {
+    if (handle == NULL || !motor_x || !motor_y || !motor_z) {
+        return false;
+    }
+    return motor_x->isPositionTrusted() && motor_y->isPositionTrusted() && motor_z->isPositionTrusted();
+}
+
+bool motion_controller_get_last_verify(motion_controller_handle_t handle, motion_verify_result_t* result) {
+    if (handle == NULL || result == NULL || handle->last_verify.count == 0) {
+        return false;
+    }
+    *result = handle->last_verify;
+    result->age_ms = static_cast<uint32_t>((esp_timer_get_time() - handle->last_verify_us) / 1000);
+    return true;
+}
+
+void motion_controller_set_parked(motion_controller_handle_t handle, bool parked) {
+#if CONFIG_MOTION_HOME_SURVIVES_RESTART
+    if (parked && !motion_controller_is_homed(handle)) {
+        parked = false;
+    }
+    s_parked_magic = parked ? MOTION_PARKED_MAGIC : 0;
+#else
+    (void)handle;
+    (void)parked;
+#endif
+}
+
+motion_homing_state_t motion_controller_poll_homing(motion_controller_handle_t handle,
+                                                    motion_homing_status_t* status) {
+    if (handle == NULL) {
+        return MOTION_HOMING_IDLE;
+    }
+
+    if (handle->homing_status.state == MOTION_HOMING_RUNNING) {
+        uint32_t elapsed_ms = static_cast<uint32_t>((esp_timer_get_time() - handle->homing_start_us) / 1000);
+        bool all_done = true;
+        for (int axis = 0; axis < MOTION_PLANNER_AXES &&
+                           handle->homing_status.state == MOTION_HOMING_RUNNING; axis++) {
+            homing_advance(handle, axis, elapsed_ms);
+            all_done = all_done && handle->homing[axis].phase == HOMING_DONE;
+        }
+
+        if (handle->homing_status.state != MOTION_HOMING_RUNNING || all_done) {
+            handle->homing_status.total_ms = elapsed_ms;
+            if (all_done) {
+                const motion_homing_status_t* done = &handle->homing_status;
+                handle->homing_status.state = MOTION_HOMING_DONE;
+                ESP_LOGI(TAG, "Homing done in %lu ms (X %lu, Y %lu, Z %lu ms)", elapsed_ms,
+                         done->axis_ms[0], done->axis_ms[1], done->axis_ms[2]);
+                if (done->verify) {
+                    ESP_LOGI(TAG, "Switches found at X %.3f, Y %.3f, Z %.3f mm of the trusted position",
+                             coord_um_to_mm(done->axis_error[0]), coord_um_to_mm(done->axis_error[1]),
+                             coord_um_to_mm(done->axis_error[2]));
+                    handle->last_verify.count++;
+                    memcpy(handle->last_verify.axis_error, done->axis_error, sizeof(done->axis_error));
+                    handle->last_verify_us = esp_timer_get_time();
+                }
+            }
+        }
+    }
+
+    if (status) {
+        *status = handle->homing_status;
+    }
+    return handle->homing_status.state;
+}
+
+bool motion_controller_home(motion_controller_handle_t handle) {
+    if (!motion_controller_start_homing(handle)) {
+        return false;
+    }
+
+    motion_homing_state_t state;
+    while ((state = motion_controller_poll_homing(handle, NULL)) == MOTION_HOMING_RUNNING) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return state == MOTION_HOMING_DONE;
+}
+
+void motion_controller_get_limits(motion_controller_handle_t handle, motion_axis_limits_t* limits) {
+    if (handle == NULL || limits == NULL) {
+        return;
+    }
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        limits->max_velocity[axis] = handle->limits.max_velocity[axis];
+        limits->max_acceleration[axis] = handle->limits.max_acceleration[axis];
+    }
+}
+
+bool motion_controller_set_limits(motion_controller_handle_t handle, const motion_axis_limits_t* limits,
+                                  bool persist) {
+    if (handle == NULL || limits == NULL || !limits_valid(limits)) {
+        ESP_LOGE(TAG, "Velocity and acceleration limits must be positive");
+        return false;
+    }
+    if (handle->planner.count > 0 || motion_controller_is_moving(handle)) {
+        ESP_LOGW(TAG, "Axes busy, cannot change limits");
+        return false;
+    }
+
+    end_stream(handle);
+    use_limits(handle, limits);
+    return !persist || store_limits(handle, limits);
+}
+
+/**
+ * @brief Start a round of test moves at the levels under test
+ */
+static void tuning_start_round(motion_controller_handle_t handle) {
+    motion_tuning_status_t* status = &handle->tuning_status;
+    motion_axis_limits_t base;
+    config_limits(&handle->config, &base);
+
+    status->round++;
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        handle->tuning_moves[axis] = 0;
+        if (!status->searching[axis]) {
+            continue;
+        }
+        double level = handle->tuning_test[axis];
+        axis_motor(axis)->setMotionLimits(base.max_velocity[axis] * level, base.max_acceleration[axis] * level);
+        handle->tuning_moves[axis] = 2 * handle->tuning_config.cycles;
+        ESP_LOGI(TAG, "Tuning round %lu: %c at %.2fx (%.0f mm/s, %.0f mm/s^2)", status->round,
+                 AXIS_NAMES[axis], level, base.max_velocity[axis] * level, base.max_acceleration[axis] * level);
+    }
+    handle->tuning_phase = TUNING_MOVES;
+}
+
+/**
+ * @brief Run the next out-and-back test move of every axis that is idle
+ *
+ * @return true once every axis has run all of its moves
+ */
+static bool tuning_run_moves(motion_controller_handle_t handle) {
+    const motion_controller_config_t* config = &handle->config;
+    const coord_um_t work_area[] = { config->work_area_x_max, config->work_area_y_max, config->work_area_z_max };
+    bool done = true;
+
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        StepperMotor* motor = axis_motor(axis);
+        if (motor->isMoving()) {
+            done = false;
+            continue;
+        }
+        if (handle->tuning_moves[axis] == 0) {
+            continue;
+        }
+
+        // Out to the far end, then back to the pull-off for the switch touch
+        coord_um_t end = (handle->tuning_moves[axis] % 2 == 0)
+                             ? std::min(handle->tuning_config.travel, work_area[axis])
+                             : config->homing_pull_off;
+        int32_t target = um_to_steps(handle, axis, end);
+        motor->setTargetPosition(target);
+        motor->stepMultipleToTarget(static_cast<uint32_t>(std::abs(target - motor->getPosition())));
+        handle->tuning_moves[axis]--;
+        done = false;
+    }
+    return done;
+}
+
+/**
+ * @brief Stop searching an axis, keeping its last clean level
+ */
+static void tuning_stop_axis(motion_controller_handle_t handle, int axis, const char* reason) {
+    motion_tuning_status_t* status = &handle->tuning_status;
+    status->searching[axis] = false;
+    ESP_LOGI(TAG, "Tuning %c: %s at %.2fx, keeping %.2fx", AXIS_NAMES[axis], reason,
+             handle->tuning_test[axis], status->level[axis]);
+}
+
+/**
+ * @brief Home from scratch after an axis lost track of its position
+ */
+static void tuning_rehome(motion_controller_handle_t handle) {
+    apply_axis_limits(handle);
+    if (motion_controller_start_homing(handle)) {
+        handle->tuning_phase = TUNING_HOME;
+    } else {
+        handle->tuning_status.state = MOTION_TUNING_FAILED;
+    }
+}
+
+/**
+ * @brief Apply and store the tuned limits, or restore the old ones
+ */
+static void tuning_finish(motion_controller_handle_t handle) {
+    motion_tuning_status_t* status = &handle->tuning_status;
+
+    if (status->state == MOTION_TUNING_RUNNING) {
+        motion_axis_limits_t limits;
+        config_limits(&handle->config, &limits);
+        double keep = 1.0 - handle->tuning_config.margin;
+        for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+            if (status->level[axis] > 0) {
+                limits.max_velocity[axis] *= status->level[axis] * keep;
+                limits.max_acceleration[axis] *= status->level[axis] * keep;
+            } else {
+                ESP_LOGW(TAG, "%c lost steps at the configured limits, keeping them", AXIS_NAMES[axis]);
+            }
+        }
+        use_limits(handle, &limits);
+        store_limits(handle, &limits);
+        status->state = MOTION_TUNING_DONE;
+        ESP_LOGI(TAG, "Tuned limits: X %.0f, Y %.0f, Z %.0f mm/s, %.0f/%.0f/%.0f mm/s^2",
+                 limits.max_velocity[0], limits.max_velocity[1], limits.max_velocity[2],
+                 limits.max_acceleration[0], limits.max_acceleration[1], limits.max_acceleration[2]);
+    } else {
+        apply_axis_limits(handle);
+        ESP_LOGE(TAG, "Tuning failed, limits unchanged");
+    }
+
+    motion_controller_get_limits(handle, &status->limits);
+    status->total_ms = static_cast<uint32_t>((esp_timer_get_time() - handle->tuning_start_us) / 1000);
+}
+
+/**
+ * @brief Raise the axes whose switch touch came out clean, stop the others
+ */
+static void tuning_judge(motion_controller_handle_t handle, const coord_um_t* axis_error) {
+    motion_tuning_status_t* status = &handle->tuning_status;
+    const motion_tuning_config_t* tuning = &handle->tuning_config;
+    motion_axis_limits_t base;
+    config_limits(&handle->config, &base);
+
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        if (!status->searching[axis]) {
+            continue;
+        }
+        if (std::abs(axis_error[axis]) > tuning->tolerance) {
+            ESP_LOGW(TAG, "Tuning %c: switch %.3f mm off", AXIS_NAMES[axis], coord_um_to_mm(axis_error[axis]));
+            tuning_stop_axis(handle, axis, "lost steps");
+            continue;
+        }
+
+        status->level[axis] = handle->tuning_test[axis];
+        double next = handle->tuning_test[axis] * (1.0 + tuning->step);
+        // Beyond this the step timer cannot keep up, whatever the mechanics do
+        double step_rate = base.max_velocity[axis] * next * handle->steps_per_mm[axis];
+        if (step_rate > 1000000.0 / STEPPER_MIN_STEP_TIME_US) {
+            tuning_stop_axis(handle, axis, "step rate limit");
+        } else if (status->round >= tuning->max_rounds) {
+            tuning_stop_axis(handle, axis, "last round");
+        } else {
+            handle->tuning_test[axis] = next;
+        }
+    }
+}
+
+bool motion_controller_start_tuning(motion_controller_handle_t handle, const motion_tuning_config_t* config) {
+    if (handle == NULL || config == NULL || !motor_x || !motor_y || !motor_z) {
+        ESP_LOGE(TAG, "Motion controller or motors not initialized");
+        return false;
+    }
+    if (config->travel <= handle->config.homing_pull_off || config->cycles == 0 || !(config->step > 0) ||
+        config->max_rounds == 0 || !(config->margin >= 0 && config->margin < 1) || config->tolerance < 0) {
+        ESP_LOGE(TAG, "Invalid tuning parameters");
+        return false;
+    }
+    if (handle->planner.count > 0 || motion_controller_is_moving(handle)) {
+        ESP_LOGW(TAG, "Axes busy, cannot start tuning");
+        return false;
+    }
+
+    handle->tuning_config = *config;
+    handle->tuning_status = {};
+    handle->tuning_status.state = MOTION_TUNING_RUNNING;
+    for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+        handle->tuning_status.searching[axis] = true;
+        handle->tuning_test[axis] = 1.0;
+    }
+    handle->tuning_start_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Tuning limits: %lu x %.0f mm per round, +%.0f %% per round, %.0f %% margin",
+             config->cycles, coord_um_to_mm(config->travel), config->step * 100, config->margin * 100);
+
+    if (motion_controller_is_homed(handle)) {
+        tuning_start_round(handle);
+        return true;
+    }
+    if (!motion_controller_start_homing(handle)) {
+        handle->tuning_status.state = MOTION_TUNING_IDLE;
+        return false;
+    }
+    handle->tuning_phase = TUNING_HOME;
+    return true;
+}
+
+motion_tuning_state_t motion_controller_poll_tuning(motion_controller_handle_t handle,
+                                                    motion_tuning_status_t* status) {
+    if (handle == NULL) {
+        return MOTION_TUNING_IDLE;
+    }
+
+    motion_tuning_status_t* tuning = &handle->tuning_status;
+    if (tuning->state == MOTION_TUNING_RUNNING) {
+        motion_homing_status_t homing;
+        switch (handle->tuning_phase) {
+        case TUNING_HOME:
+            switch (motion_controller_poll_homing(handle, &homing)) {
+            case MOTION_HOMING_RUNNING:
+                break;
+            case MOTION_HOMING_DONE:
+                tuning_start_round(handle);
+                break;
+            default:
+                tuning->state = MOTION_TUNING_FAILED;
+                break;
+            }
+            break;
+
+        case TUNING_MOVES: {
+            if (!tuning_run_moves(handle)) {
+                break;
+            }
+            // A move that ended on a closed switch far from 0 already lost track
+            bool lost = false;
+            for (int axis = 0; axis < MOTION_PLANNER_AXES; axis++) {
+                if (!axis_motor(axis)->isPositionTrusted()) {
+                    if (tuning->searching[axis]) {
+                        tuning_stop_axis(handle, axis, "hit its switch");
+                    }
+                    lost = true;
+                }
+            }
+            if (lost) {
+                tuning_rehome(handle);
+            } else if (motion_controller_start_verify(handle)) {
+                handle->tuning_phase = TUNING_VERIFY;
+            } else {
+                tuning->state = MOTION_TUNING_FAILED;
+            }
+            break;
+        }
+
+        case TUNING_VERIFY:
+            switch (motion_controller_poll_homing(handle, &homing)) {
+            case MOTION_HOMING_RUNNING:
+                break;
+            case MOTION_HOMING_DONE:
+                tuning_judge(handle, homing.axis_error);
+                if (tuning->searching[0] || tuning->searching[1] || tuning->searching[2]) {
+                    tuning_start_round(handle);
+                } else {
+                    tuning_finish(handle);
+                }
+                break;
+            default:
+                // Too far off to find the switch within the touch distance
+                if (homing.failed_axis < 0) {
+                    tuning->state = MOTION_TUNING_FAILED;
+                    break;
+                }
+                if (tuning->searching[homing.failed_axis]) {
+                    tuning_stop_axis(handle, homing.failed_axis, "switch not found");
+                }
+                tuning_rehome(handle);
+                break;
+            }
+            break;
+        }
+
+        if (tuning->state == MOTION_TUNING_FAILED) {
+            tuning_finish(handle);
+        }
+    }
+
+    if (status) {
+        *status = *tuning;
+    }
+    return tuning->state;
+}
+
+/**
+ * @brief Check whether a move has to wait for every axis to stop first
+ *
+ * No hold time is known around an S-curve move. A move that needs Z while
+ * a lift is blended has to wait too: Z skipped the holds of the moves
+ * before it, so its queue is not in step with X and Y.
+ */
+static bool needs_barrier(motion_controller_handle_t handle, const motion_block_t* block) {
+    return block->isolated || handle->emitted_isolated ||
+           (handle->z_blend && block->delta[2] != 0);
+}
+
+/**
+ * @brief Queue slots the backlash take-up adds ahead of a move
+ *
+ * A reversing axis with play gets its take-up segment, and a hold if
+ * another axis takes longer to take up.
+ */
+static uint32_t takeup_slots(const motion_block_t* block) {
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (block->delta[a] != 0 && axis_motor(a)->takeupTimeUs(block->target[a]) > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Shaper for a move, nullptr if it runs as a plain trapezoid
+ *
+ * The shapers of the moving X and Y axes, combined. S-curve moves are
+ * smoothed by their jerk limit instead, and the RMT backend cannot run the
+ * pieces back to back. A move is handed over only once it fits the segment
+ * queues whole, so the queues have to hold two shaped moves: the next one
+ * then goes in while the pieces of the last are still queued, and the axes
+ * do not run dry at speed between ticks. Otherwise the move runs plain.
+ */
+static const motion_shaper_t* block_shaper(motion_controller_handle_t handle, const motion_block_t* block) {
+#if CONFIG_STEPPER_BACKEND_RMT
+    return nullptr;
+#else
+    const motion_shaper_t* shaper = &handle->shapers[block->axis_mask & 3];
+    if (block->isolated || shaper->count < 2 ||
+        2 * motion_shaper_max_pieces(shaper) + takeup_slots(block) > CONFIG_STEPPER_SEGMENT_QUEUE_LEN) {
+        return nullptr;
+    }
+    return shaper;
+#endif
+}
+
+/**
+ * @brief Check whether emit_block() would have to wait
+ */
+static bool emit_would_block(motion_controller_handle_t handle) {
+    bool idle = !motion_controller_is_moving(handle);
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    return !idle;
+#else
+    const motion_block_t* block = &handle->planner.blocks[0];
+    if (handle->streaming && needs_barrier(handle, block) && !idle) {
+        return true;
+    }
+
+    // Every axis takes a segment or a hold, a shaped move one segment per
+    // piece, plus the take-up; block_shaper() keeps this within the queue
+    const motion_shaper_t* shaper = block_shaper(handle, block);
+    uint32_t slots = (shaper ? motion_shaper_max_pieces(shaper) : 1) + takeup_slots(block);
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        stepper_queue_stats_t stats = axis_motor(a)->getQueueStats();
+        if (stats.depth + slots > stats.capacity) {
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+/**
+ * @brief Queue a shaped move piece by piece on every moving axis
+ *
+ * Each axis gets the pieces scaled to its share of the move; pieces too
+ * short for one of its steps are merged into the next. emit_block() has
+ * made room for all of them, so none waits for a queue slot.
+ */
+static bool emit_shaped(const motion_block_t* block, const motion_shaper_piece_t* pieces, uint32_t count) {
+    StepperMotor* const axes[MOTION_PLANNER_AXES] = { motor_x, motor_y, motor_z };
+    int32_t queued[MOTION_PLANNER_AXES] = {};   // Steps handed out so far
+    uint32_t first[MOTION_PLANNER_AXES] = {};   // First piece not handed out yet
+    double travelled = 0.0;
+    bool ok = true;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const motion_shaper_piece_t& piece = pieces[i];
+        travelled += 0.5 * (piece.start_speed + piece.end_speed) * piece.duration;
+
+        for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+            if (block->delta[a] == 0) {
+                continue;
+            }
+            int32_t steps = (i + 1 == count) ? block->delta[a]
+                                             : static_cast<int32_t>(lround(travelled / block->length * block->delta[a]));
+            if (steps == queued[a]) {
+                continue;
+            }
+
+            double scale = std::abs(block->delta[a]) / block->length;
+            double duration = 0.0;
+            double peak = 0.0;
+            for (uint32_t j = first[a]; j <= i; j++) {
+                duration += pieces[j].duration;
+                peak = std::max({ peak, pieces[j].start_speed, pieces[j].end_speed });
+            }
+            double entry = pieces[first[a]].start_speed;
+            double acceleration = std::abs(piece.end_speed - entry) / duration;
+            if (first[a] != i || acceleration <= 0.0) {
+                acceleration = block->acceleration;
+            }
+
+            stepper_motor_segment_t profile = {};
+            profile.max_velocity = peak * scale;
+            profile.acceleration = acceleration * scale;
+            profile.entry_velocity = entry * scale;
+            profile.exit_velocity = piece.end_speed * scale;
+
+            int32_t start = block->target[a] - block->delta[a];
+            if (!axes[a]->queueSegmentTo(start + steps, profile, 0)) {
+                ESP_LOGE(TAG, "Axis %d rejected shaped piece", a);
+                ok = false;
+            }
+            queued[a] = steps;
+            first[a] = i + 1;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Hand the oldest planned move to the motors' segment queues
+ *
+ * Every axis gets the path profile scaled to its share of the move, so all
+ * axes ramp together and pass the junction at the planned speed. Axes that
+ * sit the move out get a hold of the same length. With input shaping the
+ * profile is the shaped one, handed out in pieces.
+ */
+static bool emit_block(motion_controller_handle_t handle) {
+    motion_planner_t* planner = &handle->planner;
+    const motion_block_t* block = &planner->blocks[0];
+    double entry_speed = block->entry_speed;
+    double exit_speed = motion_planner_exit_speed(planner);
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    // RMT cannot chain segments: every move runs on its own, from rest to rest
+    motion_controller_wait_move_done(handle, MOTION_QUEUE_TIMEOUT_MS);
+    entry_speed = 0.0;
+    exit_speed = 0.0;
+#endif
+
+    StepperMotor* const axes[MOTION_PLANNER_AXES] = { motor_x, motor_y, motor_z };
+
+    if (handle->streaming && needs_barrier(handle, block)) {
+        motion_controller_wait_move_done(handle, MOTION_QUEUE_TIMEOUT_MS);
+    }
+    if (block->delta[2] != 0) {
+        handle->z_blend = false;    // Z is part of the path again, approach is off
+    }
+
+    if (!handle->streaming) {
+        for (StepperMotor* motor : axes) {
+            motor->beginQueue();
+        }
+        handle->streaming = true;
+    }
+
+    // Callers that did not check emit_would_block() wait here until the
+    // whole move fits the queues
+    TickType_t wait_start = xTaskGetTickCount();
+    while (emit_would_block(handle) &&
+           xTaskGetTickCount() - wait_start < pdMS_TO_TICKS(MOTION_QUEUE_TIMEOUT_MS)) {
+        vTaskDelay(1);
+    }
+
+    motion_shaper_piece_t* pieces = handle->pieces;
+    uint32_t piece_count = 0;
+    const motion_shaper_t* shaper = block_shaper(handle, block);
+    if (shaper) {
+        // Too short to shape between its junction speeds: runs plain
+        piece_count = motion_shaper_plan(shaper, block->length, entry_speed, block->nominal_speed,
+                                         exit_speed, block->acceleration, pieces);
+    }
+
+    uint32_t hold_us = block->isolated ? 0 : motion_planner_duration_us(block, exit_speed);
+    if (piece_count > 0) {
+        double seconds = 0.0;
+        for (uint32_t i = 0; i < piece_count; i++) {
+            seconds += pieces[i].duration;
+        }
+        hold_us = static_cast<uint32_t>(seconds * 1e6);
+    }
+    if (block->isolated) {
+        handle->timeline_valid = false;
+    }
+
+    // A reversing axis with play first takes it up in a segment of its own
+    // (the planner brought the path to rest here); the other axes hold until
+    // the longest take-up is done, so all of them start the move together
+    uint32_t takeup_us[MOTION_PLANNER_AXES] = {};
+    uint32_t takeup_max_us = 0;
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (block->delta[a] != 0) {
+            takeup_us[a] = axes[a]->takeupTimeUs(block->target[a]);
+            takeup_max_us = std::max(takeup_max_us, takeup_us[a]);
+        }
+    }
+
+    // Each axis starts this move when its queue runs out, or now if it already has
+    int64_t now = esp_timer_get_time();
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (a == 2 && handle->z_blend) {
+            continue;   // Still lifting; the approach works out its own hold
+        }
+        handle->timeline_us[a] = std::max(handle->timeline_us[a], now) + takeup_max_us + hold_us;
+    }
+
+    bool ok = true;
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (block->delta[a] == 0) {
+            if (a == 2 && handle->z_blend) {
+                continue;
+            }
+            uint32_t idle_us = takeup_max_us + hold_us;
+            if (idle_us > 0 && !axes[a]->queueHold(idle_us, MOTION_QUEUE_TIMEOUT_MS)) {
+                ESP_LOGE(TAG, "Axis %d rejected hold", a);
+                ok = false;
+            }
+            continue;
+        }
+        axes[a]->setTargetPosition(block->target[a]);
+        if (takeup_max_us > takeup_us[a] &&
+            !axes[a]->queueHold(takeup_max_us - takeup_us[a], MOTION_QUEUE_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "Axis %d rejected take-up hold", a);
+            ok = false;
+        }
+        if (piece_count > 0) {
+            continue;
+        }
+
+        // Steps of this axis per mm of path
+        double scale = std::abs(block->delta[a]) / block->length;
+        stepper_motor_segment_t profile = {};
+        profile.max_velocity = block->nominal_speed * scale;
+        profile.acceleration = block->acceleration * scale;
+        profile.jerk = handle->config.max_jerk * (block->acceleration / handle->limits.max_acceleration[a]) * scale;
+        profile.entry_velocity = entry_speed * scale;
+        profile.exit_velocity = exit_speed * scale;
+
+        if (!axes[a]->queueSegmentTo(block->target[a], profile, MOTION_QUEUE_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "Axis %d rejected planned move", a);
+            ok = false;
+        }
+    }
+    if (piece_count > 0) {
+        ok = emit_shaped(block, pieces, piece_count) && ok;
+    }
+
+    handle->emitted_isolated = block->isolated;
+    motion_planner_pop(planner);
+    return ok;
+}
+
+bool motion_controller_can_queue(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        return false;
+    }
+    // queue_move() hands over the oldest move as soon as the new one fills the planner
+    return handle->planner.count + 1 < MOTION_PLANNER_DEPTH || !emit_would_block(handle);
+}
+
+bool motion_controller_try_flush(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        return true;
+    }
+
+    while (handle->planner.count > 0 && !emit_would_block(handle)) {
+        emit_block(handle);
+    }
+    if (handle->planner.count > 0) {
+        return false;
+    }
+
+    // Drained and stopped: moves started from here on are not part of the stream
+    if (!motion_controller_is_moving(handle)) {
+        end_stream(handle);
+    }
+    return true;
+}
+
+bool motion_controller_queue_lift(motion_controller_handle_t handle, coord_um_t travel_z, coord_um_t clear_z) {
+    if (handle == NULL || !motor_x || !motor_y || !motor_z) {
+        return false;
+    }
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    // Holds are ignored and moves do not chain: nothing to overlap
+    return false;
+#else
+    if (handle->planner.count > 0 || motion_controller_is_moving(handle)) {
+        return false;
+    }
+
+    int32_t z = motor_z->getPosition();
+    int32_t travel = um_to_steps(handle, 2, travel_z);
+    int32_t clear = um_to_steps(handle, 2, clear_z);
+
+    // The clearance height has to lie on the way up
+    int64_t to_clear = static_cast<int64_t>(clear) - z;
+    int64_t to_travel = static_cast<int64_t>(travel) - z;
+    if (to_travel == 0 || to_clear * to_travel < 0 || std::abs(to_clear) > std::abs(to_travel)) {
+        return false;
+    }
+
+    uint32_t steps = static_cast<uint32_t>(std::abs(to_travel));
+    uint32_t takeup_us = motor_z->takeupTimeUs(travel);
+    uint32_t clear_us = takeup_us + motor_z->moveTimeUs(steps, static_cast<uint32_t>(std::abs(to_clear)));
+    uint32_t raise_us = takeup_us + motor_z->moveTimeUs(steps, steps);
+
+    end_stream(handle);
+    int32_t position[MOTION_PLANNER_AXES] = { motor_x->getPosition(), motor_y->getPosition(), travel };
+    motion_planner_reset(&handle->planner, position);
+    handle->emitted_isolated = false;
+
+    motor_x->beginQueue();
+    motor_y->beginQueue();
+    motor_z->beginQueue();
+    handle->streaming = true;
+
+    // Queues are empty: none of these wait
+    motor_z->setTargetPosition(travel);
+    bool ok = motor_z->queueMoveTo(travel, 0);
+    if (ok && clear_us > 0) {
+        ok = motor_x->queueHold(clear_us, 0) && motor_y->queueHold(clear_us, 0);
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "Lift rejected, stopping");
+        motion_controller_emergency_stop(handle);
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    handle->timeline_us[0] = now + clear_us;
+    handle->timeline_us[1] = now + clear_us;
+    handle->timeline_us[2] = now + raise_us;
+    handle->timeline_valid = true;
+    handle->z_blend = true;
+
+    ESP_LOGD(TAG, "Lift: clearance after %lu us, travel height after %lu us", clear_us, raise_us);
+    return true;
+#endif
+}
+
+bool motion_controller_try_flush_approach(motion_controller_handle_t handle, coord_um_t clear_z) {
+    if (handle == NULL) {
+        return true;
+    }
+
+    if (!motion_controller_try_flush(handle)) {
+        return false;
+    }
+    if (!handle->z_blend) {
+        return true;
+    }
+
+    // Hold, take-up and descent
+    int32_t clear = um_to_steps(handle, 2, clear_z);
+    uint32_t takeup_us = motor_z->takeupTimeUs(clear);
+    stepper_queue_stats_t stats = motor_z->getQueueStats();
+    if (stats.depth + (takeup_us > 0 ? 3 : 2) > stats.capacity) {
+        return false;
+    }
+
+    uint32_t steps = static_cast<uint32_t>(std::abs(clear - handle->planner.position[2]));
+    uint32_t hold_us = 0;
+
+    if (handle->timeline_valid) {
+        // Reach clearance height just as X and Y arrive
+        int64_t now = esp_timer_get_time();
+        int64_t xy_end = std::max(handle->timeline_us[0], handle->timeline_us[1]);
+        int64_t z_start = std::max(handle->timeline_us[2], now);
+        int64_t descent_us = static_cast<int64_t>(takeup_us) + motor_z->moveTimeUs(steps, steps);
+        int64_t wait = xy_end - descent_us - z_start;
+        hold_us = wait > 0 ? static_cast<uint32_t>(wait) : 0;
+    } else if (motion_controller_is_moving(handle)) {
+        return false;   // XY arrival time unknown: descend once it has stopped
+    }
+
+    motor_z->setTargetPosition(clear);
+    if ((hold_us == 0 || motor_z->queueHold(hold_us, 0)) && motor_z->queueMoveTo(clear, 0)) {
+        handle->planner.position[2] = clear;
+    } else {
+        ESP_LOGW(TAG, "Approach rejected, Z stays at travel height");
+    }
+    handle->z_blend = false;
+    return true;
+}
+
+bool motion_controller_queue_move(motion_controller_handle_t handle, const position_t* target) {
+    if (handle == NULL || target == NULL) {
+        ESP_LOGE(TAG, "Handle or target is NULL");
+        return false;
+    }
+
+    if (!motor_x || !motor_y || !motor_z) {
+        ESP_LOGE(TAG, "Motors not initialized");
+        return false;
+    }
+
+    if (!motion_controller_is_position_valid(handle, target)) {
+        ESP_LOGW(TAG, "Target (%.3f, %.3f, %.3f) outside work area", coord_um_to_mm(target->x),
+                 coord_um_to_mm(target->y), coord_um_to_mm(target->z));
+        return false;
+    }
+
+    // Start planning from where the axes actually are
+    if (handle->planner.count == 0 && !motion_controller_is_moving(handle)) {
+        int32_t position[MOTION_PLANNER_AXES] = {
+            motor_x->getPosition(), motor_y->getPosition(), motor_z->getPosition()
+        };
+        motion_planner_reset(&handle->planner, position);
+        end_stream(handle);
+
+        StepperMotor* const axes[MOTION_PLANNER_AXES] = { motor_x, motor_y, motor_z };
+        for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+            handle->limits.backlash[a] = axes[a]->getBacklash() > 0;
+        }
+    }
+
+    int32_t steps[MOTION_PLANNER_AXES] = {
+        um_to_steps(handle, 0, target->x),
+        um_to_steps(handle, 1, target->y),
+        um_to_steps(handle, 2, target->z),
+    };
+
+    if (!motion_planner_add(&handle->planner, steps, &handle->limits)) {
+        return true;    // Already there
+    }
+
+    int64_t start = esp_timer_get_time();
+    motion_planner_recalculate(&handle->planner);
+    uint32_t elapsed = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+    handle->stats.last_recalc_us = elapsed;
+    if (elapsed > handle->stats.max_recalc_us) {
+        handle->stats.max_recalc_us = elapsed;
+    }
+    handle->stats.moves_planned++;
+
+    if (motion_planner_is_full(&handle->planner)) {
+        return emit_block(handle);
+    }
+    return true;
+}
+
+bool motion_controller_flush(motion_controller_handle_t handle) {
+    if (handle == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+    while (handle->planner.count > 0) {
+        ok = emit_block(handle) && ok;
+    }
+
+    ESP_LOGI(TAG, "Planner: %lu moves, replan %lu us (max %lu us, depth %lu)",
+             handle->stats.moves_planned, handle->stats.last_recalc_us,
+             handle->stats.max_recalc_us, handle->stats.depth);
+    return ok;
+}
+
+void motion_controller_get_planner_stats(motion_controller_handle_t handle, motion_planner_stats_t* stats) {
+    if (handle == NULL || stats == NULL) {
+        return;
+    }
+    *stats = handle->stats;
+}
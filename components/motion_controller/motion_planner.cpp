@@ -0,0 +1,166 @@
+/**
+ * @file motion_planner.cpp
+ * @brief Junction deviation look-ahead planner
+ */
+
+#include "motion_planner.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Cosine beyond which two moves count as collinear or as a full reversal
+static constexpr double JUNCTION_COS_EPSILON = 0.999999;
+
+void motion_planner_reset(motion_planner_t* planner, const int32_t position[MOTION_PLANNER_AXES]) {
+    memset(planner, 0, sizeof(*planner));
+    memcpy(planner->position, position, sizeof(planner->position));
+}
+
+/**
+ * @brief Highest corner speed between two moves, from the junction deviation
+ */
+static double junction_speed(const motion_planner_t* planner, const motion_block_t* block,
+                             const motion_planner_limits_t* limits) {
+    if (!planner->has_previous || planner->previous_isolated || block->isolated) {
+        return 0.0;
+    }
+
+    double cos_theta = 0.0;
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        cos_theta -= planner->previous_unit[a] * block->unit[a];
+    }
+
+    // The take-up of a reversing axis with play runs from rest on its own
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (limits->backlash[a] && planner->previous_sign[a] * block->delta[a] < 0) {
+            return 0.0;
+        }
+    }
+
+    double speed_limit = fmin(block->nominal_speed, planner->previous_nominal);
+
+    if (cos_theta > JUNCTION_COS_EPSILON) {
+        return 0.0;                 // Reversal
+    }
+    if (cos_theta < -JUNCTION_COS_EPSILON) {
+        return speed_limit;         // Straight on
+    }
+
+    double sin_half_theta = sqrt(0.5 * (1.0 - cos_theta));
+    double speed = sqrt(block->acceleration * limits->junction_deviation * sin_half_theta /
+                        (1.0 - sin_half_theta));
+    return fmin(speed, speed_limit);
+}
+
+bool motion_planner_add(motion_planner_t* planner, const int32_t target[MOTION_PLANNER_AXES],
+                        const motion_planner_limits_t* limits) {
+    motion_block_t* block = &planner->blocks[planner->count];
+    memset(block, 0, sizeof(*block));
+
+    double delta_mm[MOTION_PLANNER_AXES];
+    double length_sq = 0.0;
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        block->target[a] = target[a];
+        block->delta[a] = target[a] - planner->position[a];
+        if (block->delta[a] != 0) {
+            block->axis_mask |= 1u << a;
+            block->isolated = block->isolated || limits->s_curve[a];
+        }
+        delta_mm[a] = block->delta[a] / limits->steps_per_mm[a];
+        length_sq += delta_mm[a] * delta_mm[a];
+    }
+
+    if (block->axis_mask == 0) {
+        return false;
+    }
+
+    block->length = sqrt(length_sq);
+    block->nominal_speed = INFINITY;
+    block->acceleration = INFINITY;
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        block->unit[a] = delta_mm[a] / block->length;
+        if (block->delta[a] == 0) {
+            continue;
+        }
+        // Path limits at which this axis just reaches its own
+        double inverse = 1.0 / fabs(block->unit[a]);
+        block->nominal_speed = fmin(block->nominal_speed, limits->max_velocity[a] * inverse);
+        block->acceleration = fmin(block->acceleration, limits->max_acceleration[a] * inverse);
+    }
+
+    block->max_entry_speed = junction_speed(planner, block, limits);
+    block->entry_speed = 0.0;
+
+    memcpy(planner->position, target, sizeof(planner->position));
+    for (int a = 0; a < MOTION_PLANNER_AXES; a++) {
+        if (block->delta[a] != 0) {
+            planner->previous_sign[a] = block->delta[a] > 0 ? 1 : -1;
+        }
+    }
+    memcpy(planner->previous_unit, block->unit, sizeof(planner->previous_unit));
+    planner->previous_isolated = block->isolated;
+    planner->previous_nominal = block->nominal_speed;
+    planner->has_previous = true;
+    planner->count++;
+
+    return true;
+}
+
+void motion_planner_recalculate(motion_planner_t* planner) {
+    if (planner->count == 0) {
+        return;
+    }
+
+    // Backward: the last move has to be able to stop
+    double next_entry = 0.0;
+    for (uint32_t i = planner->count - 1; i > 0; i--) {
+        motion_block_t* block = &planner->blocks[i];
+        double reachable = sqrt(next_entry * next_entry + 2.0 * block->acceleration * block->length);
+        block->entry_speed = fmin(block->max_entry_speed, reachable);
+        next_entry = block->entry_speed;
+    }
+
+    // Forward: the oldest move starts at the speed its predecessor left with
+    planner->blocks[0].entry_speed = planner->locked_entry;
+    for (uint32_t i = 0; i + 1 < planner->count; i++) {
+        const motion_block_t* block = &planner->blocks[i];
+        double reachable = sqrt(block->entry_speed * block->entry_speed +
+                                2.0 * block->acceleration * block->length);
+        if (planner->blocks[i + 1].entry_speed > reachable) {
+            planner->blocks[i + 1].entry_speed = reachable;
+        }
+    }
+}
+
+uint32_t motion_planner_duration_us(const motion_block_t* block, double exit_speed) {
+    double a = block->acceleration;
+    double v_entry = block->entry_speed;
+    double v_peak = block->nominal_speed;
+    double up = (v_peak * v_peak - v_entry * v_entry) / (2.0 * a);
+    double down = (v_peak * v_peak - exit_speed * exit_speed) / (2.0 * a);
+    double cruise = block->length - up - down;
+
+    if (cruise < 0.0) {
+        // Triangle: peak where the two ramps meet
+        v_peak = sqrt(a * block->length + (v_entry * v_entry + exit_speed * exit_speed) / 2.0);
+        cruise = 0.0;
+    }
+
+    double seconds = (v_peak - v_entry) / a + (v_peak - exit_speed) / a + cruise / v_peak;
+    return static_cast<uint32_t>(seconds * 1e6);
+}
+
+double motion_planner_exit_speed(const motion_planner_t* planner) {
+    return planner->count > 1 ? planner->blocks[1].entry_speed : 0.0;
+}
+
+void motion_planner_pop(motion_planner_t* planner) {
+    if (planner->count == 0) {
+        return;
+    }
+
+    planner->locked_entry = motion_planner_exit_speed(planner);
+    planner->count--;
+    memmove(&planner->blocks[0], &planner->blocks[1], planner->count * sizeof(motion_block_t));
+}
@@ -0,0 +1,120 @@
+/**
+ * @file motion_planner.h
+ * @brief Look-ahead planner for consecutive travel moves
+ *
+ * Private to the motion_controller component. Keeps the last few queued
+ * moves and chooses the speed at every junction between them, so chains of
+ * moves run through corners without stopping. Follows Grbl's planner:
+ *
+ * - The speed allowed at a corner comes from the junction deviation model:
+ *   the path is treated as if it rounded the corner with an arc that stays
+ *   within a set distance of the sharp corner, and the speed is the one at
+ *   which the centripetal acceleration on that arc equals the limit.
+ *
+ * - A backward pass from the last move (which must be able to stop) and a
+ *   forward pass from the oldest move (whose entry speed is already fixed)
+ *   make every junction speed reachable with the available acceleration.
+ *
+ * Every axis runs its own share of a move from its own segment queue, so
+ * an axis that sits out a move waits for the move's duration instead. That
+ * duration is known only for trapezoidal ramps; moves with an S-curve axis
+ * are isolated (they start and end at rest).
+ *
+ * Pure arithmetic, no motor access: the motion controller pops planned
+ * moves and turns them into stepper segments.
+ */
+
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#define MOTION_PLANNER_AXES 3
+
+#define MOTION_PLANNER_DEPTH CONFIG_MOTION_LOOKAHEAD_DEPTH
+
+/**
+ * @brief Axis limits used when adding moves
+ */
+typedef struct {
+    double steps_per_mm[MOTION_PLANNER_AXES];
+    double max_velocity[MOTION_PLANNER_AXES];   // mm/s
+    double max_acceleration[MOTION_PLANNER_AXES];   // mm/s^2
+    double junction_deviation;                  // mm
+    bool s_curve[MOTION_PLANNER_AXES];          // Axis uses jerk-limited ramps
+    bool backlash[MOTION_PLANNER_AXES];         // Axis takes up play on reversal: stops there
+} motion_planner_limits_t;
+
+/**
+ * @brief One straight move in the look-ahead buffer
+ */
+typedef struct {
+    int32_t target[MOTION_PLANNER_AXES];    // End position (steps)
+    int32_t delta[MOTION_PLANNER_AXES];     // Signed step count per axis
+    uint32_t axis_mask;                     // Axes with a non-zero step count
+    bool isolated;                          // S-curve axis moves: never blended
+    double length;                          // Path length (mm)
+    double unit[MOTION_PLANNER_AXES];       // Direction of travel
+    double nominal_speed;                   // Path speed limit (mm/s)
+    double acceleration;                    // Path acceleration limit (mm/s^2)
+    double max_entry_speed;                 // Junction limit with the previous move (mm/s)
+    double entry_speed;                     // Planned speed at the start (mm/s)
+} motion_block_t;
+
+/**
+ * @brief Look-ahead buffer, oldest move first
+ */
+typedef struct {
+    motion_block_t blocks[MOTION_PLANNER_DEPTH];
+    uint32_t count;
+    int32_t position[MOTION_PLANNER_AXES];  // End of the last added move (steps)
+    double locked_entry;                    // Entry speed of blocks[0], fixed once its predecessor ran
+    bool has_previous;                      // A previous move exists to form a junction with
+    bool previous_isolated;
+    double previous_unit[MOTION_PLANNER_AXES];
+    double previous_nominal;
+    int32_t previous_sign[MOTION_PLANNER_AXES]; // Last direction each axis moved in, 0 if none yet
+} motion_planner_t;
+
+/**
+ * @brief Empty the buffer and start from a standstill at position
+ */
+void motion_planner_reset(motion_planner_t* planner, const int32_t position[MOTION_PLANNER_AXES]);
+
+/**
+ * @brief Add a move to target and compute its junction limit
+ *
+ * The caller must pop a move first when the buffer is full.
+ *
+ * @return false if the move has no length (nothing is added)
+ */
+bool motion_planner_add(motion_planner_t* planner, const int32_t target[MOTION_PLANNER_AXES],
+                        const motion_planner_limits_t* limits);
+
+/**
+ * @brief Recompute all entry speeds in the buffer (backward then forward pass)
+ */
+void motion_planner_recalculate(motion_planner_t* planner);
+
+/**
+ * @brief Planned speed at the end of the oldest move (0 if it is the last one)
+ */
+double motion_planner_exit_speed(const motion_planner_t* planner);
+
+/**
+ * @brief Time a move takes with its planned entry and given exit speed, in us
+ */
+uint32_t motion_planner_duration_us(const motion_block_t* block, double exit_speed);
+
+/**
+ * @brief Remove the oldest move and lock the next one's entry speed
+ */
+void motion_planner_pop(motion_planner_t* planner);
+
+static inline bool motion_planner_is_full(const motion_planner_t* planner) {
+    return planner->count >= MOTION_PLANNER_DEPTH;
+}
+
+#endif // MOTION_PLANNER_H
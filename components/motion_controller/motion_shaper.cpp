@@ -0,0 +1,185 @@
+/**
+ * @file motion_shaper.cpp
+ * @brief ZV / ZVD input shaping of planned moves
+ */
+
+#include "motion_shaper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Impulses or corners closer than this in time count as one (s)
+static constexpr double SHAPER_TIME_EPSILON = 1e-9;
+
+void motion_shaper_init(motion_shaper_t* shaper, motion_shaper_type_t type, double frequency, double damping) {
+    memset(shaper, 0, sizeof(*shaper));
+    shaper->count = 1;
+    shaper->amplitude[0] = 1.0;
+
+    if (type == MOTION_SHAPER_NONE || frequency <= 0.0) {
+        return;
+    }
+
+    damping = std::clamp(damping, 0.0, 0.99);
+    double root = sqrt(1.0 - damping * damping);
+    double k = exp(-damping * M_PI / root);
+    double half_period = 0.5 / (frequency * root);
+
+    if (type == MOTION_SHAPER_ZV) {
+        shaper->count = 2;
+        shaper->amplitude[0] = 1.0 / (1.0 + k);
+        shaper->amplitude[1] = k / (1.0 + k);
+        shaper->time[1] = half_period;
+    } else {
+        double norm = (1.0 + k) * (1.0 + k);
+        shaper->count = 3;
+        shaper->amplitude[0] = 1.0 / norm;
+        shaper->amplitude[1] = 2.0 * k / norm;
+        shaper->amplitude[2] = k * k / norm;
+        shaper->time[1] = half_period;
+        shaper->time[2] = 2.0 * half_period;
+    }
+}
+
+void motion_shaper_combine(const motion_shaper_t* a, const motion_shaper_t* b, motion_shaper_t* out) {
+    motion_shaper_t result = {};
+
+    for (uint32_t i = 0; i < a->count; i++) {
+        for (uint32_t j = 0; j < b->count; j++) {
+            double time = a->time[i] + b->time[j];
+            double amplitude = a->amplitude[i] * b->amplitude[j];
+
+            // Insert in time order, merging with an impulse at the same time
+            uint32_t k = 0;
+            while (k < result.count && result.time[k] < time - SHAPER_TIME_EPSILON) {
+                k++;
+            }
+            if (k < result.count && result.time[k] <= time + SHAPER_TIME_EPSILON) {
+                result.amplitude[k] += amplitude;
+                continue;
+            }
+            if (result.count == MOTION_SHAPER_MAX_IMPULSES) {
+                continue;   // Cannot happen with two shapers of at most three impulses
+            }
+            memmove(&result.time[k + 1], &result.time[k], (result.count - k) * sizeof(double));
+            memmove(&result.amplitude[k + 1], &result.amplitude[k], (result.count - k) * sizeof(double));
+            result.time[k] = time;
+            result.amplitude[k] = amplitude;
+            result.count++;
+        }
+    }
+
+    *out = result;
+}
+
+/**
+ * @brief Unshaped trapezoid, held at its entry speed before and exit speed after
+ */
+typedef struct {
+    double entry_speed;
+    double peak_speed;
+    double exit_speed;
+    double acceleration;
+    double corner[3];               // End of the ramp up, the cruise and the ramp down (s)
+} trapezoid_t;
+
+static double trapezoid_speed(const trapezoid_t* trapezoid, double t) {
+    if (t <= 0.0) {
+        return trapezoid->entry_speed;
+    }
+    if (t < trapezoid->corner[0]) {
+        return trapezoid->entry_speed + trapezoid->acceleration * t;
+    }
+    if (t < trapezoid->corner[1]) {
+        return trapezoid->peak_speed;
+    }
+    if (t < trapezoid->corner[2]) {
+        return trapezoid->peak_speed - trapezoid->acceleration * (t - trapezoid->corner[1]);
+    }
+    return trapezoid->exit_speed;
+}
+
+static double shaped_speed(const motion_shaper_t* shaper, const trapezoid_t* trapezoid, double t) {
+    double speed = 0.0;
+    for (uint32_t i = 0; i < shaper->count; i++) {
+        speed += shaper->amplitude[i] * trapezoid_speed(trapezoid, t - shaper->time[i]);
+    }
+    return speed;
+}
+
+uint32_t motion_shaper_plan(const motion_shaper_t* shaper, double length, double entry_speed,
+                            double nominal_speed, double exit_speed, double acceleration,
+                            motion_shaper_piece_t* pieces) {
+    if (length <= 0.0 || acceleration <= 0.0 || nominal_speed <= 0.0) {
+        return 0;
+    }
+
+    // The shaped move keeps entering and leaving at the boundary speeds while
+    // the impulses play out; plan the trapezoid short by that distance
+    double delay = motion_shaper_duration(shaper);
+    double centre = 0.0;
+    for (uint32_t i = 0; i < shaper->count; i++) {
+        centre += shaper->amplitude[i] * shaper->time[i];
+    }
+    double planned = length - entry_speed * centre - exit_speed * (delay - centre);
+    if (planned <= 0.0) {
+        return 0;
+    }
+
+    trapezoid_t trapezoid = {};
+    trapezoid.entry_speed = entry_speed;
+    trapezoid.exit_speed = exit_speed;
+    trapezoid.acceleration = acceleration;
+
+    double peak = nominal_speed;
+    double up = (peak * peak - entry_speed * entry_speed) / (2.0 * acceleration);
+    double down = (peak * peak - exit_speed * exit_speed) / (2.0 * acceleration);
+    double cruise = planned - up - down;
+    if (cruise < 0.0) {
+        // Triangle: peak where the two ramps meet
+        peak = sqrt(acceleration * planned + (entry_speed * entry_speed + exit_speed * exit_speed) / 2.0);
+        cruise = 0.0;
+        double floor = std::max(entry_speed, exit_speed);
+        if (peak < floor - 1e-9) {
+            return 0;
+        }
+        peak = std::max(peak, floor);
+    }
+    trapezoid.peak_speed = peak;
+    trapezoid.corner[0] = (peak - entry_speed) / acceleration;
+    trapezoid.corner[1] = trapezoid.corner[0] + cruise / peak;
+    trapezoid.corner[2] = trapezoid.corner[1] + (peak - exit_speed) / acceleration;
+
+    // The shaped speed bends wherever a copy of the trapezoid has a corner.
+    // Each copy's bends are already in order, so they are merged in place
+    // rather than collected and sorted, to keep the caller's stack small.
+    const double offset[4] = { 0.0, trapezoid.corner[0], trapezoid.corner[1], trapezoid.corner[2] };
+    uint32_t next[MOTION_SHAPER_MAX_IMPULSES] = {};
+    uint32_t n = 0;
+    double start = 0.0;
+    while (true) {
+        uint32_t copy = shaper->count;
+        double bend = 0.0;
+        for (uint32_t i = 0; i < shaper->count; i++) {
+            if (next[i] < 4 && (copy == shaper->count || shaper->time[i] + offset[next[i]] < bend)) {
+                copy = i;
+                bend = shaper->time[i] + offset[next[i]];
+            }
+        }
+        if (copy == shaper->count) {
+            break;
+        }
+        next[copy]++;
+
+        if (bend <= start + SHAPER_TIME_EPSILON) {
+            continue;
+        }
+        pieces[n].duration = bend - start;
+        pieces[n].start_speed = shaped_speed(shaper, &trapezoid, start);
+        pieces[n].end_speed = shaped_speed(shaper, &trapezoid, bend);
+        start = bend;
+        n++;
+    }
+    return n;
+}
@@ -8,6 +8,7 @@
 #include "StepperMotor.hpp"
 #include "esp_log.h"
 #include <stdexcept>
+#include <cstdlib>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"  // Add this line for vTaskDelay
 
@@ -43,11 +44,23 @@ StepperMotor::StepperMotor(StepperMotor&& other) noexcept :
     position_(other.position_),
     handle_(other.handle_),
     target_position_(other.target_position_),
-    steps_per_mm(other.steps_per_mm)
+    steps_per_mm(other.steps_per_mm),
+    positive_direction_(other.positive_direction_),
+    net_sync_(other.net_sync_),
+    queue_end_(other.queue_end_),
+    move_pending_(other.move_pending_),
+    homing_move_(other.homing_move_),
+    position_trusted_(other.position_trusted_),
+    endpoint_error_(other.endpoint_error_),
+    backlash_(other.backlash_),
+    play_(other.play_),
+    takeup_net_(other.takeup_net_),
+    move_takeup_(other.move_takeup_)
 {
     other.handle_ = nullptr;
     other.position_ = 0;
     other.target_position_ = 0;
+    other.position_trusted_ = false;
 }
 
 // Move assignment operator
@@ -63,11 +76,23 @@ StepperMotor& StepperMotor::operator=(StepperMotor&& other) noexcept {
         handle_ = other.handle_;
         target_position_ = other.target_position_;
         steps_per_mm = other.steps_per_mm;
+        positive_direction_ = other.positive_direction_;
+        net_sync_ = other.net_sync_;
+        queue_end_ = other.queue_end_;
+        move_pending_ = other.move_pending_;
+        homing_move_ = other.homing_move_;
+        position_trusted_ = other.position_trusted_;
+        endpoint_error_ = other.endpoint_error_;
+        backlash_ = other.backlash_;
+        play_ = other.play_;
+        takeup_net_ = other.takeup_net_;
+        move_takeup_ = other.move_takeup_;
 
         // Reset other
         other.handle_ = nullptr;
         other.position_ = 0;
         other.target_position_ = 0;
+        other.position_trusted_ = false;
     }
     return *this;
 }
@@ -77,6 +102,10 @@ void StepperMotor::setEnable(bool enable) {
         ESP_LOGW(TAG, "Motor not initialized");
         return;
     }
+    if (!enable) {
+        // Without holding torque the axis may be pushed around
+        setPositionTrusted(false);
+    }
     stepper_motor_hal_set_enable(handle_, enable);
 }
 
@@ -93,32 +122,166 @@ void StepperMotor::step() {
         ESP_LOGW(TAG, "Motor not initialized");
         return;
     }
-    stepper_motor_hal_step(handle_, 200);
-
-    // Update position based on direction
-    if (stepper_motor_hal_get_direction(handle_) == STEPPER_DIR_CLOCKWISE) {
-        position_++;
-    } else {
-        position_--;
-    }
+    // Position follows the HAL step counter
+    stepper_motor_hal_step(handle_, stepper_motor_hal_get_pulse_width(handle_), stepper_motor_hal_get_step_time(handle_));
 }
 
 void StepperMotor::stepMultiple(uint32_t steps) {
     if (!handle_) return;
 
-    // Update position based on direction
-    if (stepper_motor_hal_get_direction(handle_) == positive_direction_) {
-        position_ += steps;
-    } else {
-        position_ -= steps;
+    if (startMove(steps)) {
+        waitForMove();
+    }
+}
+
+bool StepperMotor::startMove(uint32_t steps) {
+    if (isMoving()) {
+        return false;
+    }
+
+    int32_t sign = (stepper_motor_hal_get_direction(handle_) == positive_direction_) ? 1 : -1;
+    int32_t takeup = takeupSteps(sign);
+    if (!stepper_motor_hal_start_move(handle_, steps + takeup)) {
+        return false;
+    }
+
+    recordTakeup(sign, takeup);
+    move_takeup_ = sign * takeup;
+    move_pending_ = true;
+    homing_move_ = false;
+    return true;
+}
+
+int32_t StepperMotor::takeupSteps(int32_t sign) const {
+    return (sign > 0) ? backlash_ - play_ : play_;
+}
+
+void StepperMotor::recordTakeup(int32_t sign, int32_t takeup) {
+    takeup_net_ += sign * takeup;
+    play_ = (sign > 0) ? backlash_ : 0;
+    move_takeup_ = 0;
+}
+
+bool StepperMotor::queueTakeup(int32_t sign, uint32_t timeout_ms) {
+    int32_t takeup = takeupSteps(sign);
+    if (takeup == 0) {
+        return true;
+    }
+
+    stepper_direction_t reverse = (positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                      ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+    if (!stepper_motor_hal_queue_move(handle_, static_cast<uint32_t>(takeup),
+                                      sign > 0 ? positive_direction_ : reverse, timeout_ms)) {
+        return false;
+    }
+
+    recordTakeup(sign, takeup);
+    move_pending_ = true;
+    return true;
+}
+
+uint32_t StepperMotor::takeupTimeUs(int32_t position) {
+    if (handle_ == nullptr) {
+        return 0;
     }
 
-    stepper_motor_hal_step_multiple(handle_, steps);
+    int32_t from = isMoving() ? queue_end_ : getPosition();
+    if (position == from) {
+        return 0;
+    }
+    uint32_t takeup = static_cast<uint32_t>(takeupSteps(position > from ? 1 : -1));
+    return takeup > 0 ? moveTimeUs(takeup, takeup) : 0;
+}
+
+void StepperMotor::finishMove() {
+    if (!move_pending_) {
+        return;
+    }
+
+    if (move_takeup_ != 0) {
+        // Cut short (switch, abort, RMT burst) before the play was taken up
+        int32_t done = static_cast<int32_t>(stepper_motor_hal_get_steps_done(handle_));
+        int32_t missing = std::abs(move_takeup_) - done;
+        if (missing > 0) {
+            int32_t sign = (move_takeup_ > 0) ? 1 : -1;
+            takeup_net_ -= sign * missing;
+            play_ = (sign > 0) ? backlash_ - missing : missing;
+        }
+        move_takeup_ = 0;
+    }
+
+    position_ = getPosition();
+    net_sync_ = stepper_motor_hal_get_net_steps(handle_);
+    takeup_net_ = 0;
+    move_pending_ = false;
 
     if (isEndpointReached()) {
-        ESP_LOGW(TAG, "Endpoint reached during stepMultiple. Reseting position to 0");
+        endpoint_error_ = position_;
+        if (!homing_move_) {
+            if (std::abs(position_) > um_to_microsteps(CONFIG_MOTION_HOMING_TOLERANCE_UM)) {
+                // The switch is not where the position says it is
+                ESP_LOGW(TAG, "Endpoint reached %ld steps from 0", (long)position_);
+                setPositionTrusted(false);
+            }
+            ESP_LOGW(TAG, "Endpoint reached during stepMultiple. Reseting position to 0");
+        }
         position_ = 0;
     }
+    homing_move_ = false;
+}
+
+void StepperMotor::stop() {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+    if (stepper_motor_hal_is_moving(handle_)) {
+        // Cut short at speed, the axis may have slipped
+        setPositionTrusted(false);
+    }
+    stepper_motor_hal_stop(handle_);
+    finishMove();
+}
+
+void StepperMotor::setPositionTrusted(bool trusted) {
+    if (position_trusted_ && !trusted) {
+        ESP_LOGI(TAG, "Position no longer trusted, homing needed");
+    }
+    position_trusted_ = trusted;
+}
+
+bool StepperMotor::isMoving() {
+    if (handle_ == nullptr) {
+        return false;
+    }
+
+    if (stepper_motor_hal_is_moving(handle_)) {
+        return true;
+    }
+
+    finishMove();
+    return false;
+}
+
+bool StepperMotor::stoppedAbruptly() const {
+    if (handle_ == nullptr) {
+        return false;
+    }
+    return stepper_motor_hal_stopped_abruptly(handle_);
+}
+
+bool StepperMotor::waitForMove(uint32_t timeout_ms) {
+    if (handle_ == nullptr) {
+        return true;
+    }
+
+    if (!stepper_motor_hal_wait_move_done(handle_, timeout_ms)) {
+        ESP_LOGW(TAG, "Timed out waiting for move to finish");
+        return false;
+    }
+
+    finishMove();
+    return true;
 }
 
 void StepperMotor::setTargetPosition(int32_t position) {
@@ -139,14 +302,16 @@ void StepperMotor::stepToTarget() {
 
     int32_t current_pos = getPosition();
 
+    stepper_direction_t reverse = (positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                      ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
     if (current_pos < target_position_) {
         // Move forward
-        stepper_motor_hal_set_direction(handle_, STEPPER_DIR_CLOCKWISE);
-        step();  // Use step() method which handles position tracking
+        stepper_motor_hal_set_direction(handle_, positive_direction_);
+        step();
     } else if (current_pos > target_position_) {
         // Move backward
-        stepper_motor_hal_set_direction(handle_, STEPPER_DIR_COUNTERCLOCKWISE);
-        step();  // Use step() method which handles position tracking
+        stepper_motor_hal_set_direction(handle_, reverse);
+        step();
     }
     // If current_pos == target_position_, do nothing
 }
@@ -157,6 +322,10 @@ void StepperMotor::stepMultipleToTarget(uint32_t max_steps) {
         return;
     }
 
+    if (isMoving()) {
+        return; // Previous move still running
+    }
+
     int32_t current_pos = getPosition();
     int32_t remaining_steps = target_position_ - current_pos;
 
@@ -176,16 +345,274 @@ void StepperMotor::stepMultipleToTarget(uint32_t max_steps) {
     stepper_motor_hal_set_direction(handle_, dir);
 
     // Limit steps to max_steps
-    uint32_t steps_to_execute = std::min(static_cast<uint32_t>(remaining_steps), max_steps);
+    uint32_t steps_to_execute = std::min(static_cast<uint32_t>(std::abs(remaining_steps)), max_steps);
 
     ESP_LOGI(TAG, "Current position: %d, Target: %d", current_pos, target_position_);
     ESP_LOGI(TAG, "Remaining steps: %d, Steps to execute: %u", remaining_steps, steps_to_execute);
 
-    stepMultiple(steps_to_execute);
+    startMove(steps_to_execute);
+}
+
+bool StepperMotor::stepTogetherToTarget(StepperMotor* const motors[], size_t count) {
+    if (count > STEPPER_GROUP_MAX_AXES) {
+        ESP_LOGE(TAG, "Too many motors in group: %u", (unsigned)count);
+        return false;
+    }
+
+    stepper_motor_move_t moves[STEPPER_GROUP_MAX_AXES];
+    StepperMotor* started[STEPPER_GROUP_MAX_AXES];
+    int32_t signs[STEPPER_GROUP_MAX_AXES];
+    int32_t takeup[STEPPER_GROUP_MAX_AXES];
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        StepperMotor* motor = motors[i];
+        if (motor == nullptr || motor->handle_ == nullptr || motor->isMoving()) {
+            continue;
+        }
+
+        int32_t remaining_steps = motor->target_position_ - motor->getPosition();
+        if (remaining_steps == 0) {
+            continue;
+        }
+
+        stepper_direction_t reverse = (motor->positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                          ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+        int32_t sign = remaining_steps > 0 ? 1 : -1;
+        takeup[n] = motor->takeupSteps(sign);
+        moves[n].handle = motor->handle_;
+        moves[n].steps = static_cast<uint32_t>(std::abs(remaining_steps) + takeup[n]);
+        moves[n].direction = remaining_steps > 0 ? motor->positive_direction_ : reverse;
+        signs[n] = sign;
+        started[n++] = motor;
+    }
+
+    if (n == 0) {
+        return true;
+    }
+
+    bool ok = stepper_motor_hal_start_group(moves, n);
+    for (size_t i = 0; i < n; i++) {
+        if (ok) {
+            started[i]->recordTakeup(signs[i], takeup[i]);
+        }
+        started[i]->move_pending_ = ok;
+    }
+
+    return ok;
+}
+
+bool StepperMotor::queueMoveTo(int32_t position, uint32_t timeout_ms) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return false;
+    }
+
+    if (!isMoving()) {
+        queue_end_ = getPosition();
+    }
+
+    int32_t delta = position - queue_end_;
+    if (delta == 0) {
+        return true;
+    }
+
+    stepper_direction_t reverse = (positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                      ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+    if (!queueTakeup(delta > 0 ? 1 : -1, timeout_ms) ||
+        !stepper_motor_hal_queue_move(handle_, static_cast<uint32_t>(std::abs(delta)),
+                                      delta > 0 ? positive_direction_ : reverse, timeout_ms)) {
+        return false;
+    }
+
+    queue_end_ = position;
+    move_pending_ = true;
+    return true;
+}
+
+bool StepperMotor::queueSegmentTo(int32_t position, const stepper_motor_segment_t& profile, uint32_t timeout_ms) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return false;
+    }
+
+    if (!isMoving()) {
+        queue_end_ = getPosition();
+    }
+
+    int32_t delta = position - queue_end_;
+    if (delta == 0) {
+        return true;
+    }
+
+    stepper_direction_t reverse = (positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                      ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+    stepper_motor_segment_t segment = profile;
+    segment.steps = static_cast<uint32_t>(std::abs(delta));
+    segment.direction = delta > 0 ? positive_direction_ : reverse;
+    if (!queueTakeup(delta > 0 ? 1 : -1, timeout_ms) ||
+        !stepper_motor_hal_queue_segment(handle_, &segment, timeout_ms)) {
+        return false;
+    }
+
+    queue_end_ = position;
+    move_pending_ = true;
+    return true;
+}
+
+bool StepperMotor::queueHold(uint32_t duration_us, uint32_t timeout_ms) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return false;
+    }
+
+    stepper_motor_segment_t segment = {};
+    segment.direction = stepper_motor_hal_get_direction(handle_);
+    segment.hold_us = duration_us;
+    if (!stepper_motor_hal_queue_segment(handle_, &segment, timeout_ms)) {
+        return false;
+    }
+
+    move_pending_ = true;
+    return true;
+}
+
+void StepperMotor::beginQueue() {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+    stepper_motor_hal_queue_begin(handle_);
+}
+
+void StepperMotor::endQueue() {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+    stepper_motor_hal_queue_end(handle_);
+}
+
+stepper_queue_stats_t StepperMotor::getQueueStats() const {
+    stepper_queue_stats_t stats = {};
+    if (handle_ != nullptr) {
+        stepper_motor_hal_get_queue_stats(handle_, &stats);
+    }
+    return stats;
+}
+
+void StepperMotor::resetQueueStats() {
+    if (handle_ != nullptr) {
+        stepper_motor_hal_reset_queue_stats(handle_);
+    }
+}
+
+uint32_t StepperMotor::moveTimeUs(uint32_t steps, uint32_t until_step) const {
+    if (handle_ == nullptr) {
+        return 0;
+    }
+    return stepper_motor_hal_move_time_us(handle_, steps, until_step);
+}
+
+bool StepperMotor::stepLinearToTarget(StepperMotor* const motors[], size_t count) {
+    if (count > STEPPER_GROUP_MAX_AXES) {
+        ESP_LOGE(TAG, "Too many motors in linear move: %u", (unsigned)count);
+        return false;
+    }
+
+    stepper_motor_move_t moves[STEPPER_GROUP_MAX_AXES];
+    StepperMotor* started[STEPPER_GROUP_MAX_AXES];
+    int32_t signs[STEPPER_GROUP_MAX_AXES];
+    int32_t takeup[STEPPER_GROUP_MAX_AXES];
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        StepperMotor* motor = motors[i];
+        if (motor == nullptr || motor->handle_ == nullptr) {
+            continue;
+        }
+        if (motor->isMoving()) {
+            ESP_LOGW(TAG, "Linear move rejected, motor busy");
+            return false;
+        }
+
+        int32_t remaining_steps = motor->target_position_ - motor->getPosition();
+        if (remaining_steps == 0) {
+            continue;
+        }
+
+        stepper_direction_t reverse = (motor->positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                          ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+        int32_t sign = remaining_steps > 0 ? 1 : -1;
+        takeup[n] = motor->takeupSteps(sign);
+        moves[n].handle = motor->handle_;
+        moves[n].steps = static_cast<uint32_t>(std::abs(remaining_steps) + takeup[n]);
+        moves[n].direction = remaining_steps > 0 ? motor->positive_direction_ : reverse;
+        signs[n] = sign;
+        started[n++] = motor;
+    }
+
+    if (n == 0) {
+        return true;
+    }
+
+    bool ok = stepper_motor_hal_start_linear(moves, n);
+    for (size_t i = 0; i < n; i++) {
+        if (ok) {
+            started[i]->recordTakeup(signs[i], takeup[i]);
+        }
+        started[i]->move_pending_ = ok;
+    }
+
+    return ok;
+}
+
+void StepperMotor::setMotionLimits(double max_velocity_mm_s, double max_acceleration_mm_s2) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+
+    double max_velocity = max_velocity_mm_s * steps_per_mm;
+    if (max_velocity <= 0.0) {
+        ESP_LOGW(TAG, "Invalid max velocity %.2f mm/s", max_velocity_mm_s);
+        return;
+    }
+
+    stepper_motor_hal_set_step_time(handle_, static_cast<uint32_t>(1000000.0 / max_velocity));
+    stepper_motor_hal_set_acceleration(handle_, max_acceleration_mm_s2 * steps_per_mm);
+
+    ESP_LOGI(TAG, "Motion limits: %.1f mm/s (%lu us/step), %.1f mm/s^2",
+             max_velocity_mm_s, stepper_motor_hal_get_step_time(handle_), max_acceleration_mm_s2);
+}
+
+void StepperMotor::setMotionProfile(stepper_profile_t profile, double max_jerk_mm_s3) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+
+    stepper_motor_hal_set_profile(handle_, profile, max_jerk_mm_s3 * steps_per_mm);
+}
+
+void StepperMotor::setAccelTable(const stepper_accel_table_t* table) {
+    if (handle_ == nullptr) {
+        ESP_LOGW(TAG, "Motor not initialized");
+        return;
+    }
+
+    stepper_motor_hal_set_accel_table(handle_, table);
+}
+
+int32_t StepperMotor::positionSign() const {
+    return (positive_direction_ == STEPPER_DIR_CLOCKWISE) ? 1 : -1;
 }
 
 int32_t StepperMotor::getPosition() const {
-    return position_;
+    if (handle_ == nullptr) {
+        return position_;
+    }
+    return position_ + positionSign() * (stepper_motor_hal_get_net_steps(handle_) - net_sync_) - takeup_net_;
 }
 
 int32_t StepperMotor::getTargetPosition() const {
@@ -197,8 +624,15 @@ void StepperMotor::resetPosition() {
         ESP_LOGW(TAG, "Motor not initialized");
         return;
     }
+    stepper_motor_hal_stop(handle_);
     position_ = 0;
     target_position_ = 0;
+    queue_end_ = 0;
+    net_sync_ = stepper_motor_hal_get_net_steps(handle_);
+    takeup_net_ = 0;
+    move_takeup_ = 0;
+    move_pending_ = false;
+    homing_move_ = false;
     ESP_LOGI(TAG, "Position reset to 0");
 }
 
@@ -210,38 +644,44 @@ bool StepperMotor::isEndpointReached() const {
     return stepper_motor_hal_endpoint_reached(handle_);
 }
 
-void StepperMotor::calibrate() {
+bool StepperMotor::startHoming(double velocity_mm_s, uint32_t max_steps) {
     if (handle_ == nullptr) {
         ESP_LOGW(TAG, "Motor not initialized");
-        return;
+        return false;
     }
 
-    ESP_LOGI(TAG, "Calibrating motor...");
-
-    // Move towards endpoint until switch is triggered
-    stepper_motor_hal_set_direction(handle_, STEPPER_DIR_COUNTERCLOCKWISE);
-    bool ennable_state = stepper_motor_hal_get_direction(handle_);
-    setEnable(true);
-
-    setDirection((positive_direction_ == STEPPER_DIR_CLOCKWISE) ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE);
+    if (isMoving()) {
+        return false;
+    }
 
-    while (!isEndpointReached()) {
-        stepper_motor_hal_step_multiple(handle_, 100); // Step in small increments
-        vTaskDelay(pdMS_TO_TICKS(2)); // Small delay to avoid busy-waiting
+    stepper_direction_t towards_endpoint = (positive_direction_ == STEPPER_DIR_CLOCKWISE)
+                                               ? STEPPER_DIR_COUNTERCLOCKWISE : STEPPER_DIR_CLOCKWISE;
+    int32_t takeup = takeupSteps(-1);
+    if (!stepper_motor_hal_start_homing(handle_, max_steps + takeup, towards_endpoint, velocity_mm_s * steps_per_mm)) {
+        return false;
     }
 
-    // Reset position to zero at endpoint
-    resetPosition();
+    recordTakeup(-1, takeup);
+    move_takeup_ = -takeup;
+    move_pending_ = true;
+    homing_move_ = true;
+    return true;
+}
 
-    setEnable(ennable_state);
+void StepperMotor::setBacklash(coord_um_t backlash) {
+    backlash_ = std::max(int32_t(0), um_to_microsteps(backlash));
+    play_ = std::min(play_, backlash_);
+    ESP_LOGI(TAG, "Backlash compensation: %ld steps", (long)backlash_);
+}
 
-    ESP_LOGI(TAG, "Motor calibrated to endpoint");
+coord_um_t StepperMotor::getBacklash() const {
+    return microsteps_to_um(backlash_);
 }
 
-int32_t StepperMotor::microsteps_to_mm(int32_t microsteps) {
-    return (int32_t)(microsteps / steps_per_mm);
+coord_um_t StepperMotor::microsteps_to_um(int32_t microsteps) const {
+    return coord_steps_to_um(microsteps, steps_per_mm);
 }
 
-int32_t StepperMotor::mm_to_microsteps(int32_t mm) {
-    return (int32_t)(mm * steps_per_mm);
+int32_t StepperMotor::um_to_microsteps(coord_um_t um) const {
+    return coord_um_to_steps(um, steps_per_mm);
 }
\ No newline at end of file
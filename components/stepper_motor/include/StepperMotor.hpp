@@ -10,6 +10,8 @@
 #define STEPPER_MOTOR_HPP
 
 #include "stepper_motor_hal.h"
+#include "motion_coord.h"
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 
@@ -24,6 +26,58 @@ private:
     int32_t target_position_;
     int32_t steps_per_mm;
     stepper_direction_t positive_direction_ = STEPPER_DIR_COUNTERCLOCKWISE;
+    // HAL net step count at which position_ was last updated
+    int32_t net_sync_ = 0;
+    // Position at the end of the last queued segment
+    int32_t queue_end_ = 0;
+    bool move_pending_ = false;
+    // Running move is a homing seek, expected to end on the endpoint switch
+    bool homing_move_ = false;
+    // Position known since the last homing (see isPositionTrusted())
+    bool position_trusted_ = false;
+    // Tracked position when the last move ended on the endpoint switch
+    int32_t endpoint_error_ = 0;
+    // Play in the drive in steps, taken up on every reversal (0 = off)
+    int32_t backlash_ = 0;
+    // Motor within the play: 0 against the negative side, backlash_ against the positive
+    int32_t play_ = 0;
+    // Take-up steps of the running moves, not part of the position
+    int32_t takeup_net_ = 0;
+    // Take-up at the start of the running single move, for a move cut short
+    int32_t move_takeup_ = 0;
+
+    /**
+     * @brief +1 if clockwise steps increase the position, -1 otherwise
+     */
+    int32_t positionSign() const;
+
+    /**
+     * @brief Start a background move of given steps in current direction
+     */
+    bool startMove(uint32_t steps);
+
+    /**
+     * @brief Fold a finished background move into position_
+     */
+    void finishMove();
+
+    /**
+     * @brief Steps a move in direction sign (+1/-1) needs first to take up the play
+     */
+    int32_t takeupSteps(int32_t sign) const;
+
+    /**
+     * @brief Note a started move's take-up so the position leaves it out
+     */
+    void recordTakeup(int32_t sign, int32_t takeup);
+
+    /**
+     * @brief Queue the take-up ahead of a queued move in direction sign
+     *
+     * A segment of its own at the motor's limits, from rest to rest, so the
+     * move behind it keeps its planned length and timing.
+     */
+    bool queueTakeup(int32_t sign, uint32_t timeout_ms);
 
 public:
     /**
@@ -62,7 +116,7 @@ public:
     void step();
     
     /**
-     * @brief Execute multiple steps
+     * @brief Execute multiple steps (blocks until done)
      */
     void stepMultiple(uint32_t steps);
 
@@ -77,12 +131,168 @@ public:
     void stepToTarget();
 
     /**
-     * @brief Execute multiple steps towards target position
+     * @brief Start multiple steps towards target position
+     *
+     * Returns immediately, pulses are generated by the step timer. Does nothing
+     * while a previous move is still running. Use isMoving() or waitForMove()
+     * to find out when the move has finished.
      */
     void stepMultipleToTarget(uint32_t steps);
 
     /**
-     * @brief Get current position
+     * @brief Start several motors towards their targets together
+     *
+     * Like stepMultipleToTarget() for each motor, but the moves are started
+     * as one group: with the multi-axis step backend all DIR lines are set
+     * at once and the first pulses of every axis coincide. Motors that are
+     * busy or already at their target are left out.
+     *
+     * @param motors Motors to start
+     * @param count Number of motors (at most STEPPER_GROUP_MAX_AXES)
+     * @return true if the group was started (or nothing had to move)
+     */
+    static bool stepTogetherToTarget(StepperMotor* const motors[], size_t count);
+
+    /**
+     * @brief Move several motors to their targets along a straight line
+     *
+     * The motor with the most steps leads under one velocity profile and the
+     * others are interpolated from it (see stepper_motor_hal_start_linear()),
+     * so all motors arrive together. Returns immediately; fails if any motor
+     * is still busy.
+     *
+     * @param motors Motors to move
+     * @param count Number of motors (at most STEPPER_GROUP_MAX_AXES)
+     * @return true if the move was started (or nothing had to move)
+     */
+    static bool stepLinearToTarget(StepperMotor* const motors[], size_t count);
+
+    /**
+     * @brief Queue a move to an absolute position behind the running ones
+     *
+     * The move is planned now and started by the step ISR the moment the
+     * previous segment ends, so a path of short moves runs without gaps.
+     * Targets are relative to the end of the last queued segment.
+     *
+     * @param position Absolute target in steps
+     * @param timeout_ms Maximum time to wait for a free queue slot
+     * @return true if the move was queued
+     */
+    bool queueMoveTo(int32_t position, uint32_t timeout_ms = 1000);
+
+    /**
+     * @brief Queue a segment to an absolute position with explicit limits
+     *
+     * Like queueMoveTo(), but speeds come from the profile instead of the
+     * motor's limits, so the segment can start and end in motion. Steps and
+     * direction of the profile are filled in from the position.
+     *
+     * @param position Absolute target in steps
+     * @param profile Limits and entry/exit speeds in steps/s
+     * @param timeout_ms Maximum time to wait for a free queue slot
+     * @return true if the segment was queued
+     */
+    bool queueSegmentTo(int32_t position, const stepper_motor_segment_t& profile, uint32_t timeout_ms = 1000);
+
+    /**
+     * @brief Queue a pause behind the running segments
+     *
+     * Keeps an axis that does not take part in one move of a blended path
+     * in step with the others.
+     *
+     * @param duration_us Length of the pause
+     * @param timeout_ms Maximum time to wait for a free queue slot
+     * @return true if the pause was queued
+     */
+    bool queueHold(uint32_t duration_us, uint32_t timeout_ms = 1000);
+
+    /**
+     * @brief Time the take-up ahead of a queued move to position takes, in us
+     *
+     * queueMoveTo() and queueSegmentTo() run the take-up of a reversal as a
+     * segment of its own before the move; other axes that have to stay in
+     * step hold for this long. 0 if the move keeps the direction or the axis
+     * has no play.
+     */
+    uint32_t takeupTimeUs(int32_t position);
+
+    /**
+     * @brief Start counting queue underruns (producer will keep the queue fed)
+     */
+    void beginQueue();
+
+    /**
+     * @brief Stop counting queue underruns
+     */
+    void endQueue();
+
+    /**
+     * @brief Get segment queue depth, high-water mark and underrun count
+     */
+    stepper_queue_stats_t getQueueStats() const;
+
+    /**
+     * @brief Clear the high-water mark and the underrun and segment counts
+     */
+    void resetQueueStats();
+
+    /**
+     * @brief Time a queued move of the given length takes to reach until_step
+     *
+     * Uses the same ramp the move would run with the current limits.
+     *
+     * @return Time in microseconds, 0 if not initialized
+     */
+    uint32_t moveTimeUs(uint32_t steps, uint32_t until_step) const;
+
+    /**
+     * @brief Abort the running move and drop queued segments
+     */
+    void stop();
+
+    /**
+     * @brief Check if a background move is still running
+     */
+    bool isMoving();
+
+    /**
+     * @brief Check if the last move stopped without ramping down (aborted,
+     *        or the segment queue ran dry at speed)
+     */
+    bool stoppedAbruptly() const;
+
+    /**
+     * @brief Block until the background move finishes
+     * @param timeout_ms Maximum time to wait
+     * @return true if the motor is idle, false on timeout
+     */
+    bool waitForMove(uint32_t timeout_ms = 120000);
+
+    /**
+     * @brief Set speed and acceleration limits in physical units
+     * @param max_velocity_mm_s Cruise speed in mm/s
+     * @param max_acceleration_mm_s2 Acceleration and deceleration in mm/s^2
+     *
+     * Converted to steps with this motor's steps per millimeter. Applies to
+     * the next move.
+     */
+    void setMotionLimits(double max_velocity_mm_s, double max_acceleration_mm_s2);
+
+    /**
+     * @brief Select trapezoidal or jerk-limited S-curve moves
+     * @param profile Profile shape
+     * @param max_jerk_mm_s3 Jerk limit in mm/s^3 (S-curve only)
+     */
+    void setMotionProfile(stepper_profile_t profile, double max_jerk_mm_s3 = 0.0);
+
+    /**
+     * @brief Use a precomputed acceleration table for trapezoidal ramps
+     * @param table Table to use (must outlive the motor), nullptr to disable
+     */
+    void setAccelTable(const stepper_accel_table_t* table);
+
+    /**
+     * @brief Get current position (live while a move is running)
      */
     int32_t getPosition() const;
     
@@ -96,6 +306,47 @@ public:
      */
     void resetPosition();
     
+    /**
+     * @brief Check whether the position still counts from the last homing
+     *
+     * Set by the homing routine. Lost when the motor is disabled, when a
+     * running move is aborted, when the endpoint switch is found closed at
+     * the end of an ordinary move further from 0 than
+     * CONFIG_MOTION_HOMING_TOLERANCE_UM, and on reboot.
+     */
+    bool isPositionTrusted() const { return position_trusted_; }
+
+    /**
+     * @brief Mark the position as homed (or no longer known)
+     */
+    void setPositionTrusted(bool trusted);
+
+    /**
+     * @brief Tracked position when the last move ended on the endpoint switch
+     *
+     * 0 means the switch closed exactly where the position said it would;
+     * anything else is steps lost (or gained) since the position was last
+     * set. The position itself is reset to 0 at the switch.
+     */
+    int32_t getEndpointError() const { return endpoint_error_; }
+
+    /**
+     * @brief Set the play (backlash) in this axis' drive
+     *
+     * Every move that reverses direction starts with this many extra steps,
+     * so the axis lands on the same spot from either side. Queued moves run
+     * them as a segment of their own first (see takeupTimeUs()). The extra
+     * steps are not part of the position once the move has ended; while it
+     * runs the position may read up to the play off. Single step() calls are
+     * not compensated.
+     */
+    void setBacklash(coord_um_t backlash);
+
+    /**
+     * @brief Get the play compensated on reversals
+     */
+    coord_um_t getBacklash() const;
+
     /**
      * @brief Check if motor is initialized
      */
@@ -108,19 +359,27 @@ public:
     bool isEndpointReached() const;
 
     /**
-     * @brief Convert millimeters to microsteps for current motor configuration
+     * @brief Convert micrometres to the nearest microstep for current motor configuration
      */
-    int32_t mm_to_microsteps(int32_t mm);
+    int32_t um_to_microsteps(coord_um_t um) const;
 
     /**
-     * @brief Convert microsteps to millimeters for current motor configuration
+     * @brief Convert microsteps to the nearest micrometre for current motor configuration
      */
-    int32_t microsteps_to_mm(int32_t microsteps);
+    coord_um_t microsteps_to_um(int32_t microsteps) const;
 
     /**
-     * @brief Calibrate motor by moving to endpoint switch
+     * @brief Start moving towards the endpoint switch, stopping as it closes
+     *
+     * Non-blocking. Once the move has ended on the switch the position
+     * reads 0. A seek that ends with the switch still open covered its
+     * whole distance (or, with the RMT backend, one short burst).
+     *
+     * @param velocity_mm_s Seek speed
+     * @param max_steps Longest distance to travel
+     * @return true if the seek was started
      */
-    void calibrate();
+    bool startHoming(double velocity_mm_s, uint32_t max_steps);
 };
 
 #endif // STEPPER_MOTOR_HPP
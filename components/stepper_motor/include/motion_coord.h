@@ -0,0 +1,82 @@
+/**
+ * @file motion_coord.h
+ * @brief Fixed-point machine coordinates
+ *
+ * Positions are carried as whole micrometres from the G-Code parser through
+ * the motion controller down to step targets. Converting to and from steps
+ * is integer arithmetic rounded to the nearest step, so 23.25 mm stays
+ * 23.25 mm and no double-precision math (software-emulated on the ESP32)
+ * is needed on the way. An int32_t covers +/-2147 m.
+ */
+
+#ifndef MOTION_COORD_H
+#define MOTION_COORD_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+#define MOTION_COORD_FN constexpr
+extern "C" {
+#else
+#define MOTION_COORD_FN static inline
+#endif
+
+/**
+ * @brief Length or position in micrometres
+ */
+typedef int32_t coord_um_t;
+
+/**
+ * @brief Micrometres per millimetre
+ */
+#define COORD_UM_PER_MM 1000
+
+/**
+ * @brief Whole millimetres (e.g. a Kconfig value) as a coordinate
+ */
+#define COORD_UM_FROM_MM(mm) ((coord_um_t)(mm) * COORD_UM_PER_MM)
+
+/**
+ * @brief Coordinate to the nearest step of an axis
+ */
+MOTION_COORD_FN int32_t coord_um_to_steps(coord_um_t um, int32_t steps_per_mm) {
+    return (int32_t)((((int64_t)um * steps_per_mm) +
+                      ((um < 0) ? -(COORD_UM_PER_MM / 2) : (COORD_UM_PER_MM / 2))) / COORD_UM_PER_MM);
+}
+
+/**
+ * @brief Step position of an axis to the nearest micrometre
+ */
+MOTION_COORD_FN coord_um_t coord_steps_to_um(int32_t steps, int32_t steps_per_mm) {
+    return (coord_um_t)((((int64_t)steps * COORD_UM_PER_MM) +
+                         ((steps < 0) ? -(steps_per_mm / 2) : (steps_per_mm / 2))) / steps_per_mm);
+}
+
+/**
+ * @brief Coordinate in mm, for logging and reporting only
+ */
+static inline double coord_um_to_mm(coord_um_t um) {
+    return um / (double)COORD_UM_PER_MM;
+}
+
+#ifdef __cplusplus
+}
+
+/**
+ * @brief Steps per millimetre of each axis, from Kconfig
+ */
+namespace motion_coord {
+constexpr int32_t steps_per_mm_x = CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+constexpr int32_t steps_per_mm_y = CONFIG_MOTOR_Y_MICROSTEPS_IN_MM;
+constexpr int32_t steps_per_mm_z = CONFIG_MOTOR_Z_MICROSTEPS_IN_MM;
+
+static_assert(coord_um_to_steps(23250, 100) == 2325, "um to steps");
+static_assert(coord_um_to_steps(-20, 25) == -1, "rounds half away from zero");
+static_assert(coord_steps_to_um(2325, 100) == 23250, "steps to um");
+} // namespace motion_coord
+#endif
+
+#undef MOTION_COORD_FN
+
+#endif // MOTION_COORD_H
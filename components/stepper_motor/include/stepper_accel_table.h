@@ -0,0 +1,46 @@
+/**
+ * @file stepper_accel_table.h
+ * @brief Precomputed acceleration ramp of one axis
+ *
+ * Interval between consecutive steps while accelerating from rest at a
+ * fixed acceleration, sampled every 2^stride_shift steps. Generated at
+ * compile time by stepper_accel_table.hpp and read by the step engine with
+ * shift-and-multiply interpolation (no division, no sqrt).
+ */
+
+#ifndef STEPPER_ACCEL_TABLE_H
+#define STEPPER_ACCEL_TABLE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Entries per generated axis table
+ */
+#define STEPPER_ACCEL_TABLE_POINTS 128
+
+/**
+ * @brief Acceleration table view passed to the stepper HAL
+ */
+typedef struct {
+    uint32_t acceleration;      // steps/s^2 the table was generated for
+    uint32_t stride_shift;      // log2 of ramp steps between two entries
+    uint32_t length;            // Number of entries
+    const uint32_t* interval;   // Q24.8 us, entry k is ramp index (k << stride_shift)
+} stepper_accel_table_t;
+
+/**
+ * @brief Highest ramp index covered by a table
+ */
+static inline uint32_t stepper_accel_table_span(const stepper_accel_table_t* table) {
+    return (table->length - 1) << table->stride_shift;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STEPPER_ACCEL_TABLE_H
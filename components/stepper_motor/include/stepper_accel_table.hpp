@@ -0,0 +1,95 @@
+/**
+ * @file stepper_accel_table.hpp
+ * @brief Compile-time generation of acceleration ramp tables
+ *
+ * Builds the interval table of a constant-acceleration ramp from rest as a
+ * constant expression, so per-axis tables derived from Kconfig land in
+ * read-only data without any start-up cost.
+ *
+ * Entry n is the time between step n and step n + 1 when starting from
+ * rest: sqrt(2/a) * (sqrt(n + 1) - sqrt(n)), with Austin's 0.676 correction
+ * on the first step to match stepper_ramp_plan().
+ */
+
+#ifndef STEPPER_ACCEL_TABLE_HPP
+#define STEPPER_ACCEL_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "stepper_accel_table.h"
+
+namespace stepper_table {
+
+constexpr double kFirstIntervalFactor = 0.676;
+constexpr double kFixedOne = 256.0;                     // Q24.8
+constexpr double kMaxInterval = 30000.0 * kFixedOne;    // STEPPER_RAMP_MAX_INTERVAL_US
+
+/**
+ * @brief Newton square root usable in constant expressions
+ */
+constexpr double csqrt(double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    double r = x < 1.0 ? 1.0 : x;
+    for (int i = 0; i < 64; i++) {
+        r = 0.5 * (r + x / r);
+    }
+    return r;
+}
+
+/**
+ * @brief Smallest stride so that N entries cover the ramp to max_velocity
+ */
+constexpr uint32_t strideShiftFor(double acceleration, double max_velocity, std::size_t n) {
+    double ramp_steps = max_velocity * max_velocity / (2.0 * acceleration);
+    uint32_t shift = 0;
+    while (static_cast<double>((n - 1) << shift) < ramp_steps && shift < 16) {
+        shift++;
+    }
+    return shift;
+}
+
+/**
+ * @brief Interval (Q24.8 us) at ramp index n
+ */
+constexpr uint32_t intervalAt(double acceleration, uint32_t n) {
+    double base = csqrt(2.0 / acceleration) * 1000000.0 * kFixedOne;
+    double c = (n == 0) ? kFirstIntervalFactor * base
+                        : base * (csqrt(static_cast<double>(n) + 1.0) - csqrt(static_cast<double>(n)));
+    return static_cast<uint32_t>(c > kMaxInterval ? kMaxInterval : c);
+}
+
+/**
+ * @brief Fixed-size table storage
+ */
+template <std::size_t N>
+struct AccelTable {
+    uint32_t acceleration;
+    uint32_t stride_shift;
+    uint32_t interval[N];
+
+    constexpr stepper_accel_table_t view() const {
+        return stepper_accel_table_t{acceleration, stride_shift, static_cast<uint32_t>(N), interval};
+    }
+};
+
+/**
+ * @brief Build the table of one axis
+ * @param acceleration Acceleration in steps/s^2
+ * @param max_velocity Cruise speed in steps/s (sets the covered ramp length)
+ */
+template <std::size_t N>
+constexpr AccelTable<N> makeAccelTable(double acceleration, double max_velocity) {
+    AccelTable<N> table{};
+    table.acceleration = static_cast<uint32_t>(acceleration);
+    table.stride_shift = strideShiftFor(acceleration, max_velocity, N);
+    for (std::size_t k = 0; k < N; k++) {
+        table.interval[k] = intervalAt(acceleration, static_cast<uint32_t>(k << table.stride_shift));
+    }
+    return table;
+}
+
+} // namespace stepper_table
+
+#endif // STEPPER_ACCEL_TABLE_HPP
@@ -13,12 +13,47 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "driver/gpio.h"
+#include "stepper_accel_table.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Shortest supported interval between rising STEP edges (50 kHz)
+ */
+#define STEPPER_MIN_STEP_TIME_US 20
+
+/**
+ * @brief Default cruise interval between rising STEP edges
+ */
+#define STEPPER_DEFAULT_STEP_TIME_US 321
+
+/**
+ * @brief Default ramp acceleration in steps/s^2
+ */
+#define STEPPER_DEFAULT_ACCELERATION 10000
+
+/**
+ * @brief Lowest accepted ramp acceleration in steps/s^2
+ */
+#define STEPPER_MIN_ACCELERATION 100
+
+/**
+ * @brief Maximum number of motors started together by stepper_motor_hal_start_group()
+ */
+#define STEPPER_GROUP_MAX_AXES 4
+
+/**
+ * @brief Velocity profile shape used for moves
+ */
+typedef enum {
+    STEPPER_PROFILE_TRAPEZOID = 0,  // Constant acceleration ramps
+    STEPPER_PROFILE_S_CURVE,        // Jerk-limited 7-segment ramps
+} stepper_profile_t;
+
 /**
  * @brief Motor rotation direction
  */
@@ -52,6 +87,47 @@ typedef struct {
  */
 typedef struct stepper_motor_handle_s* stepper_motor_handle_t;
 
+/**
+ * @brief Move completion callback
+ *
+ * @note Called from the step timer ISR - keep it short and ISR-safe.
+ */
+typedef void (*stepper_motor_done_cb_t)(stepper_motor_handle_t handle, void* user_ctx);
+
+/**
+ * @brief One motor's part of a group start
+ */
+typedef struct {
+    stepper_motor_handle_t handle;
+    uint32_t steps;
+    stepper_direction_t direction;
+} stepper_motor_move_t;
+
+/**
+ * @brief One queued segment with explicit limits and boundary speeds
+ */
+typedef struct {
+    uint32_t steps;
+    stepper_direction_t direction;
+    double max_velocity;        // Cruise speed limit in steps/s
+    double acceleration;        // Acceleration and deceleration in steps/s^2
+    double jerk;                // Jerk limit in steps/s^3 (S-curve profile only)
+    double entry_velocity;      // Speed at the first step in steps/s (0 = from rest)
+    double exit_velocity;       // Speed after the last step in steps/s (0 = to rest)
+    uint32_t hold_us;           // With 0 steps: time the motor waits before the next segment
+} stepper_motor_segment_t;
+
+/**
+ * @brief Segment queue counters
+ */
+typedef struct {
+    uint32_t depth;             // Segments waiting behind the running one
+    uint32_t capacity;          // Queue length (CONFIG_STEPPER_SEGMENT_QUEUE_LEN)
+    uint32_t max_depth;         // Highest depth seen since the last reset
+    uint32_t underruns;         // Times the queue ran dry under a segment ending at speed
+    uint32_t segments_done;     // Moves and segments finished by the step engine
+} stepper_queue_stats_t;
+
 /**
  * @brief Initialize stepper motor driver
  * 
@@ -96,22 +172,222 @@ void stepper_motor_hal_set_enable(stepper_motor_handle_t handle, bool enable);
 void stepper_motor_hal_set_direction(stepper_motor_handle_t handle, stepper_direction_t direction);
 
 /**
- * @brief Execute single step
+ * @brief Execute single step (blocking)
+ *
+ * @param handle Handle to the motor instance
+ * @param pulse_width_us STEP HIGH time in microseconds
+ * @param interval_us Time from this rising edge to the earliest next one
  */
-void stepper_motor_hal_step(stepper_motor_handle_t handle, uint32_t signal_width_us);
+void stepper_motor_hal_step(stepper_motor_handle_t handle, uint32_t pulse_width_us, uint32_t interval_us);
 
 /**
  * @brief Execute multiple steps
+ *
+ * Blocking wrapper around stepper_motor_hal_start_move() and
+ * stepper_motor_hal_wait_move_done(). The calling task sleeps while the
+ * pulses are generated by the step timer.
  */
 void stepper_motor_hal_step_multiple(stepper_motor_handle_t handle, uint32_t steps);
 
+/**
+ * @brief Start generating steps in the background
+ *
+ * Pulses are emitted from the step timer ISR. The function returns immediately;
+ * completion is signalled through stepper_motor_hal_wait_move_done() and the
+ * optional done callback.
+ *
+ * @param handle Handle to the motor instance
+ * @param steps Number of steps to execute
+ * @return true if the move was started, false if the motor is busy, disabled or steps is 0
+ */
+bool stepper_motor_hal_start_move(stepper_motor_handle_t handle, uint32_t steps);
+
+/**
+ * @brief Start a homing seek towards the endpoint switch (non-blocking)
+ *
+ * Like stepper_motor_hal_start_move(), but the step ISR reads the endpoint
+ * switch before every pulse and ends the move as soon as it is closed,
+ * without ramping down. A seek that started on a closed switch emits no
+ * steps. The move counts as stopped abruptly when the switch ended it.
+ *
+ * @param handle Handle to the motor instance
+ * @param steps Longest distance to travel before giving up
+ * @param direction Direction towards the switch
+ * @param velocity Cruise speed in steps/s (acceleration from the handle)
+ * @return true if the seek was started, false if the motor is busy, disabled
+ *         or has no endpoint switch
+ *
+ * @note The RMT backend cannot stop a transmission on the switch. It moves
+ *       at most STEPPER_RMT_HOMING_BURST_STEPS per call and the caller
+ *       starts another seek while the switch is still open.
+ */
+bool stepper_motor_hal_start_homing(stepper_motor_handle_t handle, uint32_t steps,
+                                    stepper_direction_t direction, double velocity);
+
+/**
+ * @brief Start moves on several motors at once (non-blocking)
+ *
+ * Sets each motor's direction and starts all moves together. With the
+ * multi-axis backend the DIR lines are written in a single register access
+ * and the first STEP pulses of all axes go out in the same tick; other
+ * backends start the motors one after another.
+ *
+ * @param moves Motor, step count and direction of each move
+ * @param count Number of moves (at most STEPPER_GROUP_MAX_AXES)
+ * @return true if every move was started, false if any was rejected
+ */
+bool stepper_motor_hal_start_group(const stepper_motor_move_t* moves, size_t count);
+
+/**
+ * @brief Append a move to the motor's segment queue (non-blocking)
+ *
+ * The move is planned from rest to rest right away and runs as soon as the
+ * segments ahead of it are done. The step ISR picks it up at the end of the
+ * previous segment without waking any task, so consecutive segments follow
+ * each other with no gap.
+ *
+ * @param handle Handle to the motor instance
+ * @param steps Number of steps (0 is accepted and ignored)
+ * @param direction Direction of this segment
+ * @param timeout_ms Maximum time to wait for a free queue slot
+ * @return true if the move was queued, false if the queue stayed full or the
+ *         motor is disabled
+ *
+ * @note The RMT backend cannot chain segments from its ISR and only accepts
+ *       a queued move while the motor is idle.
+ */
+bool stepper_motor_hal_queue_move(stepper_motor_handle_t handle, uint32_t steps,
+                                  stepper_direction_t direction, uint32_t timeout_ms);
+
+/**
+ * @brief Append a segment with its own limits and boundary speeds
+ *
+ * Like stepper_motor_hal_queue_move(), but the segment does not have to
+ * start or end at rest. A segment that ends above zero speed must be
+ * followed by one that enters at the same speed before it finishes, or the
+ * motor stops abruptly.
+ *
+ * A segment with 0 steps and a hold time keeps the motor still for that
+ * long, so an axis that sits out one move of a blended path starts its
+ * next move together with the others.
+ *
+ * @param handle Handle to the motor instance
+ * @param segment Steps, direction, limits and entry/exit speeds
+ * @param timeout_ms Maximum time to wait for a free queue slot
+ * @return true if the segment was queued
+ */
+bool stepper_motor_hal_queue_segment(stepper_motor_handle_t handle, const stepper_motor_segment_t* segment,
+                                     uint32_t timeout_ms);
+
+/**
+ * @brief Mark the start of a stream of queued moves
+ *
+ * While streaming, an empty queue at the end of a segment counts as an underrun.
+ */
+void stepper_motor_hal_queue_begin(stepper_motor_handle_t handle);
+
+/**
+ * @brief Mark the end of a stream of queued moves
+ */
+void stepper_motor_hal_queue_end(stepper_motor_handle_t handle);
+
+/**
+ * @brief Read the segment queue counters
+ */
+void stepper_motor_hal_get_queue_stats(stepper_motor_handle_t handle, stepper_queue_stats_t* stats);
+
+/**
+ * @brief Clear max depth, underrun and segment counters
+ */
+void stepper_motor_hal_reset_queue_stats(stepper_motor_handle_t handle);
+
+/**
+ * @brief Time a rest-to-rest move would take to reach a given step
+ *
+ * Plans the ramp a queued move of this length would get from the current
+ * limits and profile and adds up the intervals of its first until_step
+ * steps. Does not touch the running move.
+ *
+ * @param handle Handle to the motor instance
+ * @param steps Length of the move
+ * @param until_step Number of steps to time (clamped to steps)
+ * @return Time in microseconds, 0 on error
+ */
+uint32_t stepper_motor_hal_move_time_us(stepper_motor_handle_t handle, uint32_t steps, uint32_t until_step);
+
+/**
+ * @brief Get the signed step count since init
+ *
+ * Clockwise steps count up, counterclockwise steps count down. Updated by
+ * the step engine as pulses go out, so it is exact even mid-move.
+ */
+int32_t stepper_motor_hal_get_net_steps(stepper_motor_handle_t handle);
+
+/**
+ * @brief Start a straight-line move on several motors (non-blocking)
+ *
+ * The motor with the most steps leads and runs the velocity profile; its
+ * limits are reduced so that no other motor exceeds its own speed,
+ * acceleration or jerk. With the multi-axis backend the other motors are
+ * stepped from the lead's edges by a Bresenham DDA and stay on the line at
+ * every step. Other backends give each motor the lead's profile scaled to
+ * its length, so all motors start, ramp and arrive together.
+ *
+ * @param moves Motor, step count and direction of each axis (0 steps allowed)
+ * @param count Number of axes (at most STEPPER_GROUP_MAX_AXES)
+ * @return true if the move was started (or no axis has to move)
+ */
+bool stepper_motor_hal_start_linear(const stepper_motor_move_t* moves, size_t count);
+
+/**
+ * @brief Check if a background move is in progress
+ */
+bool stepper_motor_hal_is_moving(stepper_motor_handle_t handle);
+
+/**
+ * @brief Block until the current move finishes
+ *
+ * @param handle Handle to the motor instance
+ * @param timeout_ms Maximum time to wait
+ * @return true if the motor is idle, false on timeout
+ */
+bool stepper_motor_hal_wait_move_done(stepper_motor_handle_t handle, uint32_t timeout_ms);
+
+/**
+ * @brief Abort the current move
+ */
+void stepper_motor_hal_stop(stepper_motor_handle_t handle);
+
+/**
+ * @brief Check whether the last move ended without its deceleration ramp
+ *
+ * True after a move was aborted, or after the segment queue ran dry while
+ * the motor was still at speed; the mechanics may still be ringing. False
+ * while moving and after a move that ramped down to rest.
+ */
+bool stepper_motor_hal_stopped_abruptly(stepper_motor_handle_t handle);
+
+/**
+ * @brief Get number of steps emitted by the current (or last) move
+ */
+uint32_t stepper_motor_hal_get_steps_done(stepper_motor_handle_t handle);
+
+/**
+ * @brief Register a callback invoked from ISR when a move completes
+ */
+void stepper_motor_hal_set_done_callback(stepper_motor_handle_t handle, stepper_motor_done_cb_t callback, void* user_ctx);
+
 /**
  * @brief Set time between steps in microseconds
  * 
  * @param handle Handle to the motor instance
- * @param step_time_us Time between steps in microseconds (minimum 100us)
+ * @param step_time_us Cruise interval between rising STEP edges
+ *                     (minimum STEPPER_MIN_STEP_TIME_US, at least pulse width + 2us)
  * 
- * @note This affects the speed when using stepper_motor_hal_step_multiple()
+ * @note This sets the top speed of stepper_motor_hal_step_multiple() and
+ *       stepper_motor_hal_start_move(). Moves start and end at rest and
+ *       ramp with the configured acceleration; short moves may never reach
+ *       this speed. Applies to the next move.
  */
 void stepper_motor_hal_set_step_time(stepper_motor_handle_t handle, uint32_t step_time_us);
 
@@ -123,6 +399,66 @@ void stepper_motor_hal_set_step_time(stepper_motor_handle_t handle, uint32_t ste
  */
 uint32_t stepper_motor_hal_get_step_time(stepper_motor_handle_t handle);
 
+/**
+ * @brief Set STEP pulse HIGH time in microseconds
+ *
+ * @param handle Handle to the motor instance
+ * @param pulse_width_us HIGH time (DRV8825 needs >= 1.9us, TMC2208 >= 0.1us)
+ *
+ * @note Independent of the step interval. Applies to the next move.
+ */
+void stepper_motor_hal_set_pulse_width(stepper_motor_handle_t handle, uint32_t pulse_width_us);
+
+/**
+ * @brief Get STEP pulse HIGH time in microseconds
+ *
+ * @param handle Handle to the motor instance
+ * @return uint32_t Pulse width in microseconds, or 0 on error
+ */
+uint32_t stepper_motor_hal_get_pulse_width(stepper_motor_handle_t handle);
+
+/**
+ * @brief Set ramp acceleration (and deceleration)
+ *
+ * @param handle Handle to the motor instance
+ * @param acceleration Acceleration in steps/s^2 (minimum STEPPER_MIN_ACCELERATION)
+ *
+ * @note Applies to the next move.
+ */
+void stepper_motor_hal_set_acceleration(stepper_motor_handle_t handle, double acceleration);
+
+/**
+ * @brief Get ramp acceleration
+ *
+ * @param handle Handle to the motor instance
+ * @return double Acceleration in steps/s^2, or 0 on error
+ */
+double stepper_motor_hal_get_acceleration(stepper_motor_handle_t handle);
+
+/**
+ * @brief Select the velocity profile shape
+ *
+ * @param handle Handle to the motor instance
+ * @param profile Trapezoid or S-curve
+ * @param jerk Jerk limit in steps/s^3 (used by STEPPER_PROFILE_S_CURVE)
+ *
+ * @note S-curve moves take slightly longer than trapezoidal ones but never
+ *       change acceleration abruptly. Applies to the next move.
+ */
+void stepper_motor_hal_set_profile(stepper_motor_handle_t handle, stepper_profile_t profile, double jerk);
+
+/**
+ * @brief Use a precomputed acceleration table for trapezoidal ramps
+ *
+ * @param handle Handle to the motor instance
+ * @param table Table to use (must stay valid), NULL to compute every interval
+ *
+ * @note The table is used only for moves whose acceleration matches the one
+ *       it was generated for and whose ramps it fully covers. Other moves
+ *       fall back to the step-by-step recurrence.
+ */
+void stepper_motor_hal_set_accel_table(stepper_motor_handle_t handle, const stepper_accel_table_t* table);
+
 /**
  * @brief Get current motor direction
  * 
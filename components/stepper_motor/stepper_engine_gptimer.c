@@ -0,0 +1,177 @@
+/**
+ * @file stepper_engine_gptimer.c
+ * @brief Timer-interrupt driven step engine
+ *
+ * Each motor owns one general purpose timer. The alarm ISR toggles the STEP
+ * line and re-arms the alarm for the next edge, so the task that started the
+ * move is free until the completion notification arrives.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "sdkconfig.h"
+
+#include "stepper_motor_hal_priv.h"
+#include "stepper_ramp.h"
+
+#if CONFIG_STEPPER_BACKEND_GPTIMER
+
+static const char *TAG = "STEPPER_ENGINE";
+
+/**
+ * @brief Load the next queued segment, or stop and signal completion
+ */
+static inline bool IRAM_ATTR chain_next(stepper_motor_handle_t handle, gptimer_handle_t timer,
+                                        BaseType_t* high_task_woken) {
+    portENTER_CRITICAL_ISR(&handle->lock);
+    bool chained = stepper_queue_next_from_isr(handle);
+    if (!chained) {
+        gptimer_stop(timer);
+    }
+    portEXIT_CRITICAL_ISR(&handle->lock);
+
+    if (!chained) {
+        if (handle->done_cb) {
+            handle->done_cb(handle, handle->done_cb_ctx);
+        }
+        xSemaphoreGiveFromISR(handle->done_sem, high_task_woken);
+    }
+    return chained;
+}
+
+static bool IRAM_ATTR stepper_timer_on_alarm(gptimer_handle_t timer,
+                                             const gptimer_alarm_event_data_t* edata,
+                                             void* user_ctx) {
+    stepper_motor_handle_t handle = (stepper_motor_handle_t)user_ctx;
+    BaseType_t high_task_woken = pdFALSE;
+    uint32_t next_edge;
+
+    if (!handle->step_high && handle->steps_done >= handle->ramp.total_steps) {
+        // End of a hold, or of the LOW time after a segment's last step: only
+        // now is the motor free for a new move (or a segment queued meanwhile)
+        if (!chain_next(handle, timer, &high_task_woken)) {
+            return high_task_woken == pdTRUE;
+        }
+        next_edge = stepper_is_holding(handle) ? handle->hold_us : 1;
+    } else if (!handle->step_high && stepper_endpoint_hit(handle)) {
+        // Homing seek reached its switch: end it before the next pulse
+        if (!chain_next(handle, timer, &high_task_woken)) {
+            return high_task_woken == pdTRUE;
+        }
+        next_edge = stepper_is_holding(handle) ? handle->hold_us : 1;
+    } else if (!handle->step_high) {
+        gpio_set_level(handle->config.step_pin, 1);
+        handle->step_high = true;
+        next_edge = stepper_ramp_high_time_us(&handle->ramp);
+    } else {
+        gpio_set_level(handle->config.step_pin, 0);
+        handle->step_high = false;
+        handle->steps_done++;
+        stepper_count_steps(handle, 1);
+        next_edge = stepper_ramp_low_time_us(&handle->ramp);
+
+        if (handle->steps_done < handle->ramp.total_steps) {
+            stepper_ramp_advance(&handle->ramp);
+        } else if (stepper_queue_pending(handle)) {
+            // Chain the next queued segment, keeping the LOW time of the last step
+            if (!chain_next(handle, timer, &high_task_woken)) {
+                return high_task_woken == pdTRUE;
+            }
+            if (stepper_is_holding(handle)) {
+                next_edge += handle->hold_us;
+            }
+        }
+    }
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = edata->alarm_value + next_edge,
+    };
+    gptimer_set_alarm_action(timer, &alarm_config);
+
+    return high_task_woken == pdTRUE;
+}
+
+bool stepper_engine_init(stepper_motor_handle_t handle) {
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = STEPPER_TIMER_RESOLUTION_HZ,
+    };
+
+    if (gptimer_new_timer(&timer_config, &handle->timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate step timer (STEP GPIO %d)", handle->config.step_pin);
+        handle->timer = NULL;
+        return false;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = stepper_timer_on_alarm,
+    };
+
+    if (gptimer_register_event_callbacks(handle->timer, &callbacks, handle) != ESP_OK ||
+        gptimer_enable(handle->timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up step timer");
+        gptimer_del_timer(handle->timer);
+        handle->timer = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void stepper_engine_deinit(stepper_motor_handle_t handle) {
+    if (handle->timer == NULL) {
+        return;
+    }
+
+    stepper_engine_stop(handle);
+    gptimer_disable(handle->timer);
+    gptimer_del_timer(handle->timer);
+    handle->timer = NULL;
+}
+
+bool stepper_engine_start(stepper_motor_handle_t handle) {
+    if (handle->timer == NULL) {
+        return false;
+    }
+
+    stepper_ramp_reset(&handle->ramp);
+    handle->steps_done = 0;
+    handle->step_high = false;
+    handle->is_moving = true;
+
+    // First rising edge right after start (or after the hold)
+    gptimer_set_raw_count(handle->timer, 0);
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = stepper_is_holding(handle) ? handle->hold_us : 1,
+    };
+    gptimer_set_alarm_action(handle->timer, &alarm_config);
+
+    if (gptimer_start(handle->timer) != ESP_OK) {
+        handle->is_moving = false;
+        return false;
+    }
+
+    return true;
+}
+
+void stepper_engine_stop(stepper_motor_handle_t handle) {
+    if (handle->timer == NULL || !handle->is_moving) {
+        return;
+    }
+
+    gptimer_stop(handle->timer);
+    gpio_set_level(handle->config.step_pin, 0);
+    handle->step_high = false;
+    handle->is_moving = false;
+
+    // Wake up anyone blocked in wait_move_done()
+    xSemaphoreGive(handle->done_sem);
+}
+
+#endif // CONFIG_STEPPER_BACKEND_GPTIMER
@@ -0,0 +1,488 @@
+/**
+ * @file stepper_engine_multi_axis.c
+ * @brief Shared-timer step engine for all axes
+ *
+ * One general purpose timer serves every motor. The alarm ISR collects the
+ * STEP edges of all axes that are due (within STEPPER_GROUP_MERGE_US) and
+ * writes them with a single GPIO.out_w1ts / out_w1tc access per register
+ * bank, then re-arms the alarm for the earliest pending edge. A group start
+ * writes the DIR lines of all axes the same way and releases the first
+ * pulses of every axis in the same tick.
+ *
+ * Each axis keeps its own ramp; edges are scheduled on absolute timer
+ * counts so merging never accumulates drift.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "soc/gpio_struct.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "sdkconfig.h"
+
+#include "stepper_motor_hal_priv.h"
+#include "stepper_ramp.h"
+
+#if CONFIG_STEPPER_BACKEND_MULTI_AXIS
+
+// Edges closer than this to the current one are written together
+#define STEPPER_GROUP_MERGE_US 2
+
+// Delay between arming a move and its first edge (covers DIR setup time)
+#define STEPPER_GROUP_START_LEAD_US 20
+
+#define GROUP_NO_ALARM UINT64_MAX
+
+static const char *TAG = "STEPPER_GROUP";
+
+static gptimer_handle_t s_timer = NULL;
+static stepper_motor_handle_t s_slots[STEPPER_GROUP_MAX_AXES];
+static uint32_t s_slot_count = 0;
+static uint64_t s_alarm_at = GROUP_NO_ALARM;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline void IRAM_ATTR pin_to_masks(gpio_num_t pin, uint32_t* lo, uint32_t* hi) {
+    if (pin < 32) {
+        *lo |= 1u << pin;
+    } else {
+        *hi |= 1u << (pin - 32);
+    }
+}
+
+static inline void IRAM_ATTR write_outputs(uint32_t set_lo, uint32_t set_hi,
+                                           uint32_t clr_lo, uint32_t clr_hi) {
+    if (clr_lo) {
+        GPIO.out_w1tc = clr_lo;
+    }
+    if (clr_hi) {
+        GPIO.out1_w1tc.val = clr_hi;
+    }
+    if (set_lo) {
+        GPIO.out_w1ts = set_lo;
+    }
+    if (set_hi) {
+        GPIO.out1_w1ts.val = set_hi;
+    }
+}
+
+/**
+ * @brief Arm the alarm for an absolute count (caller holds s_lock)
+ */
+static inline void IRAM_ATTR arm_alarm(uint64_t at) {
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = at,
+    };
+    gptimer_set_alarm_action(s_timer, &alarm_config);
+    s_alarm_at = at;
+}
+
+/**
+ * @brief Raise STEP of every follower whose Bresenham accumulator overflows
+ */
+static inline void IRAM_ATTR dda_rise(stepper_motor_handle_t lead, uint32_t* set_lo, uint32_t* set_hi) {
+    for (uint32_t j = 0, m = lead->dda_followers; m != 0; j++, m >>= 1) {
+        stepper_motor_handle_t follower = s_slots[j];
+        if (!(m & 1u) || !follower->is_moving) {
+            continue;
+        }
+        follower->dda_error += follower->ramp.total_steps;
+        if (follower->dda_error >= lead->ramp.total_steps) {
+            follower->dda_error -= lead->ramp.total_steps;
+            *set_lo |= follower->step_mask_lo;
+            *set_hi |= follower->step_mask_hi;
+            follower->step_high = true;
+        }
+    }
+}
+
+/**
+ * @brief Drop STEP of the followers raised with the lead's last rising edge
+ */
+static inline void IRAM_ATTR dda_fall(stepper_motor_handle_t lead, uint32_t* clr_lo, uint32_t* clr_hi) {
+    for (uint32_t j = 0, m = lead->dda_followers; m != 0; j++, m >>= 1) {
+        stepper_motor_handle_t follower = s_slots[j];
+        if (!(m & 1u) || !follower->step_high) {
+            continue;
+        }
+        *clr_lo |= follower->step_mask_lo;
+        *clr_hi |= follower->step_mask_hi;
+        follower->step_high = false;
+        follower->steps_done++;
+        stepper_count_steps(follower, 1);
+    }
+}
+
+/**
+ * @brief End a linear move for the followers of a lead axis
+ *
+ * With chain set, a follower that has a queued segment starts it on its own
+ * right after the lead's last step. Returns the slots that are now idle.
+ */
+static inline uint32_t IRAM_ATTR dda_release(stepper_motor_handle_t lead, bool chain) {
+    uint32_t released = 0;
+    for (uint32_t j = 0, m = lead->dda_followers; m != 0; j++, m >>= 1) {
+        stepper_motor_handle_t follower = s_slots[j];
+        if (!(m & 1u) || !follower->is_moving) {
+            continue;
+        }
+
+        bool chained = false;
+        portENTER_CRITICAL_ISR(&follower->lock);
+        if (chain) {
+            chained = stepper_queue_next_from_isr(follower);
+        } else {
+            follower->is_moving = false;
+        }
+        portEXIT_CRITICAL_ISR(&follower->lock);
+
+        if (chained) {
+            follower->next_edge_us = lead->next_edge_us +
+                                     (stepper_is_holding(follower) ? follower->hold_us : 0);
+        } else {
+            released |= 1u << j;
+        }
+    }
+    lead->dda_followers = 0;
+    return released;
+}
+
+static bool IRAM_ATTR stepper_group_on_alarm(gptimer_handle_t timer,
+                                             const gptimer_alarm_event_data_t* edata,
+                                             void* user_ctx) {
+    BaseType_t high_task_woken = pdFALSE;
+    uint64_t now = edata->alarm_value;
+    uint64_t next = GROUP_NO_ALARM;
+    uint32_t set_lo = 0, set_hi = 0, clr_lo = 0, clr_hi = 0;
+    uint32_t finished = 0;
+
+    portENTER_CRITICAL_ISR(&s_lock);
+
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        stepper_motor_handle_t handle = s_slots[i];
+        if (!handle->is_moving) {
+            continue;
+        }
+
+        // Falling edges are never written early, so no pulse gets shorter than its HIGH time
+        if (handle->next_edge_us <= now + (handle->step_high ? 0 : STEPPER_GROUP_MERGE_US)) {
+            if (!handle->step_high && handle->steps_done >= handle->ramp.total_steps) {
+                // End of a hold, or of the LOW time after a segment's last step:
+                // only now is the motor free for a new move (or a segment queued
+                // meanwhile, which gets the start lead as DIR setup)
+                bool after_hold = stepper_is_holding(handle);
+                if (handle->dda_followers) {
+                    // A linear move ends with its lead axis
+                    finished |= dda_release(handle, false);
+                }
+
+                portENTER_CRITICAL_ISR(&handle->lock);
+                bool chained = stepper_queue_next_from_isr(handle);
+                portEXIT_CRITICAL_ISR(&handle->lock);
+                if (!chained) {
+                    finished |= 1u << i;
+                    continue;
+                }
+                if (stepper_is_holding(handle)) {
+                    handle->next_edge_us += handle->hold_us;
+                } else if (!after_hold) {
+                    handle->next_edge_us += STEPPER_GROUP_START_LEAD_US;
+                }
+            } else if (!handle->step_high && stepper_endpoint_hit(handle)) {
+                // Homing seek reached its switch: end it before the next pulse
+                portENTER_CRITICAL_ISR(&handle->lock);
+                bool chained = stepper_queue_next_from_isr(handle);
+                portEXIT_CRITICAL_ISR(&handle->lock);
+                if (!chained) {
+                    finished |= 1u << i;
+                    continue;
+                }
+                if (stepper_is_holding(handle)) {
+                    handle->next_edge_us += handle->hold_us;
+                }
+            } else if (!handle->step_high) {
+                set_lo |= handle->step_mask_lo;
+                set_hi |= handle->step_mask_hi;
+                handle->step_high = true;
+                // A rise written late (e.g. right after a hold) keeps its full HIGH time
+                if (handle->next_edge_us < now) {
+                    handle->next_edge_us = now;
+                }
+                handle->next_edge_us += stepper_ramp_high_time_us(&handle->ramp);
+                if (handle->dda_followers) {
+                    dda_rise(handle, &set_lo, &set_hi);
+                }
+            } else {
+                clr_lo |= handle->step_mask_lo;
+                clr_hi |= handle->step_mask_hi;
+                handle->step_high = false;
+                handle->steps_done++;
+                stepper_count_steps(handle, 1);
+                handle->next_edge_us += stepper_ramp_low_time_us(&handle->ramp);
+                if (handle->dda_followers) {
+                    dda_fall(handle, &clr_lo, &clr_hi);
+                }
+
+                if (handle->steps_done < handle->ramp.total_steps) {
+                    stepper_ramp_advance(&handle->ramp);
+                } else if (stepper_queue_pending(handle)) {
+                    // A linear move ends with its lead axis
+                    uint32_t followers = handle->dda_followers;
+                    uint32_t released = dda_release(handle, true);
+                    finished |= released;
+                    if (released != followers && handle->next_edge_us < next) {
+                        next = handle->next_edge_us;
+                    }
+
+                    // Chain the next queued segment, keeping the LOW time of the last step
+                    portENTER_CRITICAL_ISR(&handle->lock);
+                    bool chained = stepper_queue_next_from_isr(handle);
+                    portEXIT_CRITICAL_ISR(&handle->lock);
+                    if (!chained) {
+                        finished |= 1u << i;
+                        continue;
+                    }
+                    if (stepper_is_holding(handle)) {
+                        handle->next_edge_us += handle->hold_us;
+                    }
+                }
+            }
+        }
+
+        if (handle->next_edge_us < next) {
+            next = handle->next_edge_us;
+        }
+    }
+
+    write_outputs(set_lo, set_hi, clr_lo, clr_hi);
+
+    if (next != GROUP_NO_ALARM) {
+        arm_alarm(next > now ? next : now + 1);
+    } else {
+        s_alarm_at = GROUP_NO_ALARM;
+    }
+
+    portEXIT_CRITICAL_ISR(&s_lock);
+
+    for (uint32_t i = 0; finished != 0; i++, finished >>= 1) {
+        if (finished & 1u) {
+            stepper_motor_handle_t handle = s_slots[i];
+            if (handle->done_cb) {
+                handle->done_cb(handle, handle->done_cb_ctx);
+            }
+            xSemaphoreGiveFromISR(handle->done_sem, &high_task_woken);
+        }
+    }
+
+    return high_task_woken == pdTRUE;
+}
+
+static bool group_timer_create(void) {
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = STEPPER_TIMER_RESOLUTION_HZ,
+    };
+
+    if (gptimer_new_timer(&timer_config, &s_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate shared step timer");
+        s_timer = NULL;
+        return false;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = stepper_group_on_alarm,
+    };
+
+    // Free-running: edges are scheduled on absolute counts
+    if (gptimer_register_event_callbacks(s_timer, &callbacks, NULL) != ESP_OK ||
+        gptimer_enable(s_timer) != ESP_OK ||
+        gptimer_start(s_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up shared step timer");
+        gptimer_del_timer(s_timer);
+        s_timer = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool stepper_engine_init(stepper_motor_handle_t handle) {
+    if (s_slot_count >= STEPPER_GROUP_MAX_AXES) {
+        ESP_LOGE(TAG, "All %d axis slots in use", STEPPER_GROUP_MAX_AXES);
+        return false;
+    }
+
+    if (s_timer == NULL && !group_timer_create()) {
+        return false;
+    }
+
+    handle->step_mask_lo = 0;
+    handle->step_mask_hi = 0;
+    pin_to_masks(handle->config.step_pin, &handle->step_mask_lo, &handle->step_mask_hi);
+
+    portENTER_CRITICAL(&s_lock);
+    handle->group_slot = s_slot_count;
+    s_slots[s_slot_count++] = handle;
+    portEXIT_CRITICAL(&s_lock);
+
+    return true;
+}
+
+void stepper_engine_deinit(stepper_motor_handle_t handle) {
+    if (s_timer == NULL) {
+        return;
+    }
+
+    stepper_engine_stop(handle);
+
+    portENTER_CRITICAL(&s_lock);
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (s_slots[i] == handle) {
+            s_slots[i] = s_slots[--s_slot_count];
+            s_slots[i]->group_slot = i;
+            break;
+        }
+    }
+    bool last = (s_slot_count == 0);
+    portEXIT_CRITICAL(&s_lock);
+
+    if (last) {
+        gptimer_stop(s_timer);
+        gptimer_disable(s_timer);
+        gptimer_del_timer(s_timer);
+        s_timer = NULL;
+        s_alarm_at = GROUP_NO_ALARM;
+    }
+}
+
+/**
+ * @brief Write the DIR lines of all handles in one access (caller holds s_lock)
+ */
+static void write_directions(stepper_motor_handle_t* handles, size_t count) {
+    uint32_t dir_set_lo = 0, dir_set_hi = 0, dir_clr_lo = 0, dir_clr_hi = 0;
+    for (size_t i = 0; i < count; i++) {
+        // DIR LOW = clockwise, as in stepper_motor_hal_set_direction()
+        if (handles[i]->direction == STEPPER_DIR_CLOCKWISE) {
+            pin_to_masks(handles[i]->config.dir_pin, &dir_clr_lo, &dir_clr_hi);
+        } else {
+            pin_to_masks(handles[i]->config.dir_pin, &dir_set_lo, &dir_set_hi);
+        }
+    }
+    write_outputs(dir_set_lo, dir_set_hi, dir_clr_lo, dir_clr_hi);
+}
+
+/**
+ * @brief First edge time for moves armed now (caller holds s_lock)
+ */
+static uint64_t start_time(void) {
+    uint64_t now = 0;
+    gptimer_get_raw_count(s_timer, &now);
+    return now + STEPPER_GROUP_START_LEAD_US;
+}
+
+bool stepper_engine_start_group(stepper_motor_handle_t* handles, size_t count) {
+    if (s_timer == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+
+    write_directions(handles, count);
+    uint64_t start_at = start_time();
+
+    for (size_t i = 0; i < count; i++) {
+        stepper_motor_handle_t handle = handles[i];
+        stepper_ramp_reset(&handle->ramp);
+        handle->steps_done = 0;
+        handle->step_high = false;
+        handle->next_edge_us = start_at + (stepper_is_holding(handle) ? handle->hold_us : 0);
+        handle->dda_followers = 0;
+        handle->is_moving = true;
+    }
+
+    if (start_at < s_alarm_at) {
+        arm_alarm(start_at);
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+
+    return true;
+}
+
+bool stepper_engine_start_linear(stepper_motor_handle_t* handles, size_t count) {
+    if (s_timer == NULL) {
+        return false;
+    }
+
+    stepper_motor_handle_t lead = handles[0];
+
+    portENTER_CRITICAL(&s_lock);
+
+    write_directions(handles, count);
+    uint64_t start_at = start_time();
+
+    stepper_ramp_reset(&lead->ramp);
+    lead->steps_done = 0;
+    lead->step_high = false;
+    lead->next_edge_us = start_at;
+    lead->dda_followers = 0;
+    lead->is_moving = true;
+
+    for (size_t i = 1; i < count; i++) {
+        stepper_motor_handle_t follower = handles[i];
+        follower->steps_done = 0;
+        follower->step_high = false;
+        follower->next_edge_us = GROUP_NO_ALARM;    // Never scheduled on its own
+        follower->dda_followers = 0;
+        follower->dda_error = lead->ramp.total_steps / 2;
+        follower->is_moving = true;
+        lead->dda_followers |= 1u << follower->group_slot;
+    }
+
+    if (start_at < s_alarm_at) {
+        arm_alarm(start_at);
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+
+    return true;
+}
+
+bool stepper_engine_start(stepper_motor_handle_t handle) {
+    return stepper_engine_start_group(&handle, 1);
+}
+
+void stepper_engine_stop(stepper_motor_handle_t handle) {
+    if (s_timer == NULL || !handle->is_moving) {
+        return;
+    }
+
+    uint32_t clr_lo = handle->step_mask_lo, clr_hi = handle->step_mask_hi;
+
+    portENTER_CRITICAL(&s_lock);
+    handle->is_moving = false;
+    handle->step_high = false;
+    uint32_t followers = dda_release(handle, false);
+    for (uint32_t j = 0, m = followers; m != 0; j++, m >>= 1) {
+        if (m & 1u) {
+            s_slots[j]->step_high = false;
+            clr_lo |= s_slots[j]->step_mask_lo;
+            clr_hi |= s_slots[j]->step_mask_hi;
+        }
+    }
+    write_outputs(0, 0, clr_lo, clr_hi);
+    portEXIT_CRITICAL(&s_lock);
+
+    // Wake up anyone blocked in wait_move_done()
+    for (uint32_t j = 0; followers != 0; j++, followers >>= 1) {
+        if (followers & 1u) {
+            xSemaphoreGive(s_slots[j]->done_sem);
+        }
+    }
+    xSemaphoreGive(handle->done_sem);
+}
+
+#endif // CONFIG_STEPPER_BACKEND_MULTI_AXIS
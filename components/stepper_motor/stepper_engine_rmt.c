@@ -0,0 +1,235 @@
+/**
+ * @file stepper_engine_rmt.c
+ * @brief RMT driven step engine
+ *
+ * Each motor owns one RMT TX channel on its STEP pin. A move is queued as
+ * up to three transactions (acceleration, cruise, deceleration). A simple
+ * encoder generates one RMT symbol per step on demand, so the driver refills
+ * the channel memory while the pulse train is running. On chips with a
+ * hardware loop counter a cruise run is sent as a single looped symbol.
+ *
+ * Steps are counted per finished transaction, so the live step counter
+ * advances in segment-sized increments while a move is running.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "driver/rmt_tx.h"
+#include "driver/rmt_encoder.h"
+#include "soc/soc_caps.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "sdkconfig.h"
+
+#include "stepper_motor_hal_priv.h"
+#include "stepper_ramp.h"
+
+#if CONFIG_STEPPER_BACKEND_RMT
+
+// RMT symbol durations are 15 bit wide
+#define RMT_MAX_DURATION 0x7FFF
+
+// Symbols kept in channel memory, refilled from the encoder
+#define RMT_MEM_BLOCK_SYMBOLS 64
+
+// Hardware loop count limit per transaction
+#define RMT_MAX_LOOP_COUNT 1023
+
+static const char *TAG = "STEPPER_RMT";
+
+static inline uint16_t IRAM_ATTR clamp_duration(uint32_t duration) {
+    if (duration == 0) {
+        return 1;
+    }
+    return duration > RMT_MAX_DURATION ? RMT_MAX_DURATION : (uint16_t)duration;
+}
+
+/**
+ * @brief Simple encoder callback: one symbol per step of the segment
+ */
+static size_t IRAM_ATTR stepper_rmt_encode(const void* data, size_t data_size,
+                                           size_t symbols_written, size_t symbols_free,
+                                           rmt_symbol_word_t* symbols, bool* done, void* arg) {
+    const stepper_rmt_segment_t* segment = (const stepper_rmt_segment_t*)data;
+    stepper_ramp_t* ramp = &((stepper_motor_handle_t)arg)->ramp;
+    size_t remaining = segment->symbols - symbols_written;
+    size_t count = remaining < symbols_free ? remaining : symbols_free;
+
+    // Segments are encoded in order; a looped cruise did not walk the ramp
+    if (symbols_written == 0) {
+        stepper_ramp_seek_cruise(ramp, segment->first_step);
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        symbols[k].level0 = 1;
+        symbols[k].duration0 = clamp_duration(stepper_ramp_high_time_us(ramp));
+        symbols[k].level1 = 0;
+        symbols[k].duration1 = clamp_duration(stepper_ramp_low_time_us(ramp));
+        stepper_ramp_advance(ramp);
+    }
+
+    *done = (symbols_written + count >= segment->symbols);
+    return count;
+}
+
+static bool IRAM_ATTR stepper_rmt_on_trans_done(rmt_channel_handle_t channel,
+                                                const rmt_tx_done_event_data_t* edata,
+                                                void* user_ctx) {
+    stepper_motor_handle_t handle = (stepper_motor_handle_t)user_ctx;
+    BaseType_t high_task_woken = pdFALSE;
+
+    if (!handle->is_moving || handle->rmt_segments_done >= handle->rmt_segment_count) {
+        return false;
+    }
+
+    handle->steps_done += handle->rmt_segments[handle->rmt_segments_done].steps;
+    stepper_count_steps(handle, handle->rmt_segments[handle->rmt_segments_done].steps);
+    handle->rmt_segments_done++;
+
+    if (handle->rmt_segments_done == handle->rmt_segment_count) {
+        // Nothing is queued behind an RMT move, so this only ends it
+        portENTER_CRITICAL_ISR(&handle->lock);
+        stepper_queue_next_from_isr(handle);
+        portEXIT_CRITICAL_ISR(&handle->lock);
+        if (handle->done_cb) {
+            handle->done_cb(handle, handle->done_cb_ctx);
+        }
+        xSemaphoreGiveFromISR(handle->done_sem, &high_task_woken);
+    }
+
+    return high_task_woken == pdTRUE;
+}
+
+bool stepper_engine_init(stepper_motor_handle_t handle) {
+    rmt_tx_channel_config_t channel_config = {
+        .gpio_num = handle->config.step_pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = STEPPER_TIMER_RESOLUTION_HZ,
+        .mem_block_symbols = RMT_MEM_BLOCK_SYMBOLS,
+        .trans_queue_depth = STEPPER_RMT_MAX_SEGMENTS + 1,
+    };
+
+    if (rmt_new_tx_channel(&channel_config, &handle->rmt_channel) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate RMT channel (STEP GPIO %d)", handle->config.step_pin);
+        handle->rmt_channel = NULL;
+        return false;
+    }
+
+    rmt_simple_encoder_config_t encoder_config = {
+        .callback = stepper_rmt_encode,
+        .arg = handle,
+        .min_chunk_size = 1,
+    };
+
+    rmt_tx_event_callbacks_t callbacks = {
+        .on_trans_done = stepper_rmt_on_trans_done,
+    };
+
+    if (rmt_new_simple_encoder(&encoder_config, &handle->rmt_encoder) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT step encoder");
+        rmt_del_channel(handle->rmt_channel);
+        handle->rmt_channel = NULL;
+        return false;
+    }
+
+    if (rmt_tx_register_event_callbacks(handle->rmt_channel, &callbacks, handle) != ESP_OK ||
+        rmt_enable(handle->rmt_channel) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up RMT channel");
+        rmt_del_encoder(handle->rmt_encoder);
+        rmt_del_channel(handle->rmt_channel);
+        handle->rmt_encoder = NULL;
+        handle->rmt_channel = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void stepper_engine_deinit(stepper_motor_handle_t handle) {
+    if (handle->rmt_channel == NULL) {
+        return;
+    }
+
+    stepper_engine_stop(handle);
+    rmt_disable(handle->rmt_channel);
+    rmt_del_encoder(handle->rmt_encoder);
+    rmt_del_channel(handle->rmt_channel);
+    handle->rmt_encoder = NULL;
+    handle->rmt_channel = NULL;
+}
+
+/**
+ * @brief Append a segment of steps [first, first + count) to the move
+ */
+static void add_segment(stepper_motor_handle_t handle, uint32_t first, uint32_t symbols, uint32_t steps) {
+    if (steps == 0) {
+        return;
+    }
+
+    stepper_rmt_segment_t* segment = &handle->rmt_segments[handle->rmt_segment_count++];
+    segment->first_step = first;
+    segment->symbols = symbols;
+    segment->steps = steps;
+}
+
+bool stepper_engine_start(stepper_motor_handle_t handle) {
+    if (handle->rmt_channel == NULL) {
+        return false;
+    }
+
+    stepper_ramp_reset(&handle->ramp);
+    stepper_ramp_segments_t split = stepper_ramp_split(&handle->ramp);
+
+    // Looped cruise when the hardware can repeat a symbol by itself
+    bool loop_cruise = false;
+#if SOC_RMT_SUPPORT_TX_LOOP_COUNT
+    loop_cruise = split.cruise_steps > 1 && split.cruise_steps <= RMT_MAX_LOOP_COUNT;
+#endif
+
+    handle->rmt_segment_count = 0;
+    handle->rmt_segments_done = 0;
+    add_segment(handle, 0, split.accel_steps, split.accel_steps);
+    add_segment(handle, split.accel_steps, loop_cruise ? 1 : split.cruise_steps, split.cruise_steps);
+    add_segment(handle, split.accel_steps + split.cruise_steps, split.decel_steps, split.decel_steps);
+
+    handle->steps_done = 0;
+    handle->is_moving = true;
+
+    for (uint32_t n = 0; n < handle->rmt_segment_count; n++) {
+        const stepper_rmt_segment_t* segment = &handle->rmt_segments[n];
+        rmt_transmit_config_t transmit_config = {
+            .loop_count = (segment->symbols < segment->steps) ? (int)segment->steps : 0,
+            .flags = {
+                .eot_level = 0,
+            },
+        };
+
+        if (rmt_transmit(handle->rmt_channel, handle->rmt_encoder,
+                         segment, sizeof(*segment), &transmit_config) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to queue RMT segment %lu", n);
+            stepper_engine_stop(handle);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void stepper_engine_stop(stepper_motor_handle_t handle) {
+    if (handle->rmt_channel == NULL || !handle->is_moving) {
+        return;
+    }
+
+    handle->is_moving = false;
+
+    // Disabling the channel drops every queued transaction
+    rmt_disable(handle->rmt_channel);
+    rmt_enable(handle->rmt_channel);
+
+    // Wake up anyone blocked in wait_move_done()
+    xSemaphoreGive(handle->done_sem);
+}
+
+#endif // CONFIG_STEPPER_BACKEND_RMT
@@ -9,33 +9,35 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_rom_sys.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
 #include "esp_task_wdt.h"
 #include "hal/wdt_hal.h"
 
 #include "stepper_motor_hal.h"
+#include "stepper_motor_hal_priv.h"
+#include "sdkconfig.h"
 
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-
-#define MAX_STEP_DELAY_US 400
-#define MIN_STEP_DELAY_US 1
+// Upper bound for a blocking stepper_motor_hal_step_multiple() call
+#define STEP_MULTIPLE_TIMEOUT_MS 120000
 
 static const char *TAG = "STEPPER_HAL";
 
 /**
- * @brief Internal structure for stepper motor handle
+ * @brief Stop the step engine, noting a move cut short before its deceleration
  */
-struct stepper_motor_handle_s {
-    stepper_motor_config_t config;
-    bool is_enabled;
-    bool is_initialized;
-    stepper_direction_t direction;
-};
+static void abort_engine(stepper_motor_handle_t handle) {
+    if (handle->is_moving && !stepper_is_holding(handle)) {
+        handle->stopped_abruptly = true;
+    }
+    stepper_engine_stop(handle);
+}
 
 stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* config)
 {
@@ -51,7 +53,7 @@ stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* conf
     ESP_LOGI(TAG, "  ENABLE: GPIO %d", config->enable_pin);
 
     // Allocate memory for handle and check for errors
-    stepper_motor_handle_t handle = malloc(sizeof(struct stepper_motor_handle_s));
+    stepper_motor_handle_t handle = calloc(1, sizeof(struct stepper_motor_handle_s));
     if (handle == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for stepper motor handle");
         return NULL;
@@ -61,6 +63,18 @@ stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* conf
     handle->is_enabled = false;
     handle->is_initialized = true;
     handle->direction = STEPPER_DIR_CLOCKWISE;
+    handle->step_time_us = STEPPER_DEFAULT_STEP_TIME_US;
+    handle->pulse_width_us = CONFIG_STEPPER_PULSE_WIDTH_US;
+    handle->acceleration = STEPPER_DEFAULT_ACCELERATION;
+    handle->profile = STEPPER_PROFILE_TRAPEZOID;
+    portMUX_INITIALIZE(&handle->lock);
+
+    handle->done_sem = xSemaphoreCreateBinary();
+    if (handle->done_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to create move completion semaphore");
+        free(handle);
+        return NULL;
+    }
 
     // Initialize output GPIO pins (step, dir, enable)
     gpio_config_t io_conf = {
@@ -75,6 +89,7 @@ stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* conf
 
     if (gpio_config(&io_conf) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure output GPIO pins");
+        vSemaphoreDelete(handle->done_sem);
         free(handle);
         return NULL;
     }
@@ -97,6 +112,7 @@ stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* conf
 
         if (gpio_config(&endpoint_conf) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to configure endpoint GPIO pin");
+            vSemaphoreDelete(handle->done_sem);
             free(handle);
             return NULL;
         }
@@ -113,6 +129,12 @@ stepper_motor_handle_t stepper_motor_hal_init(const stepper_motor_config_t* conf
 
     ESP_LOGI(TAG, "GPIO pins configured successfully");
 
+    if (!stepper_engine_init(handle)) {
+        vSemaphoreDelete(handle->done_sem);
+        free(handle);
+        return NULL;
+    }
+
     // Set initial states
     // TMC2208: ENABLE pin is active LOW (0 = enabled, 1 = disabled)
     gpio_set_level(config->enable_pin, 1);  // Start disabled
@@ -132,10 +154,12 @@ void stepper_motor_hal_deinit(stepper_motor_handle_t handle) {
         return;
     }
 
-    // Disable motor
+    // Stop pulse generation and disable motor
+    stepper_engine_deinit(handle);
     stepper_motor_hal_set_enable(handle, false);
 
     // Free allocated memory
+    vSemaphoreDelete(handle->done_sem);
     free(handle);
 }
 
@@ -145,6 +169,11 @@ void stepper_motor_hal_set_enable(stepper_motor_handle_t handle, bool enable) {
         return;
     }
 
+    // Never leave the step engine running into a disabled driver
+    if (!enable) {
+        abort_engine(handle);
+    }
+
     // TMC2208: ENABLE is active LOW (0 = enabled, 1 = disabled)
     gpio_set_level(handle->config.enable_pin, enable ? 0 : 1);
     handle->is_enabled = enable;
@@ -169,7 +198,7 @@ void stepper_motor_hal_set_direction(stepper_motor_handle_t handle, stepper_dire
              direction == STEPPER_DIR_CLOCKWISE ? 0 : 1);
 }
 
-void stepper_motor_hal_step(stepper_motor_handle_t handle, uint32_t signal_width_us) {
+void stepper_motor_hal_step(stepper_motor_handle_t handle, uint32_t pulse_width_us, uint32_t interval_us) {
     if (handle == NULL || !handle->is_initialized) {
         ESP_LOGW(TAG, "Handle is NULL or not initialized");
         return;
@@ -180,53 +209,677 @@ void stepper_motor_hal_step(stepper_motor_handle_t handle, uint32_t signal_width
         return;
     }
 
+    if (handle->is_moving) {
+        ESP_LOGW(TAG, "Motor is busy, step rejected");
+        return;
+    }
+
     gpio_set_level(handle->config.step_pin, 1);
-    esp_rom_delay_us(signal_width_us);
+    esp_rom_delay_us(pulse_width_us);
     gpio_set_level(handle->config.step_pin, 0);
+    stepper_count_steps(handle, 1);
+
+    if (interval_us > pulse_width_us) {
+        esp_rom_delay_us(interval_us - pulse_width_us);
+    }
 }
 
 void stepper_motor_hal_step_multiple(stepper_motor_handle_t handle, uint32_t steps) {
+    if (!stepper_motor_hal_start_move(handle, steps)) {
+        return;
+    }
+
+    if (!stepper_motor_hal_wait_move_done(handle, STEP_MULTIPLE_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Move of %lu steps timed out, stopping", steps);
+        stepper_motor_hal_stop(handle);
+    }
+}
+
+/**
+ * @brief Plan a segment with explicit limits and the handle's profile
+ */
+static void plan_ramp_segment(stepper_motor_handle_t handle, stepper_ramp_t* ramp,
+                              const stepper_motor_segment_t* segment) {
+    if (handle->profile == STEPPER_PROFILE_S_CURVE) {
+        stepper_ramp_plan_s_curve(ramp, segment->steps, handle->pulse_width_us,
+                                  segment->max_velocity, segment->acceleration, segment->jerk,
+                                  segment->entry_velocity, segment->exit_velocity);
+    } else {
+        stepper_ramp_plan(ramp, segment->steps, handle->pulse_width_us,
+                          segment->max_velocity, segment->acceleration,
+                          segment->entry_velocity, segment->exit_velocity, handle->accel_table);
+    }
+}
+
+/**
+ * @brief Plan a move from rest to rest with explicit limits and the handle's profile
+ */
+static void plan_ramp_limited(stepper_motor_handle_t handle, stepper_ramp_t* ramp, uint32_t steps,
+                              double max_velocity, double acceleration, double jerk) {
+    stepper_motor_segment_t segment = {
+        .steps = steps,
+        .direction = handle->direction,
+        .max_velocity = max_velocity,
+        .acceleration = acceleration,
+        .jerk = jerk,
+        .entry_velocity = 0.0,
+        .exit_velocity = 0.0,
+    };
+    plan_ramp_segment(handle, ramp, &segment);
+}
+
+/**
+ * @brief Plan a move from rest to rest with the handle's limits and profile
+ */
+static void plan_ramp(stepper_motor_handle_t handle, stepper_ramp_t* ramp, uint32_t steps) {
+    plan_ramp_limited(handle, ramp, steps, 1000000.0 / handle->step_time_us,
+                      handle->acceleration, handle->jerk);
+}
+
+/**
+ * @brief Check that a motor can start a new move right now
+ */
+static bool check_ready(stepper_motor_handle_t handle) {
     if (handle == NULL || !handle->is_initialized) {
         ESP_LOGW(TAG, "Handle is NULL or not initialized");
-        return;
+        return false;
     }
 
     if (!handle->is_enabled) {
         ESP_LOGE(TAG, "Motor is not enabled! Cannot step.");
+        return false;
+    }
+
+    if (handle->is_moving || stepper_segment_queue_depth(&handle->queue) > 0) {
+        ESP_LOGW(TAG, "Motor is busy, move rejected");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Validate a move and plan its ramp, without starting it
+ */
+static bool prepare_move(stepper_motor_handle_t handle, uint32_t steps) {
+    if (!check_ready(handle) || steps == 0) {
+        return false;
+    }
+
+    // Drop a stale completion left over from a previous move
+    xSemaphoreTake(handle->done_sem, 0);
+
+    plan_ramp(handle, &handle->ramp, steps);
+    handle->stopped_abruptly = false;
+    handle->stop_at_endpoint = false;
+    return true;
+}
+
+/**
+ * @brief Set DIR and start already planned moves on several motors
+ */
+static bool start_planned(stepper_motor_handle_t* handles, size_t count) {
+#if CONFIG_STEPPER_BACKEND_MULTI_AXIS
+    // DIR lines of every axis in one register write, first pulses in the same tick
+    if (!stepper_engine_start_group(handles, count)) {
+        ESP_LOGE(TAG, "Failed to start step engine");
+        return false;
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        gpio_set_level(handles[i]->config.dir_pin, handles[i]->direction == STEPPER_DIR_CLOCKWISE ? 0 : 1);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!stepper_engine_start(handles[i])) {
+            ESP_LOGE(TAG, "Failed to start step engine");
+            for (size_t j = 0; j < i; j++) {
+                stepper_engine_stop(handles[j]);
+            }
+            return false;
+        }
+    }
+#endif
+
+    return true;
+}
+
+bool stepper_motor_hal_start_move(stepper_motor_handle_t handle, uint32_t steps) {
+    if (!prepare_move(handle, steps)) {
+        return false;
+    }
+
+    if (!stepper_engine_start(handle)) {
+        ESP_LOGE(TAG, "Failed to start step engine");
+        return false;
+    }
+
+    return true;
+}
+
+bool stepper_motor_hal_start_homing(stepper_motor_handle_t handle, uint32_t steps,
+                                    stepper_direction_t direction, double velocity) {
+    if (handle != NULL && handle->config.endpoint_pin == GPIO_NUM_NC) {
+        ESP_LOGW(TAG, "No endpoint pin configured, cannot home");
+        return false;
+    }
+    if (!check_ready(handle) || steps == 0 || velocity <= 0.0) {
+        return false;
+    }
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    if (steps > STEPPER_RMT_HOMING_BURST_STEPS) {
+        steps = STEPPER_RMT_HOMING_BURST_STEPS;
+    }
+#endif
+
+    xSemaphoreTake(handle->done_sem, 0);
+
+    plan_ramp_limited(handle, &handle->ramp, steps, velocity, handle->acceleration, handle->jerk);
+    handle->direction = direction;
+    handle->stopped_abruptly = false;
+    handle->stop_at_endpoint = true;
+    return start_planned(&handle, 1);
+}
+
+bool stepper_motor_hal_start_group(const stepper_motor_move_t* moves, size_t count) {
+    if (moves == NULL || count == 0 || count > STEPPER_GROUP_MAX_AXES) {
+        ESP_LOGW(TAG, "Invalid move group");
+        return false;
+    }
+
+    stepper_motor_handle_t handles[STEPPER_GROUP_MAX_AXES];
+    for (size_t i = 0; i < count; i++) {
+        if (!prepare_move(moves[i].handle, moves[i].steps)) {
+            return false;
+        }
+        handles[i] = moves[i].handle;
+        handles[i]->direction = moves[i].direction;
+    }
+
+    return start_planned(handles, count);
+}
+
+bool stepper_motor_hal_start_linear(const stepper_motor_move_t* moves, size_t count) {
+    if (moves == NULL || count == 0 || count > STEPPER_GROUP_MAX_AXES) {
+        ESP_LOGW(TAG, "Invalid linear move");
+        return false;
+    }
+
+    // Lead axis (most steps) first, axes without steps left out
+    stepper_motor_handle_t handles[STEPPER_GROUP_MAX_AXES];
+    uint32_t steps[STEPPER_GROUP_MAX_AXES];
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!check_ready(moves[i].handle)) {
+            return false;
+        }
+        if (moves[i].steps == 0) {
+            continue;
+        }
+        handles[n] = moves[i].handle;
+        steps[n] = moves[i].steps;
+        handles[n]->direction = moves[i].direction;
+        handles[n]->stopped_abruptly = false;
+        handles[n]->stop_at_endpoint = false;
+        if (steps[n] > steps[0]) {
+            stepper_motor_handle_t h = handles[0];
+            uint32_t s = steps[0];
+            handles[0] = handles[n];
+            steps[0] = steps[n];
+            handles[n] = h;
+            steps[n] = s;
+        }
+        n++;
+    }
+
+    if (n == 0) {
+        return true;
+    }
+
+    // Lead axis limits that keep every axis within its own
+    double lead_steps = steps[0];
+    double velocity = 0.0, acceleration = 0.0, jerk = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double ratio = lead_steps / steps[i];
+        double v = ratio * 1000000.0 / handles[i]->step_time_us;
+        double a = ratio * handles[i]->acceleration;
+        velocity = (i == 0 || v < velocity) ? v : velocity;
+        acceleration = (i == 0 || a < acceleration) ? a : acceleration;
+
+        // Only S-curve axes limit jerk (trapezoid axes carry none)
+        if (handles[i]->profile == STEPPER_PROFILE_S_CURVE) {
+            double j = ratio * handles[i]->jerk;
+            jerk = (jerk == 0.0 || j < jerk) ? j : jerk;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        xSemaphoreTake(handles[i]->done_sem, 0);
+    }
+
+#if CONFIG_STEPPER_BACKEND_MULTI_AXIS
+    // The lead axis runs the profile, the others follow it step by step
+    plan_ramp_limited(handles[0], &handles[0]->ramp, steps[0], velocity, acceleration, jerk);
+    for (size_t i = 1; i < n; i++) {
+        handles[i]->ramp.total_steps = steps[i];
+    }
+
+    if (!stepper_engine_start_linear(handles, n)) {
+        ESP_LOGE(TAG, "Failed to start step engine");
+        return false;
+    }
+    return true;
+#else
+    // No shared ISR: every axis gets the lead profile scaled to its length,
+    // so all of them ramp, cruise and stop together
+    for (size_t i = 0; i < n; i++) {
+        double scale = steps[i] / lead_steps;
+        plan_ramp_limited(handles[i], &handles[i]->ramp, steps[i],
+                          velocity * scale, acceleration * scale, jerk * scale);
+    }
+
+    return start_planned(handles, n);
+#endif
+}
+
+bool stepper_motor_hal_stopped_abruptly(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        return false;
+    }
+    return !handle->is_moving && handle->stopped_abruptly;
+}
+
+bool stepper_motor_hal_is_moving(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        return false;
+    }
+    return handle->is_moving;
+}
+
+bool stepper_motor_hal_wait_move_done(stepper_motor_handle_t handle, uint32_t timeout_ms) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return true;
+    }
+
+    if (!handle->is_moving) {
+        return true;
+    }
+
+    xSemaphoreTake(handle->done_sem, pdMS_TO_TICKS(timeout_ms));
+    return !handle->is_moving;
+}
+
+void stepper_motor_hal_stop(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
         return;
     }
 
-    int32_t l = MAX_STEP_DELAY_US; // MIN(steps, MAX_STEP_DELAY_US);
-    int32_t delay = MAX_STEP_DELAY_US;
+    abort_engine(handle);
+
+    // Engine is idle, so this task may drain the queue in place of the ISR
+    portENTER_CRITICAL(&handle->lock);
+    while (stepper_segment_queue_peek(&handle->queue) != NULL) {
+        stepper_segment_queue_release(&handle->queue);
+    }
+    handle->queue_streaming = false;
+    portEXIT_CRITICAL(&handle->lock);
+}
+
+/**
+ * @brief Make a queued segment the current move (caller holds handle->lock)
+ */
+static void IRAM_ATTR load_segment(stepper_motor_handle_t handle, const stepper_segment_t* segment) {
+    handle->ramp = segment->ramp;
+    stepper_ramp_reset(&handle->ramp);
+    handle->steps_done = 0;
+    handle->hold_us = segment->hold_us;
+    handle->stopped_abruptly = false;
+    handle->stop_at_endpoint = false;
+
+    if (segment->direction != handle->direction) {
+        gpio_set_level(handle->config.dir_pin, segment->direction == STEPPER_DIR_CLOCKWISE ? 0 : 1);
+        handle->direction = segment->direction;
+    }
+}
+
+bool IRAM_ATTR stepper_queue_next_from_isr(stepper_motor_handle_t handle) {
+    handle->queue_segments_done++;
+
+    stepper_segment_t* segment = stepper_segment_queue_peek(&handle->queue);
+    if (segment == NULL) {
+        // Only a segment that was to hand its speed on has starved; the rest
+        // stop at the end of a stream is planned
+        if (handle->queue_streaming && stepper_ramp_ends_at_speed(&handle->ramp)) {
+            handle->queue_underruns++;
+        }
+        // Running dry ends a segment that was meant to carry on at speed,
+        // a homing seek ends on its switch before all of its steps are out
+        handle->stopped_abruptly = stepper_ramp_ends_at_speed(&handle->ramp) ||
+                                   handle->steps_done < handle->ramp.total_steps;
+        handle->is_moving = false;
+        return false;
+    }
+
+    load_segment(handle, segment);
+    stepper_segment_queue_release(&handle->queue);
+    return true;
+}
+
+/**
+ * @brief Start the oldest queued segment if the engine is idle
+ *
+ * While the engine is idle the ISR does not touch the queue, so the task
+ * can take over the consumer side for this one segment.
+ */
+static bool queue_kick(stepper_motor_handle_t handle) {
+    bool start = false;
+
+    portENTER_CRITICAL(&handle->lock);
+    if (!handle->is_moving) {
+        stepper_segment_t* segment = stepper_segment_queue_peek(&handle->queue);
+        if (segment != NULL) {
+            load_segment(handle, segment);
+            stepper_segment_queue_release(&handle->queue);
+            start = true;
+        }
+    }
+    portEXIT_CRITICAL(&handle->lock);
+
+    if (!start) {
+        return true;
+    }
+
+    xSemaphoreTake(handle->done_sem, 0);
+    if (!stepper_engine_start(handle)) {
+        ESP_LOGE(TAG, "Failed to start step engine");
+        return false;
+    }
+    return true;
+}
 
-    for (uint32_t i = 0; i < steps; i++) {
+bool stepper_motor_hal_queue_move(stepper_motor_handle_t handle, uint32_t steps,
+                                  stepper_direction_t direction, uint32_t timeout_ms) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return false;
+    }
 
-        delay = MAX(MIN_STEP_DELAY_US, MAX(l - 1 * (int32_t)i, l + 1 * ((int32_t)i - (int32_t)steps)));  // Simple linear ramp down
+    stepper_motor_segment_t segment = {
+        .steps = steps,
+        .direction = direction,
+        .max_velocity = 1000000.0 / handle->step_time_us,
+        .acceleration = handle->acceleration,
+        .jerk = handle->jerk,
+        .entry_velocity = 0.0,
+        .exit_velocity = 0.0,
+    };
+    return stepper_motor_hal_queue_segment(handle, &segment, timeout_ms);
+}
 
-        // stepper_motor_hal_step(handle, (uint32_t)(5.0 + ((double)delay) / ((double)MAX_STEP_DELAY_US) * 195.0));
-        stepper_motor_hal_step(handle, (uint32_t)(delay + 320));
+bool stepper_motor_hal_queue_segment(stepper_motor_handle_t handle, const stepper_motor_segment_t* segment,
+                                     uint32_t timeout_ms) {
+    if (handle == NULL || !handle->is_initialized || segment == NULL) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return false;
+    }
 
-        if (i % 100 == 99) {
-            // ESP_LOGI(TAG, "Progress: %lu/%lu steps", i, steps);
-            // ESP_LOGI(TAG, "Current delay: %lu ms", delay);
-            reset_watchdog_timer();
+    if (!handle->is_enabled) {
+        ESP_LOGE(TAG, "Motor is not enabled! Cannot step.");
+        return false;
+    }
+
+    bool hold = (segment->steps == 0);
+#if CONFIG_STEPPER_BACKEND_RMT
+    // Nothing runs behind an RMT move, so there is nothing to keep in step with
+    hold = false;
+#endif
+    if (segment->steps == 0 && (!hold || segment->hold_us == 0)) {
+        return true;
+    }
+
+    if (!hold && (segment->max_velocity <= 0.0 || segment->acceleration <= 0.0)) {
+        ESP_LOGW(TAG, "Invalid segment limits");
+        return false;
+    }
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    // RMT transactions cannot be queued from the done ISR, so no chaining
+    if (handle->is_moving || stepper_segment_queue_depth(&handle->queue) > 0) {
+        ESP_LOGW(TAG, "RMT backend cannot queue behind a running move");
+        return false;
+    }
+#endif
+
+    stepper_segment_t* slot = stepper_segment_queue_reserve(&handle->queue);
+    TickType_t start = xTaskGetTickCount();
+    while (slot == NULL) {
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms)) {
+            ESP_LOGW(TAG, "Segment queue full, move rejected");
+            return false;
         }
+        vTaskDelay(1);
+        slot = stepper_segment_queue_reserve(&handle->queue);
+    }
 
-        // if (i % 6000 == 5999) {
-        //     vTaskDelay(pdMS_TO_TICKS(100));
-        // }
-        // esp_rom_delay_us(delay);
+    slot->direction = segment->direction;
+    slot->hold_us = 0;
+    if (hold) {
+        memset(&slot->ramp, 0, sizeof(slot->ramp));
+        slot->hold_us = segment->hold_us;
+    } else {
+        plan_ramp_segment(handle, &slot->ramp, segment);
+    }
+    stepper_segment_queue_publish(&handle->queue);
 
-        // if (delay < 1000) {
-        //     esp_rom_delay_us(delay);
-        // } else {
-        //     vTaskDelay(pdMS_TO_TICKS(MAX(delay / 1000, 2)));
-        // }
+    uint32_t depth = stepper_segment_queue_depth(&handle->queue);
+    if (depth > handle->queue_max_depth) {
+        handle->queue_max_depth = depth;
+    }
 
-        // Log progress every 100 steps
+    return queue_kick(handle);
+}
+
+void stepper_motor_hal_queue_begin(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+    handle->queue_streaming = true;
+}
+
+void stepper_motor_hal_queue_end(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+    handle->queue_streaming = false;
+}
+
+void stepper_motor_hal_get_queue_stats(stepper_motor_handle_t handle, stepper_queue_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        *stats = (stepper_queue_stats_t){0};
+        return;
+    }
+
+    stats->depth = stepper_segment_queue_depth(&handle->queue);
+    stats->capacity = STEPPER_SEGMENT_QUEUE_LEN;
+    stats->max_depth = handle->queue_max_depth;
+    stats->underruns = handle->queue_underruns;
+    stats->segments_done = handle->queue_segments_done;
+}
+
+void stepper_motor_hal_reset_queue_stats(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    portENTER_CRITICAL(&handle->lock);
+    handle->queue_max_depth = 0;
+    handle->queue_underruns = 0;
+    handle->queue_segments_done = 0;
+    portEXIT_CRITICAL(&handle->lock);
+}
+
+uint32_t stepper_motor_hal_move_time_us(stepper_motor_handle_t handle, uint32_t steps, uint32_t until_step) {
+    if (handle == NULL || !handle->is_initialized || steps == 0) {
+        return 0;
+    }
+
+    if (until_step > steps) {
+        until_step = steps;
     }
-    
-    // ESP_LOGI(TAG, "Completed %lu steps", steps);
+
+    // Walk the same ramp the step engine would run, off-line
+    stepper_ramp_t ramp;
+    plan_ramp(handle, &ramp, steps);
+
+    uint64_t total_us = 0;
+    for (uint32_t i = 0; i < until_step; i++) {
+        total_us += stepper_ramp_interval_us(&ramp);
+        stepper_ramp_advance(&ramp);
+    }
+    return total_us > UINT32_MAX ? UINT32_MAX : (uint32_t)total_us;
+}
+
+int32_t stepper_motor_hal_get_net_steps(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        return 0;
+    }
+    return handle->net_steps;
+}
+
+uint32_t stepper_motor_hal_get_steps_done(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        return 0;
+    }
+    return handle->steps_done;
+}
+
+void stepper_motor_hal_set_done_callback(stepper_motor_handle_t handle, stepper_motor_done_cb_t callback, void* user_ctx) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    handle->done_cb_ctx = user_ctx;
+    handle->done_cb = callback;
+}
+
+void stepper_motor_hal_set_step_time(stepper_motor_handle_t handle, uint32_t step_time_us) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    uint32_t min_time = handle->pulse_width_us + STEPPER_RAMP_MIN_LOW_TIME_US;
+    if (min_time < STEPPER_MIN_STEP_TIME_US) {
+        min_time = STEPPER_MIN_STEP_TIME_US;
+    }
+
+    if (step_time_us < min_time) {
+        ESP_LOGW(TAG, "Step time %lu us too short, using %lu us", step_time_us, min_time);
+        step_time_us = min_time;
+    }
+
+    handle->step_time_us = step_time_us;
+}
+
+uint32_t stepper_motor_hal_get_step_time(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return 0;
+    }
+
+    return handle->step_time_us;
+}
+
+void stepper_motor_hal_set_pulse_width(stepper_motor_handle_t handle, uint32_t pulse_width_us) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    if (pulse_width_us == 0) {
+        ESP_LOGW(TAG, "Pulse width must be at least 1 us");
+        pulse_width_us = 1;
+    }
+
+    handle->pulse_width_us = pulse_width_us;
+
+    // Keep room for the LOW phase at full speed
+    if (handle->step_time_us < pulse_width_us + STEPPER_RAMP_MIN_LOW_TIME_US) {
+        handle->step_time_us = pulse_width_us + STEPPER_RAMP_MIN_LOW_TIME_US;
+    }
+}
+
+uint32_t stepper_motor_hal_get_pulse_width(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return 0;
+    }
+
+    return handle->pulse_width_us;
+}
+
+void stepper_motor_hal_set_acceleration(stepper_motor_handle_t handle, double acceleration) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    if (acceleration < STEPPER_MIN_ACCELERATION) {
+        ESP_LOGW(TAG, "Acceleration %.1f steps/s^2 too low, using %d steps/s^2",
+                 acceleration, STEPPER_MIN_ACCELERATION);
+        acceleration = STEPPER_MIN_ACCELERATION;
+    }
+
+    handle->acceleration = acceleration;
+}
+
+double stepper_motor_hal_get_acceleration(stepper_motor_handle_t handle) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return 0.0;
+    }
+
+    return handle->acceleration;
+}
+
+void stepper_motor_hal_set_profile(stepper_motor_handle_t handle, stepper_profile_t profile, double jerk) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    if (profile == STEPPER_PROFILE_S_CURVE && jerk <= 0.0) {
+        ESP_LOGW(TAG, "S-curve needs a positive jerk limit, keeping trapezoid");
+        profile = STEPPER_PROFILE_TRAPEZOID;
+    }
+
+    handle->profile = profile;
+    handle->jerk = jerk;
+}
+
+void stepper_motor_hal_set_accel_table(stepper_motor_handle_t handle, const stepper_accel_table_t* table) {
+    if (handle == NULL || !handle->is_initialized) {
+        ESP_LOGW(TAG, "Handle is NULL or not initialized");
+        return;
+    }
+
+    if (table != NULL && (table->length < 2 || table->interval == NULL)) {
+        ESP_LOGW(TAG, "Invalid acceleration table ignored");
+        table = NULL;
+    }
+
+    handle->accel_table = table;
 }
 
 stepper_direction_t stepper_motor_hal_get_direction(stepper_motor_handle_t handle) {
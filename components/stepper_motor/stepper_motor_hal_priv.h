@@ -0,0 +1,211 @@
+/**
+ * @file stepper_motor_hal_priv.h
+ * @brief Private definitions shared between the stepper HAL and its step engine
+ *
+ * Not part of the public API. The handle layout is visible here so the
+ * step-generation backend can drive the STEP line from interrupt context.
+ */
+
+#ifndef STEPPER_MOTOR_HAL_PRIV_H
+#define STEPPER_MOTOR_HAL_PRIV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "sdkconfig.h"
+
+#if CONFIG_STEPPER_BACKEND_RMT
+#include "driver/rmt_tx.h"
+#else
+#include "driver/gptimer.h"
+#endif
+
+#include "stepper_motor_hal.h"
+#include "stepper_ramp.h"
+#include "stepper_segment_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Step engine timer resolution (1 tick = 1 us)
+ */
+#define STEPPER_TIMER_RESOLUTION_HZ 1000000
+
+#if CONFIG_STEPPER_BACKEND_RMT
+/**
+ * @brief Maximum number of RMT transactions per move (accel, cruise, decel)
+ */
+#define STEPPER_RMT_MAX_SEGMENTS 3
+
+/**
+ * @brief One RMT transaction of a move
+ *
+ * Passed as payload to rmt_transmit(); the encoder turns it into one
+ * symbol per step. A looped cruise segment encodes a single symbol that
+ * the hardware repeats `steps` times.
+ */
+typedef struct {
+    uint32_t first_step;        // Index of the first step within the move
+    uint32_t symbols;           // Symbols to encode
+    uint32_t steps;             // Steps emitted (symbols * loop count)
+} stepper_rmt_segment_t;
+
+/**
+ * @brief Longest homing seek sent as one RMT move
+ *
+ * The RMT engine cannot stop a transmission on the switch, so a seek runs
+ * as bursts of this many steps and the switch is read between them.
+ */
+#define STEPPER_RMT_HOMING_BURST_STEPS 8
+#endif
+
+/**
+ * @brief Internal structure for stepper motor handle
+ */
+struct stepper_motor_handle_s {
+    stepper_motor_config_t config;
+    bool is_enabled;
+    bool is_initialized;
+    stepper_direction_t direction;
+    uint32_t step_time_us;              // Cruise interval between rising edges
+    uint32_t pulse_width_us;            // STEP HIGH time
+    double acceleration;                // Ramp acceleration in steps/s^2
+    stepper_profile_t profile;          // Ramp shape
+    double jerk;                        // S-curve jerk limit in steps/s^3
+    const stepper_accel_table_t* accel_table; // Precomputed trapezoid ramp, or NULL
+
+    // Step engine state (written by the ISR while a move is running)
+    volatile bool is_moving;
+    volatile uint32_t steps_done;
+    stepper_ramp_t ramp;                // Timing of the current move
+    bool step_high;                     // Current STEP line level
+
+    // Signed step count since init, clockwise positive (written by the ISR)
+    volatile int32_t net_steps;
+
+    // Segments waiting behind the current move (see stepper_segment_queue.h)
+    stepper_segment_queue_t queue;
+    bool queue_streaming;               // Producer promised more segments
+    volatile bool stopped_abruptly;     // Last move ended without its deceleration ramp
+    bool stop_at_endpoint;              // Current move is a homing seek (see stepper_endpoint_hit())
+    uint32_t hold_us;                   // Length of the current segment when it has no steps
+    volatile uint32_t queue_underruns;
+    volatile uint32_t queue_segments_done;
+    uint32_t queue_max_depth;
+    portMUX_TYPE lock;                  // Guards the idle <-> running hand-off
+
+    // Completion notification
+    SemaphoreHandle_t done_sem;
+    stepper_motor_done_cb_t done_cb;
+    void* done_cb_ctx;
+
+#if CONFIG_STEPPER_BACKEND_RMT
+    rmt_channel_handle_t rmt_channel;
+    rmt_encoder_handle_t rmt_encoder;
+    stepper_rmt_segment_t rmt_segments[STEPPER_RMT_MAX_SEGMENTS];
+    uint32_t rmt_segment_count;
+    volatile uint32_t rmt_segments_done;
+#elif CONFIG_STEPPER_BACKEND_MULTI_AXIS
+    uint32_t group_slot;                // Index in the shared axis table
+    uint64_t next_edge_us;              // Absolute time of the next STEP edge
+    uint32_t step_mask_lo;              // STEP bit in GPIO.out_w1ts/out_w1tc (GPIO 0-31)
+    uint32_t step_mask_hi;              // STEP bit in GPIO.out1_w1ts/out1_w1tc (GPIO 32-39)
+    uint32_t dda_followers;             // Slots stepping along with this (lead) axis
+    uint32_t dda_error;                 // Bresenham accumulator of a follower axis
+#else
+    gptimer_handle_t timer;
+#endif
+};
+
+/**
+ * @brief Account for steps emitted in the current direction
+ */
+static inline void IRAM_ATTR stepper_count_steps(stepper_motor_handle_t handle, uint32_t steps) {
+    handle->net_steps += (handle->direction == STEPPER_DIR_CLOCKWISE) ? (int32_t)steps : -(int32_t)steps;
+}
+
+/**
+ * @brief True while the current segment is a timed hold without steps
+ */
+static inline bool IRAM_ATTR stepper_is_holding(stepper_motor_handle_t handle) {
+    return handle->ramp.total_steps == 0;
+}
+
+/**
+ * @brief True if another segment is waiting in the queue
+ *
+ * The step ISR chains it right at the last falling edge of a segment, so
+ * a DIR change gets the whole LOW time as setup. With nothing waiting the
+ * segment ends only once that LOW time has run out.
+ */
+static inline bool IRAM_ATTR stepper_queue_pending(stepper_motor_handle_t handle) {
+    return stepper_segment_queue_peek(&handle->queue) != NULL;
+}
+
+/**
+ * @brief Checked by the step ISR before each STEP pulse of a homing seek
+ *
+ * True once the endpoint switch (active LOW) has closed; the engine then
+ * ends the move without emitting the pulse, like a segment that finished.
+ */
+static inline bool IRAM_ATTR stepper_endpoint_hit(stepper_motor_handle_t handle) {
+    return handle->stop_at_endpoint && gpio_get_level(handle->config.endpoint_pin) == 0;
+}
+
+/**
+ * @brief Called by the step ISR when the current segment has finished
+ *
+ * Loads the next queued segment into handle->ramp (setting DIR when it
+ * changes) and returns true, so the engine keeps going without a gap.
+ * Returns false and clears is_moving when the queue is empty; the engine
+ * then stops and signals completion. Caller holds handle->lock.
+ */
+bool stepper_queue_next_from_isr(stepper_motor_handle_t handle);
+
+/**
+ * @brief Allocate step engine resources for a handle
+ */
+bool stepper_engine_init(stepper_motor_handle_t handle);
+
+/**
+ * @brief Release step engine resources for a handle
+ */
+void stepper_engine_deinit(stepper_motor_handle_t handle);
+
+/**
+ * @brief Start emitting handle->ramp.total_steps pulses in the background
+ */
+bool stepper_engine_start(stepper_motor_handle_t handle);
+
+/**
+ * @brief Abort the running pulse train (STEP line is left LOW)
+ */
+void stepper_engine_stop(stepper_motor_handle_t handle);
+
+#if CONFIG_STEPPER_BACKEND_MULTI_AXIS
+/**
+ * @brief Write DIR of all handles at once and start their moves in the same tick
+ */
+bool stepper_engine_start_group(stepper_motor_handle_t* handles, size_t count);
+
+/**
+ * @brief Start a straight-line move led by handles[0]
+ *
+ * Only the lead axis walks its ramp. Every other handle steps on the lead's
+ * edges whenever its Bresenham accumulator overflows, so the axes stay on
+ * the line at every step. Followers' ramp.total_steps holds their length.
+ */
+bool stepper_engine_start_linear(stepper_motor_handle_t* handles, size_t count);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STEPPER_MOTOR_HAL_PRIV_H
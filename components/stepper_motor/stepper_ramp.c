@@ -0,0 +1,252 @@
+/**
+ * @file stepper_ramp.c
+ * @brief Trapezoidal profile planning for the step engine
+ *
+ * Converts the speed limits of a move into the integer parameters walked by
+ * stepper_ramp_advance(). Called from task context only.
+ *
+ * The S-curve ramps use the usual 7-segment shape: jerk up, constant
+ * acceleration (skipped when the speed change is too small to reach the
+ * acceleration limit), jerk down. Cruise fills the middle.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "stepper_ramp.h"
+
+// Austin's correction of the first interval when starting from rest
+#define RAMP_FIRST_INTERVAL_FACTOR 0.676
+
+#define RAMP_FIXED_ONE (1u << STEPPER_RAMP_FRAC_BITS)
+#define RAMP_MAX_INTERVAL ((double)STEPPER_RAMP_MAX_INTERVAL_US * RAMP_FIXED_ONE)
+
+static uint32_t interval_from_velocity(double velocity) {
+    double interval = 1000000.0 * RAMP_FIXED_ONE / velocity;
+    return interval > RAMP_MAX_INTERVAL ? (uint32_t)RAMP_MAX_INTERVAL : (uint32_t)interval;
+}
+
+void stepper_ramp_plan(stepper_ramp_t* ramp, uint32_t total_steps, uint32_t pulse_width_us,
+                       double max_velocity, double acceleration,
+                       double entry_velocity, double exit_velocity,
+                       const stepper_accel_table_t* table) {
+    memset(ramp, 0, sizeof(*ramp));
+    ramp->total_steps = total_steps;
+    ramp->pulse_width_us = pulse_width_us;
+
+    double v_min = 1000000.0 / STEPPER_RAMP_MAX_INTERVAL_US;
+    if (max_velocity < v_min) {
+        max_velocity = v_min;
+    }
+    entry_velocity = fmin(fmax(entry_velocity, 0.0), max_velocity);
+    exit_velocity = fmin(fmax(exit_velocity, 0.0), max_velocity);
+
+    // Steps needed to reach the speed limit from either end
+    double two_a = 2.0 * acceleration;
+    double v_peak = max_velocity;
+    double up = (v_peak * v_peak - entry_velocity * entry_velocity) / two_a;
+    double down = (v_peak * v_peak - exit_velocity * exit_velocity) / two_a;
+
+    // Triangle profile: the ramps meet before the speed limit is reached
+    if (up + down > total_steps) {
+        double v_peak_sq = acceleration * total_steps +
+                           (entry_velocity * entry_velocity + exit_velocity * exit_velocity) / 2.0;
+        v_peak = sqrt(v_peak_sq);
+        up = fmax((v_peak_sq - entry_velocity * entry_velocity) / two_a, 0.0);
+        down = fmax(total_steps - up, 0.0);
+    }
+
+    ramp->accel_steps = (uint32_t)lround(fmin(up, (double)total_steps));
+    ramp->decel_steps = (uint32_t)lround(fmin(down, (double)(total_steps - ramp->accel_steps)));
+    ramp->cruise_interval = interval_from_velocity(v_peak);
+    ramp->exit_index = (uint32_t)(exit_velocity * exit_velocity / two_a);
+
+    if (ramp->accel_steps == 0) {
+        ramp->start_interval = entry_velocity > v_min ? interval_from_velocity(entry_velocity)
+                                                      : ramp->cruise_interval;
+        if (ramp->start_interval < ramp->cruise_interval) {
+            ramp->start_interval = ramp->cruise_interval;
+        }
+    } else if (entry_velocity > v_min) {
+        ramp->start_interval = interval_from_velocity(entry_velocity);
+        ramp->start_index = (uint32_t)(entry_velocity * entry_velocity / two_a);
+    } else {
+        double c0 = RAMP_FIRST_INTERVAL_FACTOR * sqrt(2.0 / acceleration) * 1000000.0 * RAMP_FIXED_ONE;
+        ramp->start_interval = c0 > RAMP_MAX_INTERVAL ? (uint32_t)RAMP_MAX_INTERVAL : (uint32_t)c0;
+    }
+
+    // The table must match this acceleration and reach every ramp index used
+    if (table != NULL && fabs(table->acceleration - acceleration) < 1.0 &&
+        ramp->start_index + ramp->accel_steps <= stepper_accel_table_span(table) &&
+        ramp->exit_index + ramp->decel_steps <= stepper_accel_table_span(table)) {
+        ramp->table = table;
+        if (ramp->accel_steps > 0) {
+            ramp->start_interval = stepper_accel_table_interval(table, ramp->start_index);
+            if (ramp->start_interval < ramp->cruise_interval) {
+                ramp->start_interval = ramp->cruise_interval;
+            }
+        }
+    }
+
+    stepper_ramp_reset(ramp);
+}
+
+/**
+ * @brief One jerk-limited speed change from v0 to v1 (v1 >= v0)
+ */
+typedef struct {
+    double v0;          // Start speed (steps/s)
+    double a_peak;      // Acceleration reached (steps/s^2)
+    double jerk;        // steps/s^3
+    double t_jerk;      // Duration of each jerk phase
+    double t_const;     // Duration of the constant acceleration phase
+} s_ramp_t;
+
+static s_ramp_t s_ramp_make(double v0, double v1, double acceleration, double jerk) {
+    s_ramp_t r = { .v0 = v0, .jerk = jerk };
+    double dv = fmax(v1 - v0, 0.0);
+
+    if (dv * jerk >= acceleration * acceleration) {
+        r.t_jerk = acceleration / jerk;
+        r.t_const = dv / acceleration - r.t_jerk;
+    } else {
+        r.t_jerk = sqrt(dv / jerk);
+        r.t_const = 0.0;
+    }
+    r.a_peak = jerk * r.t_jerk;
+    return r;
+}
+
+static double s_ramp_duration(const s_ramp_t* r) {
+    return 2.0 * r->t_jerk + r->t_const;
+}
+
+static double s_ramp_distance(const s_ramp_t* r) {
+    // Symmetric ramp: average speed is the mean of both ends
+    double v1 = r->v0 + r->a_peak * (r->t_jerk + r->t_const);
+    return (r->v0 + v1) / 2.0 * s_ramp_duration(r);
+}
+
+/**
+ * @brief Speed and distance t seconds into the ramp
+ */
+static void s_ramp_eval(const s_ramp_t* r, double t, double* v, double* s) {
+    double tj = r->t_jerk, ta = r->t_const, j = r->jerk, ap = r->a_peak;
+
+    if (t <= tj) {
+        *v = r->v0 + j * t * t / 2.0;
+        *s = r->v0 * t + j * t * t * t / 6.0;
+        return;
+    }
+
+    double v1 = r->v0 + j * tj * tj / 2.0;
+    double s1 = r->v0 * tj + j * tj * tj * tj / 6.0;
+    if (t <= tj + ta) {
+        double u = t - tj;
+        *v = v1 + ap * u;
+        *s = s1 + v1 * u + ap * u * u / 2.0;
+        return;
+    }
+
+    double v2 = v1 + ap * ta;
+    double s2 = s1 + v1 * ta + ap * ta * ta / 2.0;
+    double u = fmin(t - tj - ta, tj);
+    *v = v2 + ap * u - j * u * u / 2.0;
+    *s = s2 + v2 * u + ap * u * u / 2.0 - j * u * u * u / 6.0;
+}
+
+/**
+ * @brief Speed after travelling distance d into the ramp
+ */
+static double s_ramp_velocity_at(const s_ramp_t* r, double d) {
+    double lo = 0.0, hi = s_ramp_duration(r), v = r->v0, s;
+
+    for (int iter = 0; iter < 40; iter++) {
+        double mid = (lo + hi) / 2.0;
+        s_ramp_eval(r, mid, &v, &s);
+        if (s < d) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    s_ramp_eval(r, hi, &v, &s);
+    return v;
+}
+
+/**
+ * @brief Sample a ramp spread over `steps` steps into a step-rate table
+ */
+static void s_ramp_fill_table(uint32_t* rate, const s_ramp_t* r, uint32_t steps, double v_min) {
+    double distance = s_ramp_distance(r);
+
+    for (uint32_t k = 0; k <= STEPPER_RAMP_TABLE_POINTS; k++) {
+        // Speed in the middle of the sampled step, ramp rescaled to whole steps
+        double step = (double)k * steps / STEPPER_RAMP_TABLE_POINTS;
+        double d = steps > 0 ? (step + 0.5) * distance / steps : 0.0;
+        double v = fmax(s_ramp_velocity_at(r, d), v_min);
+        rate[k] = (uint32_t)(v * (1u << STEPPER_RAMP_RATE_FRAC_BITS));
+    }
+}
+
+void stepper_ramp_plan_s_curve(stepper_ramp_t* ramp, uint32_t total_steps, uint32_t pulse_width_us,
+                               double max_velocity, double acceleration, double jerk,
+                               double entry_velocity, double exit_velocity) {
+    memset(ramp, 0, sizeof(*ramp));
+    ramp->total_steps = total_steps;
+    ramp->pulse_width_us = pulse_width_us;
+    ramp->s_curve = true;
+
+    double v_min = 1000000.0 / STEPPER_RAMP_MAX_INTERVAL_US;
+    if (max_velocity < v_min) {
+        max_velocity = v_min;
+    }
+    entry_velocity = fmin(fmax(entry_velocity, 0.0), max_velocity);
+    exit_velocity = fmin(fmax(exit_velocity, 0.0), max_velocity);
+
+    // Highest peak speed whose two ramps still fit in the move
+    double v_floor = fmax(entry_velocity, exit_velocity);
+    double v_peak = max_velocity;
+    s_ramp_t up = s_ramp_make(entry_velocity, v_peak, acceleration, jerk);
+    s_ramp_t down = s_ramp_make(exit_velocity, v_peak, acceleration, jerk);
+
+    if (s_ramp_distance(&up) + s_ramp_distance(&down) > total_steps) {
+        double lo = v_floor, hi = max_velocity;
+        for (int iter = 0; iter < 40; iter++) {
+            v_peak = (lo + hi) / 2.0;
+            up = s_ramp_make(entry_velocity, v_peak, acceleration, jerk);
+            down = s_ramp_make(exit_velocity, v_peak, acceleration, jerk);
+            if (s_ramp_distance(&up) + s_ramp_distance(&down) > total_steps) {
+                hi = v_peak;
+            } else {
+                lo = v_peak;
+            }
+        }
+        v_peak = fmax(lo, v_min);
+        up = s_ramp_make(entry_velocity, v_peak, acceleration, jerk);
+        down = s_ramp_make(exit_velocity, v_peak, acceleration, jerk);
+    }
+
+    ramp->accel_steps = (uint32_t)lround(fmin(s_ramp_distance(&up), (double)total_steps));
+    ramp->decel_steps = (uint32_t)lround(fmin(s_ramp_distance(&down),
+                                              (double)(total_steps - ramp->accel_steps)));
+    ramp->cruise_interval = interval_from_velocity(v_peak);
+    ramp->exit_index = (uint32_t)(exit_velocity * exit_velocity / (2.0 * acceleration));
+
+    s_ramp_fill_table(ramp->accel_rate, &up, ramp->accel_steps, v_min);
+    s_ramp_fill_table(ramp->decel_rate, &down, ramp->decel_steps, v_min);
+
+    if (ramp->accel_steps > 0) {
+        ramp->start_interval = stepper_ramp_table_interval(ramp->accel_rate, 0, ramp->accel_steps);
+    } else if (ramp->decel_steps >= total_steps) {
+        ramp->start_interval = stepper_ramp_table_interval(ramp->decel_rate, total_steps - 1,
+                                                           ramp->decel_steps);
+    } else {
+        ramp->start_interval = ramp->cruise_interval;
+    }
+    if (ramp->start_interval < ramp->cruise_interval) {
+        ramp->start_interval = ramp->cruise_interval;
+    }
+
+    stepper_ramp_reset(ramp);
+}
@@ -0,0 +1,280 @@
+/**
+ * @file stepper_ramp.h
+ * @brief Step timing shared by the step engine backends
+ *
+ * Private to the stepper_motor component. A move is planned once in task
+ * context as a trapezoidal velocity profile (accelerate, cruise, decelerate,
+ * or a triangle for short moves). The step engine then walks the profile one
+ * step at a time with integer-only arithmetic, since the FPU cannot be used
+ * from an interrupt on the ESP32.
+ *
+ * Intervals follow D. Austin, "Generate stepper-motor speed profiles in real
+ * time" (AVR446): c_n = c_{n-1} - 2 c_{n-1} / (4n + 1) while accelerating and
+ * the mirrored recurrence while decelerating. Intervals are kept in Q24.8 us.
+ * When the axis has a precomputed table for the planned acceleration, the
+ * recurrence is replaced by a table lookup with linear interpolation.
+ *
+ * A jerk-limited S-curve profile has no such recurrence. Its ramps are
+ * sampled into short step-rate tables at plan time and the step engine
+ * interpolates between the samples, one integer division per step.
+ *
+ * The STEP pulse width is constant; only the interval between rising
+ * edges changes along the ramp, so the interval alone sets the speed.
+ */
+
+#ifndef STEPPER_RAMP_H
+#define STEPPER_RAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "stepper_accel_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Minimum LOW time between two pulses
+#define STEPPER_RAMP_MIN_LOW_TIME_US 2
+
+// Longest interval the ramp will produce (slowest step rate)
+#define STEPPER_RAMP_MAX_INTERVAL_US 30000
+
+// Fractional bits of the interval fixed-point representation
+#define STEPPER_RAMP_FRAC_BITS 8
+
+// Samples per S-curve ramp table (the table holds one more end point)
+#define STEPPER_RAMP_TABLE_POINTS 32
+
+// Fractional bits of the step rates stored in the S-curve tables
+#define STEPPER_RAMP_RATE_FRAC_BITS 4
+
+// 1 s in Q24.8 us divided by a Q28.4 step rate gives a Q24.8 interval
+#define STEPPER_RAMP_RATE_TO_INTERVAL \
+    (1000000u << (STEPPER_RAMP_FRAC_BITS + STEPPER_RAMP_RATE_FRAC_BITS))
+
+/**
+ * @brief Planned profile of one move plus its iteration state
+ */
+typedef struct {
+    // Plan (filled by stepper_ramp_plan())
+    uint32_t total_steps;           // Length of the move
+    uint32_t pulse_width_us;        // STEP HIGH time
+    uint32_t accel_steps;           // Steps with decreasing interval
+    uint32_t decel_steps;           // Steps with increasing interval
+    uint32_t cruise_interval;       // Interval at peak speed (Q24.8 us)
+    uint32_t start_interval;        // Interval of the first step (Q24.8 us)
+    uint32_t start_index;           // Ramp index matching the entry velocity
+    uint32_t exit_index;            // Ramp index matching the exit velocity
+    const stepper_accel_table_t* table; // Precomputed ramp, NULL to use the recurrence
+    bool s_curve;                   // Intervals come from the rate tables below
+    uint32_t accel_rate[STEPPER_RAMP_TABLE_POINTS + 1];  // From first step up to cruise (Q28.4 steps/s)
+    uint32_t decel_rate[STEPPER_RAMP_TABLE_POINTS + 1];  // From last step up to cruise (Q28.4 steps/s)
+
+    // Iteration state (advanced by the step engine)
+    uint32_t step;                  // Index of the step whose interval is current
+    uint32_t interval;              // Current interval (Q24.8 us)
+    uint32_t index;                 // Current acceleration ramp index
+} stepper_ramp_t;
+
+/**
+ * @brief Move split into constant-rate and ramping segments
+ */
+typedef struct {
+    uint32_t accel_steps;       // Steps with decreasing period
+    uint32_t cruise_steps;      // Steps at the minimum period
+    uint32_t decel_steps;       // Steps with increasing period
+} stepper_ramp_segments_t;
+
+/**
+ * @brief Plan a trapezoidal (or triangular) profile
+ *
+ * Runs in task context (uses floating point).
+ *
+ * @param ramp Profile to fill
+ * @param total_steps Length of the move
+ * @param pulse_width_us STEP HIGH time
+ * @param max_velocity Cruise speed limit in steps/s
+ * @param acceleration Acceleration and deceleration in steps/s^2
+ * @param entry_velocity Speed at the first step in steps/s (0 = from rest)
+ * @param exit_velocity Speed after the last step in steps/s (0 = to rest)
+ * @param table Precomputed ramp of the axis, or NULL. Used only when it was
+ *              generated for this acceleration and covers the whole ramp.
+ */
+void stepper_ramp_plan(stepper_ramp_t* ramp, uint32_t total_steps, uint32_t pulse_width_us,
+                       double max_velocity, double acceleration,
+                       double entry_velocity, double exit_velocity,
+                       const stepper_accel_table_t* table);
+
+/**
+ * @brief Plan a jerk-limited (7-segment S-curve) profile
+ *
+ * Same as stepper_ramp_plan(), but acceleration ramps up and down with
+ * bounded jerk instead of switching on and off.
+ *
+ * @param jerk Rate of change of acceleration in steps/s^3
+ */
+void stepper_ramp_plan_s_curve(stepper_ramp_t* ramp, uint32_t total_steps, uint32_t pulse_width_us,
+                               double max_velocity, double acceleration, double jerk,
+                               double entry_velocity, double exit_velocity);
+
+/**
+ * @brief Interval at position i of an S-curve ramp of given length
+ */
+static inline uint32_t IRAM_ATTR stepper_ramp_table_interval(const uint32_t* rate,
+                                                            uint32_t i, uint32_t length) {
+    uint32_t pos = i * STEPPER_RAMP_TABLE_POINTS;
+    uint32_t k = pos / length;
+    uint32_t frac = pos % length;
+    int32_t span = (int32_t)rate[k + 1] - (int32_t)rate[k];
+    uint32_t v = rate[k] + (int32_t)(((int64_t)span * frac) / length);
+    if (v == 0) {
+        v = 1;
+    }
+    uint32_t c = STEPPER_RAMP_RATE_TO_INTERVAL / v;
+    return c > (STEPPER_RAMP_MAX_INTERVAL_US << STEPPER_RAMP_FRAC_BITS)
+               ? (STEPPER_RAMP_MAX_INTERVAL_US << STEPPER_RAMP_FRAC_BITS) : c;
+}
+
+/**
+ * @brief Interval at ramp index n from a precomputed table
+ *
+ * Linear interpolation between two entries in fixed point, no division.
+ */
+static inline uint32_t IRAM_ATTR stepper_accel_table_interval(const stepper_accel_table_t* table,
+                                                             uint32_t n) {
+    uint32_t k = n >> table->stride_shift;
+    if (k + 1 >= table->length) {
+        return table->interval[table->length - 1];
+    }
+    uint32_t frac = n - (k << table->stride_shift);
+    int32_t span = (int32_t)table->interval[k + 1] - (int32_t)table->interval[k];
+    return table->interval[k] + (int32_t)(((int64_t)span * frac) >> table->stride_shift);
+}
+
+/**
+ * @brief Rewind the iteration state to the first step
+ */
+static inline void stepper_ramp_reset(stepper_ramp_t* ramp) {
+    ramp->step = 0;
+    ramp->interval = ramp->start_interval;
+    ramp->index = ramp->start_index;
+}
+
+/**
+ * @brief Interval of the current step in microseconds
+ */
+static inline uint32_t IRAM_ATTR stepper_ramp_interval_us(const stepper_ramp_t* ramp) {
+    return ramp->interval >> STEPPER_RAMP_FRAC_BITS;
+}
+
+/**
+ * @brief Move the iteration state to the next step
+ */
+static inline void IRAM_ATTR stepper_ramp_advance(stepper_ramp_t* ramp) {
+    uint32_t next = ++ramp->step;
+    uint32_t c = ramp->interval;
+
+    if (ramp->s_curve) {
+        if (next < ramp->accel_steps) {
+            c = stepper_ramp_table_interval(ramp->accel_rate, next, ramp->accel_steps);
+        } else if (next + ramp->decel_steps < ramp->total_steps) {
+            c = ramp->cruise_interval;
+        } else if (next < ramp->total_steps) {
+            c = stepper_ramp_table_interval(ramp->decel_rate, ramp->total_steps - 1 - next,
+                                            ramp->decel_steps);
+        }
+        if (c < ramp->cruise_interval) {
+            c = ramp->cruise_interval;
+        }
+        ramp->interval = c;
+        return;
+    }
+
+    if (next < ramp->accel_steps) {
+        ramp->index++;
+        if (ramp->table) {
+            c = stepper_accel_table_interval(ramp->table, ramp->index);
+        } else {
+            c -= (2 * c) / (4 * ramp->index + 1);
+        }
+        if (c < ramp->cruise_interval) {
+            c = ramp->cruise_interval;
+        }
+    } else if (next + ramp->decel_steps < ramp->total_steps) {
+        c = ramp->cruise_interval;
+    } else if (next < ramp->total_steps) {
+        // Ramp index of the speed we are leaving: remaining steps + exit speed index
+        uint32_t m = ramp->total_steps - next + 1 + ramp->exit_index;
+        if (ramp->table) {
+            c = stepper_accel_table_interval(ramp->table, m - 1);
+        } else {
+            c += (2 * c) / (4 * m - 1);
+        }
+        if (c < ramp->cruise_interval) {
+            c = ramp->cruise_interval;
+        }
+        if (c > (STEPPER_RAMP_MAX_INTERVAL_US << STEPPER_RAMP_FRAC_BITS)) {
+            c = STEPPER_RAMP_MAX_INTERVAL_US << STEPPER_RAMP_FRAC_BITS;
+        }
+    }
+
+    ramp->interval = c;
+}
+
+/**
+ * @brief True if the move ends at speed, for a next one to carry on
+ *
+ * Exit speeds below the first step from rest count as rest.
+ */
+static inline bool IRAM_ATTR stepper_ramp_ends_at_speed(const stepper_ramp_t* ramp) {
+    return ramp->exit_index > 0;
+}
+
+/**
+ * @brief Skip ahead to step i inside the cruise segment
+ *
+ * Used when the backend emitted cruise steps without walking the ramp
+ * (e.g. a hardware-looped pulse).
+ */
+static inline void IRAM_ATTR stepper_ramp_seek_cruise(stepper_ramp_t* ramp, uint32_t i) {
+    if (i > ramp->step) {
+        ramp->step = i;
+        ramp->interval = ramp->cruise_interval;
+    }
+}
+
+/**
+ * @brief HIGH time of the current step, in microseconds
+ */
+static inline uint32_t IRAM_ATTR stepper_ramp_high_time_us(const stepper_ramp_t* ramp) {
+    return ramp->pulse_width_us;
+}
+
+/**
+ * @brief LOW time after the current step, in microseconds
+ */
+static inline uint32_t IRAM_ATTR stepper_ramp_low_time_us(const stepper_ramp_t* ramp) {
+    uint32_t interval = stepper_ramp_interval_us(ramp);
+    if (interval < ramp->pulse_width_us + STEPPER_RAMP_MIN_LOW_TIME_US) {
+        return STEPPER_RAMP_MIN_LOW_TIME_US;
+    }
+    return interval - ramp->pulse_width_us;
+}
+
+/**
+ * @brief Split a planned move into ramp segments
+ */
+static inline stepper_ramp_segments_t stepper_ramp_split(const stepper_ramp_t* ramp) {
+    stepper_ramp_segments_t seg;
+    seg.accel_steps = ramp->accel_steps;
+    seg.decel_steps = ramp->decel_steps;
+    seg.cruise_steps = ramp->total_steps - ramp->accel_steps - ramp->decel_steps;
+    return seg;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STEPPER_RAMP_H
@@ -0,0 +1,103 @@
+/**
+ * @file stepper_segment_queue.h
+ * @brief Lock-free single-producer/single-consumer ring of planned segments
+ *
+ * Private to the stepper_motor component. The planner task is the only
+ * producer and the step ISR the only consumer, so the ring needs no lock:
+ * each side owns one index and publishes it with release ordering after
+ * the slot contents are complete.
+ *
+ * A slot is filled in place (its ramp is planned directly into the ring),
+ * which keeps the ISR side down to one copy when it picks the next segment.
+ */
+
+#ifndef STEPPER_SEGMENT_QUEUE_H
+#define STEPPER_SEGMENT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "sdkconfig.h"
+
+#include "stepper_motor_hal.h"
+#include "stepper_ramp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STEPPER_SEGMENT_QUEUE_LEN CONFIG_STEPPER_SEGMENT_QUEUE_LEN
+
+_Static_assert((STEPPER_SEGMENT_QUEUE_LEN & (STEPPER_SEGMENT_QUEUE_LEN - 1)) == 0,
+               "STEPPER_SEGMENT_QUEUE_LEN must be a power of two");
+
+/**
+ * @brief One precomputed motion segment
+ */
+typedef struct {
+    stepper_direction_t direction;  // DIR for every step of the segment
+    uint32_t hold_us;               // Wait time of a segment without steps
+    stepper_ramp_t ramp;            // Step count and per-step intervals
+} stepper_segment_t;
+
+/**
+ * @brief Segment ring (indices run freely and wrap on overflow)
+ */
+typedef struct {
+    stepper_segment_t slots[STEPPER_SEGMENT_QUEUE_LEN];
+    uint32_t head;                  // Next slot to fill, written by the producer only
+    uint32_t tail;                  // Next slot to drain, written by the consumer only
+} stepper_segment_queue_t;
+
+/**
+ * @brief Number of published segments not yet taken by the consumer
+ */
+static inline uint32_t IRAM_ATTR stepper_segment_queue_depth(const stepper_segment_queue_t* q) {
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+/**
+ * @brief Producer: slot to fill next, NULL when the ring is full
+ */
+static inline stepper_segment_t* stepper_segment_queue_reserve(stepper_segment_queue_t* q) {
+    uint32_t head = q->head;
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= STEPPER_SEGMENT_QUEUE_LEN) {
+        return NULL;
+    }
+    return &q->slots[head & (STEPPER_SEGMENT_QUEUE_LEN - 1)];
+}
+
+/**
+ * @brief Producer: hand the reserved slot to the consumer
+ */
+static inline void stepper_segment_queue_publish(stepper_segment_queue_t* q) {
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer: oldest published segment, NULL when the ring is empty
+ */
+static inline stepper_segment_t* IRAM_ATTR stepper_segment_queue_peek(stepper_segment_queue_t* q) {
+    uint32_t tail = q->tail;
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return NULL;
+    }
+    return &q->slots[tail & (STEPPER_SEGMENT_QUEUE_LEN - 1)];
+}
+
+/**
+ * @brief Consumer: give the peeked slot back to the producer
+ */
+static inline void IRAM_ATTR stepper_segment_queue_release(stepper_segment_queue_t* q) {
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STEPPER_SEGMENT_QUEUE_H
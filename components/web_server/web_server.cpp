@@ -9,9 +9,13 @@
 #include <esp_http_server.h>
 #include <esp_log.h>
 #include <string.h>
+#include <algorithm>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "gcode_parser.h"
+#include "gcode_tour.h"
+#include "motion_controller.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "WEB_SERVER";
 
@@ -21,6 +25,9 @@ extern size_t g_gcode_size;
 extern bool g_gcode_loaded;
 extern SemaphoreHandle_t g_gcode_mutex;
 
+// Motion controller (defined in main.cpp)
+extern motion_controller_handle_t g_motion_controller;
+
 // Declare embedded files (created by CMake EMBED_FILES)
 extern const uint8_t index_html_start[] asm("_binary_index_html_start");
 extern const uint8_t index_html_end[] asm("_binary_index_html_end");
@@ -221,9 +228,33 @@ static esp_err_t gcode_upload_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "GCode validation successful: %d valid commands", valid_commands);
     gcode_parser_deinit(parser);
 
+    // Shorten travel between solder points
+    gcode_tour_result_t tour = {};
+    char* tour_buf = NULL;
+#if CONFIG_GCODE_TOUR_OPTIMIZE
+    // Estimate travel with the limits the moves will run at (tuned ones if stored)
+    motion_axis_limits_t limits;
+    motion_controller_get_limits(g_motion_controller, &limits);
+    gcode_tour_config_t tour_config = {
+        .max_velocity_x = limits.max_velocity[0],
+        .max_velocity_y = limits.max_velocity[1],
+        .max_acceleration = std::min(limits.max_acceleration[0], limits.max_acceleration[1]),
+        .start_x = 0.0,     // Execution starts from home
+        .start_y = 0.0,
+        .budget_ms = CONFIG_GCODE_TOUR_BUDGET_MS,
+    };
+    size_t tour_len = 0;
+    tour_buf = gcode_tour_optimize(gcode_content, gcode_len, &tour_config, &tour, &tour_len);
+    if (tour_buf) {
+        gcode_content = tour_buf;
+        gcode_len = tour_len;
+    }
+#endif
+
     // Acquire mutex before modifying global buffer (thread safety)
     if (!g_gcode_mutex || xSemaphoreTake(g_gcode_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to acquire GCode mutex (timeout or mutex not initialized)");
+        free(tour_buf);
         free(buf);
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Buffer locked - try again");
         return ESP_FAIL;
@@ -239,6 +270,7 @@ static esp_err_t gcode_upload_handler(httpd_req_t *req) {
     if (!g_gcode_buffer) {
         ESP_LOGE(TAG, "Failed to allocate RAM for GCode (%d bytes)", gcode_len);
         xSemaphoreGive(g_gcode_mutex);  // Release mutex before returning
+        free(tour_buf);
         free(buf);
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate RAM");
         return ESP_FAIL;
@@ -264,16 +296,22 @@ static esp_err_t gcode_upload_handler(httpd_req_t *req) {
     }
 
     // Send success response
-    char response_buf[256];
+    char response_buf[384];
     snprintf(response_buf, sizeof(response_buf),
              "{\"success\":true,\"message\":\"GCode uploaded and validated\","
-             "\"size\":%d,\"commands\":%d,\"event_posted\":%s}",
-             gcode_len, valid_commands, event_posted ? "true" : "false");
+             "\"size\":%d,\"commands\":%d,\"event_posted\":%s,"
+             "\"tour\":{\"points\":%lu,\"reordered\":%s,\"travel_before_s\":%.2f,"
+             "\"travel_after_s\":%.2f,\"travel_saved_s\":%.2f,\"optimize_ms\":%lu}}",
+             gcode_len, valid_commands, event_posted ? "true" : "false",
+             (unsigned long)tour.points, tour.reordered ? "true" : "false",
+             tour.travel_before_s, tour.travel_after_s,
+             tour.travel_before_s - tour.travel_after_s, (unsigned long)tour.elapsed_ms);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     httpd_resp_send(req, response_buf, strlen(response_buf));
 
+    free(tour_buf);
     free(buf);
     return ESP_OK;
 }
@@ -315,14 +353,34 @@ static esp_err_t motor_control_handler(httpd_req_t *req) {
 static esp_err_t motor_status_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Motor status request received");
 
-    // TODO: Get actual motor positions and status
-    const char* status_json = "{"
-        "\"x_pos\":0.0,"
-        "\"y_pos\":0.0,"
-        "\"z_pos\":0.0,"
-        "\"status\":\"idle\","
-        "\"temperature\":25.0"
-    "}";
+    position_t pos = motion_controller_get_position(g_motion_controller);
+    bool moving = motion_controller_is_moving(g_motion_controller);
+    bool homed = motion_controller_is_homed(g_motion_controller);
+
+    // Per-axis error of the last switch touch (job end check or pre-job verification)
+    char check_json[160] = "null";
+    motion_verify_result_t check;
+    if (motion_controller_get_last_verify(g_motion_controller, &check)) {
+        snprintf(check_json, sizeof(check_json),
+                 "{\"count\":%lu,\"age_s\":%lu,\"x_um\":%ld,\"y_um\":%ld,\"z_um\":%ld,"
+                 "\"tolerance_um\":%d}",
+                 (unsigned long)check.count, (unsigned long)(check.age_ms / 1000),
+                 (long)check.axis_error[0], (long)check.axis_error[1], (long)check.axis_error[2],
+                 CONFIG_MOTION_HOMING_TOLERANCE_UM);
+    }
+
+    motion_axis_limits_t limits;
+    motion_controller_get_limits(g_motion_controller, &limits);
+
+    char status_json[480];
+    snprintf(status_json, sizeof(status_json),
+             "{\"x_pos\":%.3f,\"y_pos\":%.3f,\"z_pos\":%.3f,"
+             "\"status\":\"%s\",\"homed\":%s,\"lost_steps\":%s,"
+             "\"limits\":{\"velocity\":[%.1f,%.1f,%.1f],\"acceleration\":[%.0f,%.0f,%.0f]}}",
+             coord_um_to_mm(pos.x), coord_um_to_mm(pos.y), coord_um_to_mm(pos.z),
+             moving ? "moving" : "idle", homed ? "true" : "false", check_json,
+             limits.max_velocity[0], limits.max_velocity[1], limits.max_velocity[2],
+             limits.max_acceleration[0], limits.max_acceleration[1], limits.max_acceleration[2]);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -331,6 +389,36 @@ static esp_err_t motor_status_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+/**
+ * @brief Handler for starting the speed and acceleration tuning
+ */
+static esp_err_t motor_tune_handler(httpd_req_t *req) {
+    ESP_LOGI(TAG, "Motor tuning request received");
+
+    web_server_handle_t server_handle = (web_server_handle_t)req->user_ctx;
+
+    // Accepted in IDLE only; progress shows in the log and in /api/motor/status
+    bool event_posted = false;
+    if (server_handle && server_handle->fsm_handle) {
+        if (fsm_controller_post_event(server_handle->fsm_handle, FSM_EVENT_REQUEST_TUNING)) {
+            ESP_LOGI(TAG, "Posted FSM_EVENT_REQUEST_TUNING to FSM controller");
+            event_posted = true;
+        } else {
+            ESP_LOGW(TAG, "Failed to post FSM_EVENT_REQUEST_TUNING");
+        }
+    }
+
+    const char* response = event_posted
+        ? "{\"success\":true,\"message\":\"Tuning requested\"}"
+        : "{\"success\":false,\"message\":\"Failed to request tuning\"}";
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send(req, response, strlen(response));
+
+    return ESP_OK;
+}
+
 /**
  * @brief Handler for starting G-Code execution
  */
@@ -581,6 +669,14 @@ web_server_handle_t web_server_init(const web_server_config_t* config, fsm_contr
     };
     httpd_register_uri_handler(handle->httpd_handle, &motor_status_uri);
 
+    httpd_uri_t motor_tune_uri = {
+        .uri = "/api/motor/tune",
+        .method = HTTP_POST,
+        .handler = motor_tune_handler,
+        .user_ctx = handle
+    };
+    httpd_register_uri_handler(handle->httpd_handle, &motor_tune_uri);
+
     // CORS preflight handler
     httpd_uri_t options_uri = {
         .uri = "/*",
@@ -622,6 +718,7 @@ web_server_handle_t web_server_init(const web_server_config_t* config, fsm_contr
     ESP_LOGI(TAG, "  POST /api/gcode/resume");
     ESP_LOGI(TAG, "  POST /api/motor/move");
     ESP_LOGI(TAG, "  GET  /api/motor/status");
+    ESP_LOGI(TAG, "  POST /api/motor/tune");
 
     return handle;
 }
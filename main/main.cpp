@@ -25,6 +25,7 @@
 #include "stepper_motor_hal.h"
 #include "StepperMotor.hpp"
 #include "execution_fsm.h"
+#include "motion_controller.h"
 #include "soldering_iron_hal.h"
 #include "temperature_sensor_hal.h"
 
@@ -36,6 +37,9 @@ StepperMotor* motor_y = nullptr;
 StepperMotor* motor_z = nullptr;
 StepperMotor* motor_s = nullptr;
 
+// Motion controller (per-axis speed and acceleration limits)
+motion_controller_handle_t g_motion_controller = nullptr;
+
 // Soldering iron and temperature sensor handles
 static soldering_iron_handle_t iron_handle = nullptr;
 static temperature_sensor_handle_t temp_sensor_handle = nullptr;
@@ -65,11 +69,12 @@ static void init_motors() {
         .enable_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_X_ENABLE_PIN),
         .endpoint_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_X_MIN_ENDPOINT_PIN)  // Changed from ENDPOINT to MIN_ENDPOINT
     };
-    motor_x = new StepperMotor(config_x, CONFIG_MOTOR_X_MICROSTEPS_IN_MM, STEPPER_DIR_COUNTERCLOCKWISE);
+    motor_x = new StepperMotor(config_x, motion_coord::steps_per_mm_x, STEPPER_DIR_COUNTERCLOCKWISE);
     if (!motor_x->isInitialized()) {
         ESP_LOGE(TAG, "Failed to initialize X-axis motor");
         return;
     }
+    motor_x->setBacklash(CONFIG_MOTOR_X_BACKLASH_UM);
     ESP_LOGI(TAG, "X-axis motor initialized");
 
     // Y-Axis Motor Configuration
@@ -79,11 +84,12 @@ static void init_motors() {
         .enable_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_Y_ENABLE_PIN),
         .endpoint_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_Y_MIN_ENDPOINT_PIN)  // Changed from ENDPOINT to MIN_ENDPOINT
     };
-    motor_y = new StepperMotor(config_y, CONFIG_MOTOR_Y_MICROSTEPS_IN_MM, STEPPER_DIR_CLOCKWISE);
+    motor_y = new StepperMotor(config_y, motion_coord::steps_per_mm_y, STEPPER_DIR_CLOCKWISE);
     if (!motor_y->isInitialized()) {
         ESP_LOGE(TAG, "Failed to initialize Y-axis motor");
         return;
     }
+    motor_y->setBacklash(CONFIG_MOTOR_Y_BACKLASH_UM);
     ESP_LOGI(TAG, "Y-axis motor initialized");
 
     // Z-Axis Motor Configuration
@@ -93,11 +99,12 @@ static void init_motors() {
         .enable_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_Z_ENABLE_PIN),
         .endpoint_pin = static_cast<gpio_num_t>(CONFIG_MOTOR_Z_MIN_ENDPOINT_PIN)  // Changed from ENDPOINT to MIN_ENDPOINT
     };
-    motor_z = new StepperMotor(config_z, CONFIG_MOTOR_Z_MICROSTEPS_IN_MM, STEPPER_DIR_CLOCKWISE);
+    motor_z = new StepperMotor(config_z, motion_coord::steps_per_mm_z, STEPPER_DIR_CLOCKWISE);
     if (!motor_z->isInitialized()) {
         ESP_LOGE(TAG, "Failed to initialize Z-axis motor");
         return;
     }
+    motor_z->setBacklash(CONFIG_MOTOR_Z_BACKLASH_UM);
     ESP_LOGI(TAG, "Z-axis motor initialized");
 
     // Solder Supply Motor Configuration
@@ -115,6 +122,70 @@ static void init_motors() {
     ESP_LOGI(TAG, "Solder supply motor initialized");
 }
 
+/**
+ * @brief Initialize motion controller and apply axis limits to the motors
+ */
+static void init_motion_controller() {
+    motion_controller_config_t motion_config = {
+        .max_velocity_x = CONFIG_MOTION_MAX_VELOCITY_X_MM_S,
+        .max_velocity_y = CONFIG_MOTION_MAX_VELOCITY_Y_MM_S,
+        .max_velocity_z = CONFIG_MOTION_MAX_VELOCITY_Z_MM_S,
+        .max_acceleration = CONFIG_MOTION_MAX_ACCELERATION_MM_S2,
+#if CONFIG_MOTION_S_CURVE_XY || CONFIG_MOTION_S_CURVE_Z
+        .max_jerk = CONFIG_MOTION_MAX_JERK_MM_S3,
+#else
+        .max_jerk = 0,
+#endif
+        .junction_deviation = CONFIG_MOTION_JUNCTION_DEVIATION_UM / 1000.0,
+#if CONFIG_MOTION_S_CURVE_XY
+        .profile_x = STEPPER_PROFILE_S_CURVE,
+        .profile_y = STEPPER_PROFILE_S_CURVE,
+#else
+        .profile_x = STEPPER_PROFILE_TRAPEZOID,
+        .profile_y = STEPPER_PROFILE_TRAPEZOID,
+#endif
+#if CONFIG_MOTION_S_CURVE_Z
+        .profile_z = STEPPER_PROFILE_S_CURVE,
+#else
+        .profile_z = STEPPER_PROFILE_TRAPEZOID,
+#endif
+        .steps_per_mm_x = motion_coord::steps_per_mm_x,
+        .steps_per_mm_y = motion_coord::steps_per_mm_y,
+        .steps_per_mm_z = motion_coord::steps_per_mm_z,
+        .work_area_x_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_X_MM),
+        .work_area_y_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_Y_MM),
+        .work_area_z_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_Z_MM),
+        .homing_seek_velocity = CONFIG_MOTION_HOMING_SEEK_MM_S,
+        .homing_locate_velocity = CONFIG_MOTION_HOMING_LOCATE_MM_S,
+        .homing_pull_off = COORD_UM_FROM_MM(CONFIG_MOTION_HOMING_PULL_OFF_MM),
+#if CONFIG_MOTION_SHAPER_ZV
+        .shaper = MOTION_SHAPER_ZV,
+#elif CONFIG_MOTION_SHAPER_ZVD
+        .shaper = MOTION_SHAPER_ZVD,
+#else
+        .shaper = MOTION_SHAPER_NONE,
+#endif
+#if CONFIG_MOTION_SHAPER_NONE
+        .shaper_frequency_x = 0,
+        .shaper_frequency_y = 0,
+        .shaper_damping_x = 0,
+        .shaper_damping_y = 0
+#else
+        .shaper_frequency_x = CONFIG_MOTION_SHAPER_FREQ_X_HZ,
+        .shaper_frequency_y = CONFIG_MOTION_SHAPER_FREQ_Y_HZ,
+        .shaper_damping_x = CONFIG_MOTION_SHAPER_DAMPING_X_PERCENT / 100.0,
+        .shaper_damping_y = CONFIG_MOTION_SHAPER_DAMPING_Y_PERCENT / 100.0
+#endif
+    };
+
+    g_motion_controller = motion_controller_init(&motion_config);
+    if (g_motion_controller == nullptr) {
+        ESP_LOGE(TAG, "Failed to initialize motion controller");
+        return;
+    }
+    ESP_LOGI(TAG, "Motion controller initialized");
+}
+
 /**
  * @brief Initialize soldering iron and temperature sensor
  */
@@ -194,32 +265,126 @@ static bool on_enter_idle(void* user_data) {
 
 static bool on_enter_calibration(void* user_data) {
     ESP_LOGI(TAG, "FSM: CALIBRATION");
+
+    // The job is about to move the axes, they are no longer parked
+    motion_controller_set_parked(g_motion_controller, false);
+
+    // Axes stay enabled after homing so they hold the zero
+    motor_x->setEnable(true);
+    motor_y->setEnable(true);
+    motor_z->setEnable(true);
+
+#if CONFIG_MOTION_REHOME_SKIP
+    if (motion_controller_is_homed(g_motion_controller)) {
+        ESP_LOGI(TAG, "Position trusted since last homing, skipping calibration");
+        fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
+        if (ctx) {
+            ctx->operation_complete = true;
+        }
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_SUCCESS);
+        return true;
+    }
+#endif
+
+#if CONFIG_MOTION_REHOME_VERIFY
+    bool started = motion_controller_is_homed(g_motion_controller)
+                       ? motion_controller_start_verify(g_motion_controller)
+                       : motion_controller_start_homing(g_motion_controller);
+#else
+    bool started = motion_controller_start_homing(g_motion_controller);
+#endif
+    if (!started) {
+        ESP_LOGE(TAG, "Failed to start homing");
+        fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
+        if (ctx) {
+            ctx->operation_complete = true;
+        }
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_ERROR);
+        return false;
+    }
     return true;
 }
 
 static bool on_execute_calibration(void* user_data) {
     fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
-    if (!ctx) return false;
+    if (!ctx || ctx->operation_complete) return false;
+
+    // X, Y and Z home together; every tick moves each axis on to its next phase
+    motion_homing_status_t status;
+    switch (motion_controller_poll_homing(g_motion_controller, &status)) {
+    case MOTION_HOMING_DONE:
+        ESP_LOGI(TAG, "Calibration complete in %lu ms (X %lu ms, Y %lu ms, Z %lu ms)",
+                 status.total_ms, status.axis_ms[0], status.axis_ms[1], status.axis_ms[2]);
+        for (int axis = 0; status.verify && axis < 3; axis++) {
+            if (std::abs(status.axis_error[axis]) > CONFIG_MOTION_HOMING_TOLERANCE_UM) {
+                ESP_LOGW(TAG, "%c was %.3f mm off since the last homing (lost steps)",
+                         "XYZ"[axis], coord_um_to_mm(status.axis_error[axis]));
+            }
+        }
+        ctx->operation_complete = true;
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_SUCCESS);
+        break;
+    case MOTION_HOMING_RUNNING:
+        break;
+    default:
+        ESP_LOGE(TAG, "Calibration failed after %lu ms", status.total_ms);
+        ctx->operation_complete = true;
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_ERROR);
+        break;
+    }
+
+    return true;
+}
 
-    if (ctx->iteration_count == 0) {
-        ESP_LOGI(TAG, "Calibrating X-axis");
-        motor_x->calibrate();
-        ctx->iteration_count = 1;
-    } else if (ctx->iteration_count == 1) {
-        ESP_LOGI(TAG, "Calibrating Y-axis");
-        motor_y->calibrate();
-        ctx->iteration_count = 2;
-    } else if (ctx->iteration_count == 2) {
-        ESP_LOGI(TAG, "Calibrating Z-axis");
-        motor_z->calibrate();
-        ctx->iteration_count = 3;
-    } else if (ctx->iteration_count == 3 && !ctx->operation_complete) {
-        uint32_t time_since_start = (esp_timer_get_time() / 1000) - ctx->start_time_ms;
-        if (time_since_start > 500) {
-            ESP_LOGI(TAG, "Calibration complete");
+static bool on_enter_tuning(void* user_data) {
+    ESP_LOGI(TAG, "FSM: TUNING");
+
+    motion_controller_set_parked(g_motion_controller, false);
+    motor_x->setEnable(true);
+    motor_y->setEnable(true);
+    motor_z->setEnable(true);
+
+    motion_tuning_config_t tuning = {
+        .travel = COORD_UM_FROM_MM(CONFIG_MOTION_TUNE_TRAVEL_MM),
+        .cycles = CONFIG_MOTION_TUNE_CYCLES,
+        .step = CONFIG_MOTION_TUNE_STEP_PERCENT / 100.0,
+        .max_rounds = CONFIG_MOTION_TUNE_MAX_ROUNDS,
+        .margin = CONFIG_MOTION_TUNE_MARGIN_PERCENT / 100.0,
+        .tolerance = CONFIG_MOTION_HOMING_TOLERANCE_UM
+    };
+    if (!motion_controller_start_tuning(g_motion_controller, &tuning)) {
+        ESP_LOGE(TAG, "Failed to start tuning");
+        fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
+        if (ctx) {
             ctx->operation_complete = true;
-            fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_SUCCESS);
         }
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_ERROR);
+        return false;
+    }
+    return true;
+}
+
+static bool on_execute_tuning(void* user_data) {
+    fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
+    if (!ctx || ctx->operation_complete) return false;
+
+    motion_tuning_status_t status;
+    switch (motion_controller_poll_tuning(g_motion_controller, &status)) {
+    case MOTION_TUNING_RUNNING:
+        break;
+    case MOTION_TUNING_DONE:
+        ESP_LOGI(TAG, "Tuning complete after %lu rounds in %lu s (X %.2fx, Y %.2fx, Z %.2fx)",
+                 status.round, status.total_ms / 1000, status.level[0], status.level[1], status.level[2]);
+        // Every round ends with the axes zeroed at their switches
+        motion_controller_set_parked(g_motion_controller, true);
+        ctx->operation_complete = true;
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_TUNING_DONE);
+        break;
+    default:
+        ESP_LOGE(TAG, "Tuning failed in round %lu", status.round);
+        ctx->operation_complete = true;
+        fsm_controller_post_event(fsm_handle, FSM_EVENT_CALIBRATION_ERROR);
+        break;
     }
 
     return true;
@@ -326,11 +491,16 @@ static bool on_enter_executing(void* user_data) {
     motor_s->setEnable(true);
 
     execution_config_t exec_config = {
-        .safe_z_height = motor_z->mm_to_microsteps(140),       // 140mm in steps
-        .soldering_z_height = motor_z->mm_to_microsteps(160),  // 160mm in steps
+        .safe_z_height = motor_z->um_to_microsteps(COORD_UM_FROM_MM(CONFIG_MOTION_SAFE_Z_MM)),
+        .soldering_z_height = motor_z->um_to_microsteps(COORD_UM_FROM_MM(CONFIG_MOTION_SOLDERING_Z_MM)),
+        .z_hop = motor_z->um_to_microsteps(COORD_UM_FROM_MM(CONFIG_MOTION_Z_HOP_MM)),
+        .z_clearance = motor_z->um_to_microsteps(COORD_UM_FROM_MM(CONFIG_MOTION_Z_CLEARANCE_MM)),
         .home_x = 0,
         .home_y = 0,
-        .home_z = 0
+        .home_z = 0,
+        .feed_pre_advance_pct = CONFIG_SOLDER_FEED_PRE_ADVANCE_PCT,
+        .feed_time_ms = CONFIG_SOLDER_FEED_TIME_MS,
+        .feed_retract = motor_s->um_to_microsteps(CONFIG_SOLDER_FEED_RETRACT_UM)
     };
 
     exec_sub_fsm_init(&exec_sub_fsm, &exec_config);
@@ -359,24 +529,35 @@ static bool on_enter_executing(void* user_data) {
 
 static bool on_execute_executing(void* user_data) {
     // Maintain temperature during execution
-    double current_temp = get_current_temperature();
-    if (current_temp > 0 && iron_handle) {
-        soldering_iron_hal_update_control(iron_handle, current_temp);
+    // MAX6675 requires minimum 220ms between readings for new conversion;
+    // the solder dwell needs fresh readings to see the tip recover
+    static uint32_t last_temp_read_time = 0;
+    uint32_t current_time = esp_timer_get_time() / 1000;
 
-        // Check for temperature errors during execution
+    if (current_time - last_temp_read_time >= 250 && iron_handle) {
+        double current_temp = get_current_temperature();
         double target_temp = soldering_iron_hal_get_target_temperature(iron_handle);
-        if (fabs(current_temp - target_temp) > 30.0) {  // Temperature drift > 30°C
-            ESP_LOGW(TAG, "Temperature drift detected: %.1f°C (target: %.1f°C)",
-                     current_temp, target_temp);
+        last_temp_read_time = current_time;
+
+        if (current_temp > 0) {
+            soldering_iron_hal_update_control(iron_handle, current_temp);
+
+            // Check for temperature errors during execution
+            if (fabs(current_temp - target_temp) > 30.0) {  // Temperature drift > 30°C
+                ESP_LOGW(TAG, "Temperature drift detected: %.1f°C (target: %.1f°C)",
+                         current_temp, target_temp);
+            }
         }
+        exec_sub_fsm_update_temperature(&exec_sub_fsm, current_temp, target_temp);
     }
 
     // Execute GCode line by line
     exec_sub_fsm_process_gcode(&exec_sub_fsm);
 
     if (exec_sub_fsm_get_state(&exec_sub_fsm) == EXEC_STATE_COMPLETE) {
-        ESP_LOGI(TAG, "GCode execution complete: %d commands executed",
-                 exec_sub_fsm_get_completed_count(&exec_sub_fsm));
+        ESP_LOGI(TAG, "GCode execution complete: %d commands executed, worst tick %lu us",
+                 exec_sub_fsm_get_completed_count(&exec_sub_fsm),
+                 exec_sub_fsm_get_max_tick_us(&exec_sub_fsm));
 
         // Cleanup GCode resources
         exec_sub_fsm_cleanup_gcode(&exec_sub_fsm);
@@ -387,6 +568,112 @@ static bool on_execute_executing(void* user_data) {
     return true;
 }
 
+static bool on_exit_executing(void* user_data) {
+    // Paused or failed mid-program: drop the queued moves and stop the axes,
+    // which may have been cut short at speed (the next job homes again)
+    if (exec_sub_fsm_get_state(&exec_sub_fsm) != EXEC_STATE_COMPLETE) {
+        ESP_LOGW(TAG, "Execution left before the end of the program, stopping motion");
+        motion_controller_emergency_stop(g_motion_controller);
+        motor_s->stop();
+    }
+
+    // on_enter_executing() starts over with a fresh parser
+    exec_sub_fsm_cleanup_gcode(&exec_sub_fsm);
+    return true;
+}
+
+// Set while the lost-step check at the end of a job is running
+static bool job_end_check_running = false;
+
+/**
+ * @brief Mark X, Y and Z parked if every one of them stands still at 0
+ *
+ * @return false if an axis is still moving or stopped elsewhere
+ */
+static bool park_axes_at_home() {
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    for (StepperMotor* motor : axes) {
+        if (motor->isMoving() || motor->getPosition() != 0) {
+            ESP_LOGW(TAG, "Axes not at 0 (X %ld, Y %ld, Z %ld steps), not parked",
+                     motor_x->getPosition(), motor_y->getPosition(), motor_z->getPosition());
+            return false;
+        }
+    }
+    motion_controller_set_parked(g_motion_controller, true);
+    return true;
+}
+
+// Set while X, Y and Z are being driven back to 0 at the end of a job
+static bool home_return_running = false;
+
+// Next axis return_to_home() drives back to 0 (X, Y, Z in turn)
+static int home_return_axis = 0;
+
+/**
+ * @brief Start the next axis towards 0 once the previous one has arrived
+ *
+ * Called from the NORMAL_EXIT tick so the FSM task never waits on a move;
+ * the axes are parked once all three are back.
+ */
+static void poll_return_to_home() {
+    StepperMotor* const axes[] = { motor_x, motor_y, motor_z };
+    for (StepperMotor* motor : axes) {
+        if (motor->isMoving()) {
+            return;
+        }
+    }
+
+    while (home_return_axis < 3) {
+        StepperMotor* motor = axes[home_return_axis++];
+        uint32_t steps = static_cast<uint32_t>(std::abs(motor->getPosition()));
+        if (steps > 0) {
+            motor->setTargetPosition(0);
+            motor->stepMultipleToTarget(steps);
+            return;
+        }
+    }
+
+    home_return_running = false;
+    if (park_axes_at_home()) {
+        ESP_LOGI(TAG, "Home position reached - Motors at (0, 0, 0)");
+    }
+}
+
+/**
+ * @brief Drive X, Y and Z back to 0 and leave them parked there
+ */
+static void return_to_home() {
+    ESP_LOGI(TAG, "Returning to home position (0, 0, 0)");
+    home_return_axis = 0;
+    home_return_running = true;
+    poll_return_to_home();
+}
+
+/**
+ * @brief Follow the lost-step check and report it once the switches are touched
+ */
+static void poll_job_end_check() {
+    motion_homing_status_t status;
+    switch (motion_controller_poll_homing(g_motion_controller, &status)) {
+    case MOTION_HOMING_RUNNING:
+        return;
+    case MOTION_HOMING_DONE:
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::abs(status.axis_error[axis]) > CONFIG_MOTION_HOMING_TOLERANCE_UM) {
+                ESP_LOGW(TAG, "%c lost %.3f mm during the job", "XYZ"[axis],
+                         coord_um_to_mm(status.axis_error[axis]));
+            }
+        }
+        ESP_LOGI(TAG, "Lost-step check done in %lu ms", status.total_ms);
+        park_axes_at_home();
+        break;
+    default:
+        ESP_LOGE(TAG, "Lost-step check failed, next job needs a full homing");
+        break;
+    }
+    job_end_check_running = false;
+}
+
 static bool on_enter_normal_exit(void* user_data) {
     ESP_LOGI(TAG, "FSM: NORMAL_EXIT - Returning to home and starting cooldown");
 
@@ -396,29 +683,21 @@ static bool on_enter_normal_exit(void* user_data) {
         ESP_LOGI(TAG, "Heater disabled - Starting cooldown");
     }
 
-    // Return all axes to home position (0, 0, 0) before disabling motors
-    ESP_LOGI(TAG, "Returning to home position (0, 0, 0)");
-    motor_x->setTargetPosition(0);
-    motor_y->setTargetPosition(0);
-    motor_z->setTargetPosition(0);
-
-    // Move all axes to home
-    uint32_t x_steps = static_cast<uint32_t>(std::abs(motor_x->getPosition()));
-    uint32_t y_steps = static_cast<uint32_t>(std::abs(motor_y->getPosition()));
-    uint32_t z_steps = static_cast<uint32_t>(std::abs(motor_z->getPosition()));
-
-    if (x_steps > 0) motor_x->stepMultipleToTarget(x_steps);
-    if (y_steps > 0) motor_y->stepMultipleToTarget(y_steps);
-    if (z_steps > 0) motor_z->stepMultipleToTarget(z_steps);
-
-    ESP_LOGI(TAG, "Home position reached - Motors at (0, 0, 0)");
-
-    // Now disable motors after reaching home
-    motor_x->setEnable(false);
-    motor_y->setEnable(false);
-    motor_z->setEnable(false);
+    // X, Y and Z keep holding so the next job can trust the homed position
     motor_s->setEnable(false);
 
+#if CONFIG_MOTION_JOB_END_CHECK
+    // Touch the switches from where the job ended instead of driving to 0:
+    // how far from 0 each one closes is what the job lost
+    job_end_check_running = motion_controller_start_verify(g_motion_controller);
+    if (!job_end_check_running) {
+        ESP_LOGW(TAG, "Lost-step check skipped");
+        return_to_home();
+    }
+#else
+    return_to_home();
+#endif
+
     fsm_execution_context_t* ctx = fsm_controller_get_execution_context(fsm_handle);
     if (ctx) {
         fsm_execution_context_init(ctx);
@@ -436,6 +715,13 @@ static bool on_execute_normal_exit(void* user_data) {
     const fsm_config_t* config = fsm_controller_get_config(fsm_handle);
     if (!config) return false;
 
+    if (job_end_check_running) {
+        poll_job_end_check();
+    }
+    if (home_return_running) {
+        poll_return_to_home();
+    }
+
     // MAX6675 requires minimum 220ms between readings for new conversion
     // Only read temperature every 250ms to ensure fresh data
     static uint32_t last_temp_read_time = 0;
@@ -471,7 +757,9 @@ static bool on_execute_normal_exit(void* user_data) {
     }
 
     // Check if cooled down to safe temperature
-    if (current_temp <= config->safe_temperature && !ctx->operation_complete) {
+    // The axes have to be done too before the machine counts as idle
+    if (current_temp <= config->safe_temperature && !ctx->operation_complete &&
+        !job_end_check_running && !home_return_running) {
         ESP_LOGI(TAG, "Cooldown complete - System safe at %.1f°C", current_temp);
         ctx->operation_complete = true;
         fsm_controller_post_event(fsm_handle, FSM_EVENT_COOLDOWN_COMPLETE);
@@ -502,12 +790,16 @@ static void init_fsm(void) {
     // Register callbacks
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_IDLE, on_enter_idle, nullptr);
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_CALIBRATION, on_enter_calibration, nullptr);
+    fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_TUNING, on_enter_tuning, nullptr);
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_READY, on_enter_ready, nullptr);
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_HEATING, on_enter_heating, nullptr);
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_EXECUTING, on_enter_executing, nullptr);
     fsm_controller_register_enter_callback(fsm_handle, FSM_STATE_NORMAL_EXIT, on_enter_normal_exit, nullptr);
 
+    fsm_controller_register_exit_callback(fsm_handle, FSM_STATE_EXECUTING, on_exit_executing, nullptr);
+
     fsm_controller_register_execute_callback(fsm_handle, FSM_STATE_CALIBRATION, on_execute_calibration, nullptr);
+    fsm_controller_register_execute_callback(fsm_handle, FSM_STATE_TUNING, on_execute_tuning, nullptr);
     fsm_controller_register_execute_callback(fsm_handle, FSM_STATE_HEATING, on_execute_heating, nullptr);
     fsm_controller_register_execute_callback(fsm_handle, FSM_STATE_EXECUTING, on_execute_executing, nullptr);
     fsm_controller_register_execute_callback(fsm_handle, FSM_STATE_NORMAL_EXIT, on_execute_normal_exit, nullptr);
@@ -585,6 +877,7 @@ extern "C" void app_main(void)
     }
 
     init_motors();
+    init_motion_controller();
     init_heating_system();
     init_fsm();
     init_webserver();
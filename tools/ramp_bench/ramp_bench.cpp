@@ -0,0 +1,153 @@
+/**
+ * @file ramp_bench.cpp
+ * @brief Host benchmark: step interval tables vs on-the-fly computation
+ *
+ * Generates the trapezoidal ramps the stepper HAL plans for the default
+ * Kconfig limits of each axis and times three ways of producing the
+ * per-step intervals:
+ *   - sqrt:  closed form sqrt(2/a) * (sqrt(n + 1) - sqrt(n)) every step
+ *   - recur: AVR446 recurrence (one integer division per step)
+ *   - table: compile-time table with fixed-point interpolation
+ * Each move is exactly long enough to accelerate to cruise speed and stop
+ * again, so every timed step is a ramp step. The error columns give the
+ * deviation of the total ramp time from the closed form.
+ *
+ * Host timings only rank the methods; absolute numbers on the ESP32 differ.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "stepper_ramp.h"
+#include "stepper_accel_table.hpp"
+
+// Kconfig defaults (main/Kconfig.projbuild)
+#define BENCH_PULSE_WIDTH_US 3
+#define BENCH_ACCELERATION_MM_S2 500
+#define BENCH_REPEATS 2000
+
+struct AxisSetup {
+    const char* name;
+    double steps_per_mm;
+    double velocity_mm_s;
+};
+
+static constexpr AxisSetup kAxes[] = {
+    {"X", 25, 100},
+    {"Y", 25, 100},
+    {"Z", 100, 25},
+};
+
+using stepper_table::AccelTable;
+using stepper_table::makeAccelTable;
+
+static constexpr AccelTable<STEPPER_ACCEL_TABLE_POINTS> kTables[] = {
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(BENCH_ACCELERATION_MM_S2 * 25.0, 100 * 25.0),
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(BENCH_ACCELERATION_MM_S2 * 25.0, 100 * 25.0),
+    makeAccelTable<STEPPER_ACCEL_TABLE_POINTS>(BENCH_ACCELERATION_MM_S2 * 100.0, 25 * 100.0),
+};
+
+// Keeps the optimizer from dropping the generated intervals
+static volatile uint64_t g_sink;
+
+/**
+ * @brief Closed-form interval of step i, the way a float implementation would do it
+ */
+static uint32_t sqrt_interval(const stepper_ramp_t* ramp, double acceleration, uint32_t i) {
+    double base = std::sqrt(2.0 / acceleration) * 1000000.0;
+    uint32_t n;
+    if (i < ramp->accel_steps) {
+        n = i;
+    } else if (i + ramp->decel_steps < ramp->total_steps) {
+        return ramp->cruise_interval >> STEPPER_RAMP_FRAC_BITS;
+    } else {
+        n = ramp->total_steps - 1 - i;
+    }
+    double c = (n == 0) ? 0.676 * base : base * (std::sqrt(n + 1.0) - std::sqrt((double)n));
+    uint32_t cruise = ramp->cruise_interval >> STEPPER_RAMP_FRAC_BITS;
+    return c < cruise ? cruise : (uint32_t)c;
+}
+
+template <typename F>
+static double time_ns_per_step(uint32_t steps, F&& generate) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        generate();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / ((double)steps * BENCH_REPEATS);
+}
+
+int main() {
+    std::printf("%-4s %7s %10s %10s %10s %12s %12s\n",
+                "axis", "steps", "sqrt ns", "recur ns", "table ns",
+                "recur err%", "table err%");
+
+    for (size_t a = 0; a < sizeof(kAxes) / sizeof(kAxes[0]); a++) {
+        const AxisSetup& axis = kAxes[a];
+        double acceleration = BENCH_ACCELERATION_MM_S2 * axis.steps_per_mm;
+        double velocity = axis.velocity_mm_s * axis.steps_per_mm;
+        uint32_t steps = 2 * (uint32_t)std::lround(velocity * velocity / (2.0 * acceleration));
+        stepper_accel_table_t view = kTables[a].view();
+
+        stepper_ramp_t recur;
+        stepper_ramp_t table;
+        stepper_ramp_plan(&recur, steps, BENCH_PULSE_WIDTH_US, velocity, acceleration, 0, 0, NULL);
+        stepper_ramp_plan(&table, steps, BENCH_PULSE_WIDTH_US, velocity, acceleration, 0, 0, &view);
+        if (table.table == NULL) {
+            std::printf("%-4s table does not cover the ramp\n", axis.name);
+            continue;
+        }
+
+        // Ramp duration against the closed form
+        double exact_us = 0.0;
+        double recur_us = 0.0;
+        double table_us = 0.0;
+        stepper_ramp_reset(&recur);
+        stepper_ramp_reset(&table);
+        for (uint32_t i = 0; i < steps; i++) {
+            exact_us += sqrt_interval(&recur, acceleration, i);
+            recur_us += stepper_ramp_interval_us(&recur);
+            table_us += stepper_ramp_interval_us(&table);
+            stepper_ramp_advance(&recur);
+            stepper_ramp_advance(&table);
+        }
+        double recur_err = (recur_us - exact_us) / exact_us;
+        double table_err = (table_us - exact_us) / exact_us;
+
+        double sqrt_ns = time_ns_per_step(steps, [&] {
+            uint64_t sum = 0;
+            for (uint32_t i = 0; i < steps; i++) {
+                sum += sqrt_interval(&recur, acceleration, i);
+            }
+            g_sink = sum;
+        });
+        double recur_ns = time_ns_per_step(steps, [&] {
+            uint64_t sum = 0;
+            stepper_ramp_reset(&recur);
+            for (uint32_t i = 0; i < steps; i++) {
+                sum += stepper_ramp_interval_us(&recur);
+                stepper_ramp_advance(&recur);
+            }
+            g_sink = sum;
+        });
+        double table_ns = time_ns_per_step(steps, [&] {
+            uint64_t sum = 0;
+            stepper_ramp_reset(&table);
+            for (uint32_t i = 0; i < steps; i++) {
+                sum += stepper_ramp_interval_us(&table);
+                stepper_ramp_advance(&table);
+            }
+            g_sink = sum;
+        });
+
+        std::printf("%-4s %7u %10.2f %10.2f %10.2f %12.2f %12.2f\n",
+                    axis.name, steps, sqrt_ns, recur_ns, table_ns,
+                    recur_err * 100.0, table_err * 100.0);
+    }
+
+    return 0;
+}
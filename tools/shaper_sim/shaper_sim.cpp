@@ -0,0 +1,202 @@
+/**
+ * @file shaper_sim.cpp
+ * @brief Host simulation: shaped vs unshaped moves on a ringing gantry
+ *
+ * Runs single rest-to-rest moves through motion_shaper_plan() with and
+ * without the shaper, the way the motion controller hands them to the step
+ * generator, and drives a damped spring-mass tip with the result. For each
+ * length and acceleration it prints the move time and the largest tip
+ * deviation from the target once the move has ended (residual vibration),
+ * so the acceleration the shaper buys can be read off without hardware:
+ * look for the highest shaped acceleration whose residual stays at or
+ * below the unshaped one at today's limit.
+ *
+ * The tip model is a single resonance at the shaper's own frequency and
+ * damping unless --tip-freq sets it apart, to see how a mistuned shaper
+ * holds up.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "motion_shaper.h"
+
+// Kconfig defaults (main/Kconfig.projbuild)
+#define SIM_VELOCITY_MM_S 100.0
+#define SIM_ACCELERATION_MM_S2 500.0
+
+#define SIM_DT_S 1e-5               // Integration step
+#define SIM_SETTLE_S 0.5            // Time after the move the residual is watched
+
+static constexpr double kLengths[] = { 2.0, 20.0 };
+static constexpr double kAccelerations[] = { 500.0, 1000.0, 2000.0, 4000.0, 8000.0 };
+
+struct Profile {
+    motion_shaper_piece_t pieces[MOTION_SHAPER_MAX_PIECES];
+    uint32_t count;
+    double duration;
+};
+
+struct Result {
+    double duration;                // s
+    double residual;                // mm
+};
+
+static void plan(Profile* profile, const motion_shaper_t* shaper, double length, double acceleration) {
+    profile->count = motion_shaper_plan(shaper, length, 0.0, SIM_VELOCITY_MM_S, 0.0, acceleration, profile->pieces);
+    profile->duration = 0.0;
+    for (uint32_t i = 0; i < profile->count; i++) {
+        profile->duration += profile->pieces[i].duration;
+    }
+}
+
+/**
+ * @brief Commanded position and speed at time t
+ */
+static void sample(const Profile* profile, double t, double* position, double* speed) {
+    double start = 0.0;
+    double travelled = 0.0;
+    for (uint32_t i = 0; i < profile->count; i++) {
+        const motion_shaper_piece_t& piece = profile->pieces[i];
+        if (t < start + piece.duration) {
+            double dt = t - start;
+            double accel = (piece.end_speed - piece.start_speed) / piece.duration;
+            *speed = piece.start_speed + accel * dt;
+            *position = travelled + piece.start_speed * dt + 0.5 * accel * dt * dt;
+            return;
+        }
+        travelled += 0.5 * (piece.start_speed + piece.end_speed) * piece.duration;
+        start += piece.duration;
+    }
+    *speed = 0.0;
+    *position = travelled;
+}
+
+/**
+ * @brief Drive the tip with the profile and measure the ringing after the move
+ */
+static Result simulate(const Profile* profile, double length, double frequency, double damping,
+                       FILE* csv, const char* label) {
+    double omega = 2.0 * M_PI * frequency;
+    double x = 0.0;
+    double v = 0.0;
+    Result result = { profile->duration, 0.0 };
+
+    uint32_t steps = static_cast<uint32_t>((profile->duration + SIM_SETTLE_S) / SIM_DT_S);
+    for (uint32_t i = 0; i <= steps; i++) {
+        double t = i * SIM_DT_S;
+        double command;
+        double command_speed;
+        sample(profile, t, &command, &command_speed);
+
+        // Base-excited spring-mass, semi-implicit Euler
+        double a = -omega * omega * (x - command) - 2.0 * damping * omega * (v - command_speed);
+        v += a * SIM_DT_S;
+        x += v * SIM_DT_S;
+
+        if (t >= profile->duration) {
+            result.residual = fmax(result.residual, fabs(x - length));
+        }
+        if (csv && i % 100 == 0) {
+            fprintf(csv, "%s,%.4f,%.6f,%.6f\n", label, t, command, x);
+        }
+    }
+    return result;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [--type zv|zvd] [--freq HZ] [--damping RATIO] [--tip-freq HZ] [--csv FILE]\n",
+            name);
+}
+
+int main(int argc, char** argv) {
+    motion_shaper_type_t type = MOTION_SHAPER_ZV;
+    double frequency = 40.0;
+    double damping = 0.1;
+    double tip_frequency = 0.0;
+    FILE* csv = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--type") == 0) {
+            const char* value = argv[++i];
+            if (strcmp(value, "zv") == 0) {
+                type = MOTION_SHAPER_ZV;
+            } else if (strcmp(value, "zvd") == 0) {
+                type = MOTION_SHAPER_ZVD;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--freq") == 0) {
+            frequency = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--damping") == 0) {
+            damping = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tip-freq") == 0) {
+            tip_frequency = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = fopen(argv[++i], "w");
+            if (csv == nullptr) {
+                perror(argv[i]);
+                return 1;
+            }
+            fprintf(csv, "move,time_s,command_mm,tip_mm\n");
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (frequency <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (tip_frequency <= 0.0) {
+        tip_frequency = frequency;
+    }
+
+    motion_shaper_t none;
+    motion_shaper_t shaper;
+    motion_shaper_init(&none, MOTION_SHAPER_NONE, 0.0, 0.0);
+    motion_shaper_init(&shaper, type, frequency, damping);
+
+    printf("shaper: %s at %.1f Hz, damping %.2f, %.1f ms long\n",
+           type == MOTION_SHAPER_ZV ? "ZV" : "ZVD", frequency, damping,
+           motion_shaper_duration(&shaper) * 1000.0);
+    for (uint32_t i = 0; i < shaper.count; i++) {
+        printf("  impulse %lu: %.4f at %.2f ms\n", (unsigned long)i, shaper.amplitude[i], shaper.time[i] * 1000.0);
+    }
+    printf("tip: %.1f Hz, damping %.2f; moves at %.0f mm/s\n\n", tip_frequency, damping, SIM_VELOCITY_MM_S);
+    printf("%8s %8s %12s %14s %12s %14s %8s\n",
+           "len mm", "acc", "plain ms", "plain ring um", "shaped ms", "shaped ring um", "pieces");
+
+    for (double length : kLengths) {
+        for (double acceleration : kAccelerations) {
+            Profile plain;
+            Profile shaped;
+            plan(&plain, &none, length, acceleration);
+            plan(&shaped, &shaper, length, acceleration);
+
+            char label[64];
+            snprintf(label, sizeof(label), "%.0fmm@%.0f plain", length, acceleration);
+            Result plain_result = simulate(&plain, length, tip_frequency, damping, csv, label);
+            snprintf(label, sizeof(label), "%.0fmm@%.0f shaped", length, acceleration);
+            Result shaped_result = simulate(&shaped, length, tip_frequency, damping, csv, label);
+
+            printf("%8.1f %8.0f %12.2f %14.2f %12.2f %14.2f %8lu%s\n", length, acceleration,
+                   plain_result.duration * 1000.0, plain_result.residual * 1000.0,
+                   shaped_result.duration * 1000.0, shaped_result.residual * 1000.0,
+                   (unsigned long)shaped.count,
+                   acceleration == SIM_ACCELERATION_MM_S2 ? "  <- default limit" : "");
+        }
+    }
+
+    if (csv) {
+        fclose(csv);
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+/**
+ * @file esp_attr.h
+ * @brief Host stand-in for the ESP-IDF placement attributes
+ */
+
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif // ESP_ATTR_H
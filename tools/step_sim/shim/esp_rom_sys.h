@@ -0,0 +1,21 @@
+/**
+ * @file esp_rom_sys.h
+ * @brief Host stand-in for the ROM busy-wait (advances virtual time)
+ */
+
+#ifndef ESP_ROM_SYS_H
+#define ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_rom_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_ROM_SYS_H
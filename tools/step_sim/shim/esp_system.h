@@ -0,0 +1,18 @@
+/**
+ * @file esp_system.h
+ * @brief Host stand-in for the ESP-IDF system API (reset reason)
+ */
+
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+typedef enum {
+    ESP_RST_POWERON,
+    ESP_RST_SW,
+} esp_reset_reason_t;
+
+static inline esp_reset_reason_t esp_reset_reason(void) {
+    return ESP_RST_POWERON;
+}
+
+#endif // ESP_SYSTEM_H
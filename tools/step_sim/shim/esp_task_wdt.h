@@ -0,0 +1,9 @@
+/**
+ * @file esp_task_wdt.h
+ * @brief Host stand-in for the task watchdog (no watchdog on the host)
+ */
+
+#ifndef ESP_TASK_WDT_H
+#define ESP_TASK_WDT_H
+
+#endif // ESP_TASK_WDT_H
@@ -0,0 +1,21 @@
+/**
+ * @file esp_timer.h
+ * @brief Host stand-in for the ESP-IDF microsecond clock (virtual time)
+ */
+
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_TIMER_H
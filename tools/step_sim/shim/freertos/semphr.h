@@ -0,0 +1,30 @@
+/**
+ * @file semphr.h
+ * @brief Host stand-in for FreeRTOS binary semaphores
+ *
+ * A blocking take runs the virtual timers until the semaphore is given or
+ * the timeout passes.
+ */
+
+#ifndef FREERTOS_SEMPHR_H
+#define FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_semaphore* SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* high_task_woken);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FREERTOS_SEMPHR_H
@@ -0,0 +1,22 @@
+/**
+ * @file task.h
+ * @brief Host stand-in for FreeRTOS task delays (advance virtual time)
+ */
+
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FREERTOS_TASK_H
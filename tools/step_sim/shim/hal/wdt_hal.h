@@ -0,0 +1,19 @@
+/**
+ * @file wdt_hal.h
+ * @brief Host stand-in for the RTC watchdog HAL (all no-ops)
+ */
+
+#ifndef WDT_HAL_H
+#define WDT_HAL_H
+
+typedef struct {
+    int unused;
+} wdt_hal_context_t;
+
+#define RWDT_HAL_CONTEXT_DEFAULT() { 0 }
+
+static inline void wdt_hal_write_protect_disable(wdt_hal_context_t* ctx) { (void)ctx; }
+static inline void wdt_hal_write_protect_enable(wdt_hal_context_t* ctx) { (void)ctx; }
+static inline void wdt_hal_feed(wdt_hal_context_t* ctx) { (void)ctx; }
+
+#endif // WDT_HAL_H
@@ -0,0 +1,54 @@
+/**
+ * @file nvs.h
+ * @brief Host stand-in for ESP-IDF NVS: nothing is ever stored
+ */
+
+#ifndef NVS_H
+#define NVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_NOT_FOUND   0x1102
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+static inline esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* handle) {
+    (void)name;
+    (void)mode;
+    (void)handle;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* value, size_t* length) {
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)length;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)length;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void)handle;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static inline void nvs_close(nvs_handle_t handle) {
+    (void)handle;
+}
+
+#endif // NVS_H
@@ -0,0 +1,55 @@
+/**
+ * @file sdkconfig.h
+ * @brief Kconfig defaults (main/Kconfig.projbuild) for the host simulator
+ *
+ * The step backend and the segment queue length come from the build
+ * (STEP_SIM_BACKEND, STEP_SIM_QUEUE_LEN); the RMT backend has no host model.
+ */
+
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#if !defined(CONFIG_STEPPER_BACKEND_MULTI_AXIS)
+#define CONFIG_STEPPER_BACKEND_GPTIMER 1
+#endif
+
+#define CONFIG_STEPPER_PULSE_WIDTH_US 3
+#if !defined(CONFIG_STEPPER_SEGMENT_QUEUE_LEN)
+#define CONFIG_STEPPER_SEGMENT_QUEUE_LEN 8
+#endif
+
+#define CONFIG_MOTOR_X_STEP_PIN 21
+#define CONFIG_MOTOR_X_DIR_PIN 12
+#define CONFIG_MOTOR_X_ENABLE_PIN 25
+#define CONFIG_MOTOR_X_MIN_ENDPOINT_PIN 34
+#define CONFIG_MOTOR_X_MICROSTEPS_IN_MM 25
+
+#define CONFIG_MOTOR_Y_STEP_PIN 22
+#define CONFIG_MOTOR_Y_DIR_PIN 13
+#define CONFIG_MOTOR_Y_ENABLE_PIN 26
+#define CONFIG_MOTOR_Y_MIN_ENDPOINT_PIN 35
+#define CONFIG_MOTOR_Y_MICROSTEPS_IN_MM 25
+
+#define CONFIG_MOTOR_Z_STEP_PIN 23
+#define CONFIG_MOTOR_Z_DIR_PIN 4
+#define CONFIG_MOTOR_Z_ENABLE_PIN 32
+#define CONFIG_MOTOR_Z_MIN_ENDPOINT_PIN 39
+#define CONFIG_MOTOR_Z_MICROSTEPS_IN_MM 100
+
+#define CONFIG_MOTION_MAX_VELOCITY_X_MM_S 100
+#define CONFIG_MOTION_MAX_VELOCITY_Y_MM_S 100
+#define CONFIG_MOTION_MAX_VELOCITY_Z_MM_S 25
+#define CONFIG_MOTION_MAX_ACCELERATION_MM_S2 500
+#define CONFIG_MOTION_S_CURVE_Z 1
+#define CONFIG_MOTION_MAX_JERK_MM_S3 10000
+#define CONFIG_MOTION_HOMING_SEEK_MM_S 30
+#define CONFIG_MOTION_HOMING_PULL_OFF_MM 2
+#define CONFIG_MOTION_HOMING_LOCATE_MM_S 2
+#define CONFIG_MOTION_HOMING_TOLERANCE_UM 100
+#define CONFIG_MOTION_LOOKAHEAD_DEPTH 8
+#define CONFIG_MOTION_JUNCTION_DEVIATION_UM 20
+#define CONFIG_MOTION_WORK_AREA_X_MM 200
+#define CONFIG_MOTION_WORK_AREA_Y_MM 200
+#define CONFIG_MOTION_WORK_AREA_Z_MM 180
+
+#endif // SDKCONFIG_H
@@ -0,0 +1,40 @@
+/**
+ * @file gpio_struct.h
+ * @brief Host stand-in for the GPIO register block
+ *
+ * The write-1-to-set/clear registers are plain memory here. The simulator
+ * applies and clears them after every alarm callback and before time
+ * advances, so one write per register between those points is captured
+ * (the multi-axis engine writes each register at most once per alarm).
+ */
+
+#ifndef SOC_GPIO_STRUCT_H
+#define SOC_GPIO_STRUCT_H
+
+#include <stdint.h>
+
+typedef union {
+    struct {
+        uint32_t data: 8;
+    };
+    uint32_t val;
+} gpio_out1_reg_t;
+
+typedef volatile struct {
+    uint32_t out_w1ts;
+    uint32_t out_w1tc;
+    gpio_out1_reg_t out1_w1ts;
+    gpio_out1_reg_t out1_w1tc;
+} gpio_dev_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern gpio_dev_t GPIO;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOC_GPIO_STRUCT_H
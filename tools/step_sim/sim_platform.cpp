@@ -0,0 +1,344 @@
+/**
+ * @file sim_platform.cpp
+ * @brief Virtual-time implementation of the GPIO, gptimer, FreeRTOS and ROM shims
+ */
+
+#include "sim_platform.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "soc/gpio_struct.h"
+
+#define SIM_GPIO_COUNT 40
+#define SIM_US_PER_TICK 1000
+
+// Alarm callbacks at a single instant beyond which the ISR is assumed stuck
+#define SIM_MAX_ALARMS_PER_INSTANT 100000
+
+struct gptimer_t {
+    bool enabled;
+    bool running;
+    uint64_t base_count;            // Count at base_time
+    uint64_t base_time;
+    bool armed;
+    uint64_t alarm_count;
+    gptimer_alarm_cb_t on_alarm;
+    void* user_ctx;
+};
+
+struct sim_semaphore {
+    bool given;
+};
+
+gpio_dev_t GPIO;
+
+static uint64_t s_now = 0;
+static uint64_t s_isr_count = 0;
+static int s_levels[SIM_GPIO_COUNT];
+static uint64_t s_output_mask = 0;
+static std::vector<sim::Edge> s_edges;
+static std::vector<gptimer_t*> s_timers;
+static std::function<int(int pin)> s_input_level;
+
+static void set_level(int pin, int level) {
+    if (pin < 0 || pin >= SIM_GPIO_COUNT || s_levels[pin] == level) {
+        return;
+    }
+    s_levels[pin] = level;
+    s_edges.push_back({s_now, pin, level});
+}
+
+/**
+ * @brief Apply pending write-1-to-set/clear register writes at the current time
+ */
+static void latch_registers() {
+    uint64_t clear = GPIO.out_w1tc | ((uint64_t)GPIO.out1_w1tc.val << 32);
+    uint64_t set = GPIO.out_w1ts | ((uint64_t)GPIO.out1_w1ts.val << 32);
+    GPIO.out_w1tc = 0;
+    GPIO.out1_w1tc.val = 0;
+    GPIO.out_w1ts = 0;
+    GPIO.out1_w1ts.val = 0;
+
+    for (int pin = 0; pin < SIM_GPIO_COUNT; pin++) {
+        if (clear & (1ULL << pin)) {
+            set_level(pin, 0);
+        }
+        if (set & (1ULL << pin)) {
+            set_level(pin, 1);
+        }
+    }
+}
+
+static uint64_t timer_count(const gptimer_t* timer) {
+    return timer->running ? timer->base_count + (s_now - timer->base_time) : timer->base_count;
+}
+
+static uint64_t alarm_time(const gptimer_t* timer) {
+    uint64_t ahead = timer->alarm_count > timer->base_count ? timer->alarm_count - timer->base_count : 0;
+    return std::max(s_now, timer->base_time + ahead);
+}
+
+/**
+ * @brief Fire the earliest alarm due no later than limit
+ *
+ * @return false if no alarm is due by then
+ */
+static bool fire_next_alarm(uint64_t limit) {
+    static uint64_t s_last_instant = UINT64_MAX;
+    static uint32_t s_instant_alarms = 0;
+
+    gptimer_t* due = nullptr;
+    uint64_t due_time = limit;
+    for (gptimer_t* timer : s_timers) {
+        if (!timer->running || !timer->armed || timer->on_alarm == nullptr) {
+            continue;
+        }
+        uint64_t at = alarm_time(timer);
+        if (at <= due_time) {
+            due = timer;
+            due_time = at;
+        }
+    }
+    if (due == nullptr) {
+        return false;
+    }
+
+    latch_registers();
+    s_now = due_time;
+
+    if (s_now == s_last_instant) {
+        if (++s_instant_alarms > SIM_MAX_ALARMS_PER_INSTANT) {
+            fprintf(stderr, "sim: alarm storm at %llu us, aborting\n", (unsigned long long)s_now);
+            abort();
+        }
+    } else {
+        s_last_instant = s_now;
+        s_instant_alarms = 0;
+    }
+
+    due->armed = false;
+    gptimer_alarm_event_data_t edata = {
+        .count_value = timer_count(due),
+        .alarm_value = due->alarm_count,
+    };
+    s_isr_count++;
+    due->on_alarm(due, &edata, due->user_ctx);
+    latch_registers();
+    return true;
+}
+
+namespace sim {
+
+uint64_t now() {
+    return s_now;
+}
+
+void runUntil(uint64_t time_us) {
+    while (fire_next_alarm(time_us)) {
+    }
+    latch_registers();
+    s_now = std::max(s_now, time_us);
+}
+
+const std::vector<Edge>& edges() {
+    latch_registers();
+    return s_edges;
+}
+
+void clearEdges() {
+    latch_registers();
+    s_edges.clear();
+}
+
+uint64_t isrCount() {
+    return s_isr_count;
+}
+
+void setInputLevel(std::function<int(int pin)> level) {
+    s_input_level = std::move(level);
+}
+
+} // namespace sim
+
+extern "C" {
+
+void sim_log(char level, const char* tag, const char* format, ...) {
+    fprintf(stderr, "[%10.6f] %c %s: ", s_now / 1e6, level, tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)s_now;
+}
+
+void esp_rom_delay_us(uint32_t us) {
+    sim::runUntil(s_now + us);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim::runUntil(s_now + (uint64_t)ticks * SIM_US_PER_TICK);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(s_now / SIM_US_PER_TICK);
+}
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+    if (config->mode == GPIO_MODE_OUTPUT) {
+        s_output_mask |= config->pin_bit_mask;
+    } else {
+        s_output_mask &= ~config->pin_bit_mask;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin) {
+    (void)pin;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+    latch_registers();
+    set_level(pin, level ? 1 : 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin) {
+    if (pin < 0 || pin >= SIM_GPIO_COUNT) {
+        return 0;
+    }
+    if (s_output_mask & (1ULL << pin)) {
+        return s_levels[pin];
+    }
+    // Inputs are endpoint switches (active low), open unless a scenario says otherwise
+    return s_input_level ? s_input_level(pin) : 1;
+}
+
+esp_err_t gptimer_new_timer(const gptimer_config_t* config, gptimer_handle_t* ret_timer) {
+    if (config->resolution_hz != 1000000) {
+        // One count per virtual microsecond only
+        return ESP_ERR_INVALID_ARG;
+    }
+    gptimer_t* timer = new gptimer_t();
+    s_timers.push_back(timer);
+    *ret_timer = timer;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t timer) {
+    s_timers.erase(std::remove(s_timers.begin(), s_timers.end(), timer), s_timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_register_event_callbacks(gptimer_handle_t timer, const gptimer_event_callbacks_t* cbs,
+                                           void* user_data) {
+    timer->on_alarm = cbs->on_alarm;
+    timer->user_ctx = user_data;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_set_alarm_action(gptimer_handle_t timer, const gptimer_alarm_config_t* config) {
+    if (config == nullptr) {
+        timer->armed = false;
+        return ESP_OK;
+    }
+    timer->alarm_count = config->alarm_count;
+    timer->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t timer) {
+    timer->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t timer) {
+    timer->enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t timer) {
+    if (!timer->enabled || timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->base_time = s_now;
+    timer->running = true;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t timer) {
+    if (!timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->base_count = timer_count(timer);
+    timer->base_time = s_now;
+    timer->running = false;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value) {
+    timer->base_count = value;
+    timer->base_time = s_now;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_get_raw_count(gptimer_handle_t timer, uint64_t* value) {
+    *value = timer_count(timer);
+    return ESP_OK;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return new sim_semaphore();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    uint64_t deadline = (ticks == portMAX_DELAY) ? UINT64_MAX : s_now + (uint64_t)ticks * SIM_US_PER_TICK;
+    while (!sem->given) {
+        if (!fire_next_alarm(deadline)) {
+            // Nothing left that could give it
+            latch_registers();
+            if (deadline != UINT64_MAX) {
+                s_now = deadline;
+            }
+            return pdFALSE;
+        }
+    }
+    sem->given = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (sem->given) {
+        return pdFALSE;
+    }
+    sem->given = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* high_task_woken) {
+    if (high_task_woken != nullptr) {
+        *high_task_woken = pdTRUE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+} // extern "C"
@@ -0,0 +1,57 @@
+/**
+ * @file sim_platform.h
+ * @brief Virtual-time platform behind the host shims
+ *
+ * Time only moves when the code under test waits (busy-wait, task delay,
+ * blocking semaphore take) or when the simulator asks for it. While it
+ * moves, every armed timer alarm fires in time order and calls its ISR.
+ * Output level changes are recorded with the virtual time they happen at.
+ */
+
+#ifndef SIM_PLATFORM_H
+#define SIM_PLATFORM_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sim {
+
+struct Edge {
+    uint64_t time_us;
+    int pin;
+    int level;
+};
+
+/**
+ * @brief Current virtual time
+ */
+uint64_t now();
+
+/**
+ * @brief Fire every alarm due up to time_us, then move the clock there
+ */
+void runUntil(uint64_t time_us);
+
+/**
+ * @brief Output edges recorded since the last clearEdges()
+ */
+const std::vector<Edge>& edges();
+
+void clearEdges();
+
+/**
+ * @brief Number of alarm callbacks run so far
+ */
+uint64_t isrCount();
+
+/**
+ * @brief Level read from input pins (endpoint switches)
+ *
+ * Without a function every input reads 1, an open active-low switch.
+ */
+void setInputLevel(std::function<int(int pin)> level);
+
+} // namespace sim
+
+#endif // SIM_PLATFORM_H
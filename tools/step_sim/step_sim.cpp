@@ -0,0 +1,599 @@
+/**
+ * @file step_sim.cpp
+ * @brief Host step-timing simulator and benchmark for the stepper HAL
+ *
+ * Builds stepper_motor_hal.c, the selected step engine and StepperMotor.cpp
+ * against virtual-time shims (see sim_platform.h), runs a fixed set of
+ * reference moves with the Kconfig default limits and reports, per axis:
+ *   - total move time (start call to the last falling STEP edge)
+ *   - STEP high time (pulse width) and rising-to-rising interval statistics
+ *   - shortest DIR-to-STEP setup time
+ *   - achieved step rate over the move, in STEP_SIM_RATE_BINS time slices
+ *
+ * The homing run closes a simulated endpoint switch at a set distance and
+ * checks that seeks stop on it.
+ *
+ * The planner run feeds a G0 chain through the motion controller once per
+ * FSM tick, as the execution FSM does, and reports the longest tick. Virtual
+ * time only passes inside a tick while the controller waits, so anything
+ * above 0 us is time the FSM task would have been stalled.
+ *
+ * With --csv FILE every step is also written as move,axis,time_us,rate_hz
+ * so rate curves can be plotted and compared between profile changes.
+ *
+ * Virtual time has no ISR latency: the numbers show what the profile and
+ * engine logic ask for, not jitter on the ESP32.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sdkconfig.h"
+#include "StepperMotor.hpp"
+#include "motion_controller.h"
+#include "freertos/task.h"
+#include "sim_platform.h"
+
+#define STEP_SIM_RATE_BINS 10
+#define STEP_SIM_TIMEOUT_MS 120000
+#define STEP_SIM_FSM_TICK_MS 100    // fsm_task period in main.cpp
+
+// Axes the motion controller drives (defined in main.cpp on the target)
+StepperMotor* motor_x = nullptr;
+StepperMotor* motor_y = nullptr;
+StepperMotor* motor_z = nullptr;
+
+struct Axis {
+    const char* name;
+    StepperMotor* motor;
+    gpio_num_t step_pin;
+    gpio_num_t dir_pin;
+};
+
+struct Stats {
+    uint32_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double sum = 0.0;
+
+    void add(double value) {
+        min = (count == 0) ? value : std::min(min, value);
+        max = (count == 0) ? value : std::max(max, value);
+        sum += value;
+        count++;
+    }
+
+    double mean() const { return count ? sum / count : 0.0; }
+};
+
+static std::vector<Axis> s_axes;
+static FILE* s_csv = nullptr;
+static std::string s_note;          // Extra report line of the current move
+
+static StepperMotor* make_motor(int step, int dir, int enable, int endpoint, uint32_t steps_per_mm,
+                                stepper_direction_t positive, double velocity_mm_s) {
+    stepper_motor_config_t config = {
+        .step_pin = static_cast<gpio_num_t>(step),
+        .dir_pin = static_cast<gpio_num_t>(dir),
+        .enable_pin = static_cast<gpio_num_t>(enable),
+        .endpoint_pin = static_cast<gpio_num_t>(endpoint),
+    };
+    StepperMotor* motor = new StepperMotor(config, steps_per_mm, positive);
+    motor->setMotionLimits(velocity_mm_s, CONFIG_MOTION_MAX_ACCELERATION_MM_S2);
+    motor->setEnable(true);
+    return motor;
+}
+
+static void init_axes() {
+    StepperMotor* x = make_motor(CONFIG_MOTOR_X_STEP_PIN, CONFIG_MOTOR_X_DIR_PIN, CONFIG_MOTOR_X_ENABLE_PIN,
+                                 CONFIG_MOTOR_X_MIN_ENDPOINT_PIN, CONFIG_MOTOR_X_MICROSTEPS_IN_MM,
+                                 STEPPER_DIR_COUNTERCLOCKWISE, CONFIG_MOTION_MAX_VELOCITY_X_MM_S);
+    StepperMotor* y = make_motor(CONFIG_MOTOR_Y_STEP_PIN, CONFIG_MOTOR_Y_DIR_PIN, CONFIG_MOTOR_Y_ENABLE_PIN,
+                                 CONFIG_MOTOR_Y_MIN_ENDPOINT_PIN, CONFIG_MOTOR_Y_MICROSTEPS_IN_MM,
+                                 STEPPER_DIR_CLOCKWISE, CONFIG_MOTION_MAX_VELOCITY_Y_MM_S);
+    StepperMotor* z = make_motor(CONFIG_MOTOR_Z_STEP_PIN, CONFIG_MOTOR_Z_DIR_PIN, CONFIG_MOTOR_Z_ENABLE_PIN,
+                                 CONFIG_MOTOR_Z_MIN_ENDPOINT_PIN, CONFIG_MOTOR_Z_MICROSTEPS_IN_MM,
+                                 STEPPER_DIR_CLOCKWISE, CONFIG_MOTION_MAX_VELOCITY_Z_MM_S);
+#if CONFIG_MOTION_S_CURVE_Z
+    z->setMotionProfile(STEPPER_PROFILE_S_CURVE, CONFIG_MOTION_MAX_JERK_MM_S3);
+#endif
+
+    s_axes = {
+        {"X", x, static_cast<gpio_num_t>(CONFIG_MOTOR_X_STEP_PIN), static_cast<gpio_num_t>(CONFIG_MOTOR_X_DIR_PIN)},
+        {"Y", y, static_cast<gpio_num_t>(CONFIG_MOTOR_Y_STEP_PIN), static_cast<gpio_num_t>(CONFIG_MOTOR_Y_DIR_PIN)},
+        {"Z", z, static_cast<gpio_num_t>(CONFIG_MOTOR_Z_STEP_PIN), static_cast<gpio_num_t>(CONFIG_MOTOR_Z_DIR_PIN)},
+    };
+}
+
+static void wait_all() {
+    for (const Axis& axis : s_axes) {
+        axis.motor->waitForMove(STEP_SIM_TIMEOUT_MS);
+    }
+}
+
+/**
+ * @brief Linear move of the given axes to absolute step positions
+ */
+static void move_linear(std::initializer_list<std::pair<int, int32_t>> targets) {
+    StepperMotor* motors[3];
+    size_t n = 0;
+    for (const auto& [index, position] : targets) {
+        s_axes[index].motor->setTargetPosition(position);
+        motors[n++] = s_axes[index].motor;
+    }
+    StepperMotor::stepLinearToTarget(motors, n);
+    wait_all();
+}
+
+/**
+ * @brief Stream X segments that blend at the given junction speed (mm/s)
+ */
+static void move_chain(int32_t segment_steps, int segments, double junction_mm_s) {
+    StepperMotor* x = s_axes[0].motor;
+    double scale = CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+    int32_t position = x->getPosition();
+    stepper_queue_stats_t before = x->getQueueStats();
+
+    x->beginQueue();
+    for (int i = 0; i < segments; i++) {
+        stepper_motor_segment_t profile = {};
+        profile.max_velocity = CONFIG_MOTION_MAX_VELOCITY_X_MM_S * scale;
+        profile.acceleration = CONFIG_MOTION_MAX_ACCELERATION_MM_S2 * scale;
+        profile.entry_velocity = (i == 0) ? 0.0 : junction_mm_s * scale;
+        profile.exit_velocity = (i == segments - 1) ? 0.0 : junction_mm_s * scale;
+        position += segment_steps;
+        x->queueSegmentTo(position, profile, STEP_SIM_TIMEOUT_MS);
+    }
+    x->endQueue();
+    x->waitForMove(STEP_SIM_TIMEOUT_MS);
+
+    stepper_queue_stats_t stats = x->getQueueStats();
+    char note[96];
+    snprintf(note, sizeof(note), "queue: max depth %lu/%lu, underruns %lu, segments %lu",
+             (unsigned long)stats.max_depth, (unsigned long)stats.capacity,
+             (unsigned long)(stats.underruns - before.underruns),
+             (unsigned long)(stats.segments_done - before.segments_done));
+    s_note = note;
+}
+
+/**
+ * @brief Queued single-axis move, checked against StepperMotor::moveTimeUs()
+ *
+ * The motion controller times Z lifts and approaches from the predicted
+ * ramp, so the prediction has to match the steps that actually go out.
+ */
+static void move_queued_timed(int index, int32_t position) {
+    const Axis& axis = s_axes[index];
+    uint32_t steps = static_cast<uint32_t>(std::abs(position - axis.motor->getPosition()));
+    uint32_t half_us = axis.motor->moveTimeUs(steps, steps / 2);
+
+    axis.motor->setTargetPosition(position);
+    axis.motor->queueMoveTo(position, STEP_SIM_TIMEOUT_MS);
+    axis.motor->waitForMove(STEP_SIM_TIMEOUT_MS);
+
+    std::vector<uint64_t> rising;
+    for (const sim::Edge& edge : sim::edges()) {
+        if (edge.pin == axis.step_pin && edge.level) {
+            rising.push_back(edge.time_us);
+        }
+    }
+    if (rising.size() <= steps / 2) {
+        return;
+    }
+
+    char note[96];
+    snprintf(note, sizeof(note), "predicted %lu us to step %lu, simulated %llu us",
+             (unsigned long)half_us, (unsigned long)(steps / 2),
+             (unsigned long long)(rising[steps / 2] - rising[0]));
+    s_note = note;
+}
+
+/**
+ * @brief Individual steps through the busy-wait path (StepperMotor::step)
+ */
+static void move_single_steps(uint32_t steps) {
+    StepperMotor* x = s_axes[0].motor;
+    x->setDirection(STEPPER_DIR_COUNTERCLOCKWISE);
+    for (uint32_t i = 0; i < steps; i++) {
+        x->step();
+    }
+}
+
+/**
+ * @brief Two-phase homing of X against a simulated switch
+ *
+ * The switch closes once X has travelled switch_steps towards it: a fast
+ * seek, the pull-off and a slow locate, as the motion controller runs
+ * them. Reports how far each approach went past the switch; the step ISR
+ * checks it before every pulse, so both should stop right on it.
+ */
+static void move_home(int32_t switch_steps) {
+    const Axis& axis = s_axes[0];
+    StepperMotor* x = axis.motor;
+    const int32_t x_mm = CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+
+    // X counts up counter-clockwise (DIR high), so it homes with DIR low
+    int start_dir = gpio_get_level(axis.dir_pin);
+    auto travel = [&axis, start_dir] {
+        int32_t steps = 0;
+        int dir = start_dir;
+        for (const sim::Edge& edge : sim::edges()) {
+            if (edge.pin == axis.dir_pin) {
+                dir = edge.level;
+            } else if (edge.pin == axis.step_pin && edge.level) {
+                steps += dir ? -1 : 1;
+            }
+        }
+        return steps;
+    };
+    sim::setInputLevel([&](int pin) {
+        return (pin == CONFIG_MOTOR_X_MIN_ENDPOINT_PIN && travel() >= switch_steps) ? 0 : 1;
+    });
+
+    x->startHoming(CONFIG_MOTION_HOMING_SEEK_MM_S, 2 * switch_steps);
+    x->waitForMove(STEP_SIM_TIMEOUT_MS);
+    int32_t seek_over = travel() - switch_steps;
+
+    const int32_t pull_off = CONFIG_MOTION_HOMING_PULL_OFF_MM * x_mm;
+    x->setTargetPosition(pull_off);
+    x->stepMultipleToTarget(pull_off);
+    x->waitForMove(STEP_SIM_TIMEOUT_MS);
+
+    x->startHoming(CONFIG_MOTION_HOMING_LOCATE_MM_S, 2 * pull_off);
+    x->waitForMove(STEP_SIM_TIMEOUT_MS);
+    int32_t locate_over = travel() - switch_steps;
+    bool closed = x->isEndpointReached();
+    x->resetPosition();
+    sim::setInputLevel(nullptr);
+
+    char note[96];
+    snprintf(note, sizeof(note), "past the switch: seek %ld, locate %ld steps, switch %s",
+             (long)seek_over, (long)locate_over, closed ? "closed" : "OPEN");
+    s_note = note;
+}
+
+/**
+ * @brief X out and back with backlash compensation on
+ *
+ * The return reverses direction, so it should carry exactly the play in
+ * extra steps while the position still ends on 0.
+ */
+static void move_backlash(coord_um_t backlash_um, int32_t out_steps) {
+    const Axis& axis = s_axes[0];
+    StepperMotor* x = axis.motor;
+    x->setBacklash(backlash_um);
+
+    move_linear({{0, out_steps}});
+    size_t out_edges = sim::edges().size();
+    move_linear({{0, 0}});
+    int32_t back_steps = 0;
+    for (size_t i = out_edges; i < sim::edges().size(); i++) {
+        const sim::Edge& edge = sim::edges()[i];
+        if (edge.pin == axis.step_pin && edge.level) {
+            back_steps++;
+        }
+    }
+    x->setBacklash(0);
+
+    char note[96];
+    snprintf(note, sizeof(note), "return took %ld extra steps (play %ld), position %ld",
+             (long)(back_steps - out_steps), (long)x->um_to_microsteps(backlash_um), (long)x->getPosition());
+    s_note = note;
+}
+
+/**
+ * @brief G0 moves fed to the planner one FSM tick at a time
+ *
+ * Every tick queues moves while motion_controller_can_queue() allows, then
+ * hands over what it can with motion_controller_try_flush() once the chain
+ * is in, like the execution FSM's TRAVEL and FINISH_TRAVEL steps.
+ *
+ * @param target XY of move i in mm, Z stays where it is
+ */
+static void move_planner_chain(motion_controller_handle_t controller, int moves,
+                               const std::function<std::pair<double, double>(int)>& target) {
+    uint64_t worst_tick = 0;
+    uint32_t ticks = 0;
+    motor_x->resetQueueStats();
+
+    coord_um_t z = motion_controller_get_position(controller).z;
+    int queued = 0;
+    while (true) {
+        uint64_t tick_start = sim::now();
+        while (queued < moves && motion_controller_can_queue(controller)) {
+            auto [x_mm, y_mm] = target(queued);
+            position_t position = {
+                static_cast<coord_um_t>(lround(x_mm * COORD_UM_PER_MM)),
+                static_cast<coord_um_t>(lround(y_mm * COORD_UM_PER_MM)),
+                z,
+            };
+            motion_controller_queue_move(controller, &position);
+            queued++;
+        }
+        bool done = queued == moves && motion_controller_try_flush(controller) &&
+                    !motion_controller_is_moving(controller);
+        worst_tick = std::max(worst_tick, sim::now() - tick_start);
+        ticks++;
+        if (done) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(STEP_SIM_FSM_TICK_MS));
+    }
+
+    stepper_queue_stats_t stats = motor_x->getQueueStats();
+    char note[128];
+    snprintf(note, sizeof(note), "worst tick %llu us over %lu ticks, X queue max depth %lu/%lu, underruns %lu, "
+             "abrupt stop X %d Y %d", (unsigned long long)worst_tick, (unsigned long)ticks,
+             (unsigned long)stats.max_depth, (unsigned long)stats.capacity, (unsigned long)stats.underruns,
+             motor_x->stoppedAbruptly(), motor_y->stoppedAbruptly());
+    s_note = note;
+}
+
+/**
+ * @brief Direct Z move right after a planner stream, like the descent to a joint
+ *
+ * Ramps down to rest, so it must not read as an abrupt stop (which would
+ * make the joint wait the settle time).
+ */
+static void move_after_stream(int32_t steps) {
+    move_linear({{2, motor_z->getPosition() + steps}});
+    s_note = motor_z->stoppedAbruptly() ? "Z stopped abruptly" : "Z ramped down to rest";
+}
+
+/**
+ * @brief Diagonal zigzag through the planner with play in X
+ *
+ * X reverses at every corner while Y keeps going, and both axes have the
+ * same share of every move. X's take-up has to run on its own with Y
+ * holding, so the two still finish the last move on the same step.
+ */
+static void move_planner_zigzag(motion_controller_handle_t controller, int moves, double step_mm,
+                                coord_um_t backlash_um) {
+    double x0 = double(motor_x->getPosition()) / CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+    double y0 = double(motor_y->getPosition()) / CONFIG_MOTOR_Y_MICROSTEPS_IN_MM;
+    motor_x->setBacklash(backlash_um);
+    move_planner_chain(controller, moves, [&](int i) {
+        return std::make_pair(x0 + step_mm * (i % 2 == 0 ? 1 : 0), y0 + step_mm * (i + 1));
+    });
+    motor_x->setBacklash(0);
+
+    uint64_t last[2] = {};
+    for (const sim::Edge& edge : sim::edges()) {
+        for (int a = 0; a < 2; a++) {
+            if (edge.pin == s_axes[a].step_pin && edge.level) {
+                last[a] = edge.time_us;
+            }
+        }
+    }
+    char note[96];
+    snprintf(note, sizeof(note), "; last X step %+lld us from the last Y step",
+             (long long)last[0] - (long long)last[1]);
+    s_note += note;
+}
+
+static void report_axis(const char* move, const Axis& axis, uint64_t start_us, uint64_t end_us) {
+    std::vector<uint64_t> rising;
+    Stats high;
+    Stats interval;
+    Stats dir_setup;
+    uint64_t last_dir = UINT64_MAX;
+
+    for (const sim::Edge& edge : sim::edges()) {
+        if (edge.pin == axis.dir_pin) {
+            last_dir = edge.time_us;
+        } else if (edge.pin == axis.step_pin && edge.level == 1) {
+            if (!rising.empty()) {
+                interval.add(double(edge.time_us - rising.back()));
+            }
+            if (last_dir != UINT64_MAX) {
+                dir_setup.add(double(edge.time_us - last_dir));
+                last_dir = UINT64_MAX;
+            }
+            rising.push_back(edge.time_us);
+        } else if (edge.pin == axis.step_pin && !rising.empty()) {
+            high.add(double(edge.time_us - rising.back()));
+        }
+    }
+
+    if (rising.empty()) {
+        return;
+    }
+
+    printf("  %s %6zu steps  high %4.1f/%4.1f/%4.1f us  interval %7.1f/%8.1f/%9.1f us  "
+           "peak %6.0f steps/s",
+           axis.name, rising.size(), high.min, high.mean(), high.max,
+           interval.min, interval.mean(), interval.max,
+           interval.count ? 1e6 / interval.min : 0.0);
+    if (dir_setup.count) {
+        printf("  dir setup %.0f us", dir_setup.min);
+    }
+    printf("\n");
+
+    // Achieved rate per time slice of the whole move
+    double span = double(end_us - start_us);
+    uint32_t bins[STEP_SIM_RATE_BINS] = {};
+    for (uint64_t t : rising) {
+        size_t bin = std::min<size_t>(STEP_SIM_RATE_BINS - 1, size_t((t - start_us) / span * STEP_SIM_RATE_BINS));
+        bins[bin]++;
+    }
+    printf("    rate [steps/s]:");
+    for (uint32_t count : bins) {
+        printf(" %6.0f", count / (span / STEP_SIM_RATE_BINS / 1e6));
+    }
+    printf("\n");
+
+    if (s_csv) {
+        for (size_t i = 1; i < rising.size(); i++) {
+            fprintf(s_csv, "%s,%s,%llu,%.1f\n", move, axis.name,
+                    (unsigned long long)(rising[i] - start_us), 1e6 / double(rising[i] - rising[i - 1]));
+        }
+    }
+}
+
+/**
+ * @brief Run and report one move
+ *
+ * @return Time from the start to the last edge in ms
+ */
+static double run(const char* name, const std::function<void()>& move) {
+    // Settle between moves so one move's tail never shows up in the next
+    sim::runUntil(sim::now() + 10000);
+    sim::clearEdges();
+    s_note.clear();
+
+    uint64_t isr_before = sim::isrCount();
+    uint64_t start = sim::now();
+    move();
+
+    uint64_t end = start;
+    for (const sim::Edge& edge : sim::edges()) {
+        end = std::max(end, edge.time_us);
+    }
+
+    printf("%-32s %10.3f ms  %8llu ISRs\n", name, (end - start) / 1000.0,
+           (unsigned long long)(sim::isrCount() - isr_before));
+    for (const Axis& axis : s_axes) {
+        report_axis(name, axis, start, std::max(end, start + 1));
+    }
+    if (!s_note.empty()) {
+        printf("  %s\n", s_note.c_str());
+    }
+    return (end - start) / 1000.0;
+}
+
+/**
+ * @brief Planner moves run plain and then shaped, from the same XY start
+ *
+ * Each run gets its own controller; the shaper of @p config is what the
+ * second one shapes with. Prints both times.
+ */
+static void run_shaped(const char* name, motion_controller_config_t config,
+                       const std::function<void(motion_controller_handle_t)>& move) {
+    const motion_shaper_type_t shaper = config.shaper;
+    const int32_t x0 = motor_x->getPosition();
+    const int32_t y0 = motor_y->getPosition();
+    double ms[2] = {};
+
+    for (int shaped = 0; shaped < 2; shaped++) {
+        move_linear({{0, x0}, {1, y0}});
+        config.shaper = shaped ? shaper : MOTION_SHAPER_NONE;
+        motion_controller_handle_t controller = motion_controller_init(&config);
+        if (controller == nullptr) {
+            return;
+        }
+        std::string label = std::string(name) + (shaped ? " shaped" : " plain");
+        ms[shaped] = run(label.c_str(), [&] { move(controller); });
+        motion_controller_deinit(controller);
+    }
+    printf("  shaped %.3f ms, plain %.3f ms (%+.1f %%)\n", ms[1], ms[0], (ms[1] / ms[0] - 1.0) * 100.0);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            s_csv = fopen(argv[++i], "w");
+            if (s_csv == nullptr) {
+                perror(argv[i]);
+                return 1;
+            }
+            fprintf(s_csv, "move,axis,time_us,rate_hz\n");
+        } else {
+            fprintf(stderr, "usage: %s [--csv FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#if CONFIG_STEPPER_BACKEND_MULTI_AXIS
+    printf("backend: multi-axis shared timer\n");
+#else
+    printf("backend: gptimer per motor\n");
+#endif
+    printf("limits: X/Y %d mm/s, Z %d mm/s, %d mm/s^2, pulse %d us\n\n",
+           CONFIG_MOTION_MAX_VELOCITY_X_MM_S, CONFIG_MOTION_MAX_VELOCITY_Z_MM_S,
+           CONFIG_MOTION_MAX_ACCELERATION_MM_S2, CONFIG_STEPPER_PULSE_WIDTH_US);
+    printf("high / interval columns: min/mean/max\n\n");
+
+    init_axes();
+    motor_x = s_axes[0].motor;
+    motor_y = s_axes[1].motor;
+    motor_z = s_axes[2].motor;
+
+    motion_controller_config_t motion_config = {};
+    motion_config.max_velocity_x = CONFIG_MOTION_MAX_VELOCITY_X_MM_S;
+    motion_config.max_velocity_y = CONFIG_MOTION_MAX_VELOCITY_Y_MM_S;
+    motion_config.max_velocity_z = CONFIG_MOTION_MAX_VELOCITY_Z_MM_S;
+    motion_config.max_acceleration = CONFIG_MOTION_MAX_ACCELERATION_MM_S2;
+    motion_config.max_jerk = CONFIG_MOTION_MAX_JERK_MM_S3;
+    motion_config.junction_deviation = CONFIG_MOTION_JUNCTION_DEVIATION_UM / 1000.0;
+    motion_config.profile_z = STEPPER_PROFILE_S_CURVE;
+    motion_config.steps_per_mm_x = CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+    motion_config.steps_per_mm_y = CONFIG_MOTOR_Y_MICROSTEPS_IN_MM;
+    motion_config.steps_per_mm_z = CONFIG_MOTOR_Z_MICROSTEPS_IN_MM;
+    motion_config.work_area_x_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_X_MM);
+    motion_config.work_area_y_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_Y_MM);
+    motion_config.work_area_z_max = COORD_UM_FROM_MM(CONFIG_MOTION_WORK_AREA_Z_MM);
+    motion_config.homing_seek_velocity = CONFIG_MOTION_HOMING_SEEK_MM_S;
+    motion_config.homing_locate_velocity = CONFIG_MOTION_HOMING_LOCATE_MM_S;
+    motion_config.homing_pull_off = COORD_UM_FROM_MM(CONFIG_MOTION_HOMING_PULL_OFF_MM);
+    motion_controller_handle_t controller = motion_controller_init(&motion_config);
+    if (controller == nullptr) {
+        return 1;
+    }
+
+    const int32_t x_mm = CONFIG_MOTOR_X_MICROSTEPS_IN_MM;
+    const int32_t y_mm = CONFIG_MOTOR_Y_MICROSTEPS_IN_MM;
+    const int32_t z_mm = CONFIG_MOTOR_Z_MICROSTEPS_IN_MM;
+
+    run("X 1 mm", [&] { move_linear({{0, 1 * x_mm}}); });
+    run("X 10 mm", [&] { move_linear({{0, 11 * x_mm}}); });
+    run("X 100 mm", [&] { move_linear({{0, 111 * x_mm}}); });
+    run("X -111 mm (reverse)", [&] { move_linear({{0, 0}}); });
+    run("Z 5 mm", [&] { move_linear({{2, 5 * z_mm}}); });
+    run("XY 50 x 30 mm linear", [&] { move_linear({{0, 50 * x_mm}, {1, 30 * y_mm}}); });
+    run("XYZ back to 0 linear", [&] { move_linear({{0, 0}, {1, 0}, {2, 0}}); });
+    run("Z 25 mm queued, timed", [&] { move_queued_timed(2, 25 * z_mm); });
+    run("X 5 x 10 mm chain @ 50 mm/s", [&] { move_chain(10 * x_mm, 5, 50.0); });
+    run("X 200 single steps", [&] { move_single_steps(200); });
+    run("X home, switch 20 mm away", [&] { move_home(20 * x_mm); });
+    run("X 5 mm and back, 0.2 mm play", [&] { move_backlash(200, 5 * x_mm); });
+
+    // Longer than the look-ahead plus a default (8) segment queue
+    const int chain = CONFIG_MOTION_LOOKAHEAD_DEPTH + 8 + 8;
+    run("XY 24 x 5 mm G0 via planner", [&] {
+        move_planner_chain(controller, chain, [](int i) {
+            return std::make_pair(10.0 + 5.0 * ((i + 1) / 2), 10.0 + 5.0 * (i / 2));
+        });
+    });
+    run("Z 500 steps after a stream", [&] { move_after_stream(500); });
+    run("XY 12 x 5 mm zigzag, X play", [&] { move_planner_zigzag(controller, 12, 5.0, 200); });
+    run("XY 12 x 5 mm zigzag, no play", [&] { move_planner_zigzag(controller, 12, 5.0, 0); });
+    motion_controller_deinit(controller);
+
+    // Shaped moves go out piece by piece and only once the queue holds two
+    // of them (14 slots for ZV, 22 for ZVD, 32 by default here)
+    motion_config.shaper = MOTION_SHAPER_ZV;
+    motion_config.shaper_frequency_x = 40.0;
+    motion_config.shaper_frequency_y = 40.0;
+    motion_config.shaper_damping_x = 0.1;
+    motion_config.shaper_damping_y = 0.1;
+    run_shaped("XY 24 x 5 mm G0, ZV", motion_config, [&](motion_controller_handle_t shaped) {
+        move_planner_chain(shaped, chain, [](int i) {
+            return std::make_pair(10.0 + 5.0 * ((i + 1) / 2), 10.0 + 5.0 * (i / 2));
+        });
+    });
+    motion_config.shaper = MOTION_SHAPER_ZVD;
+    run_shaped("XY 12 x 5 mm zigzag, ZVD", motion_config, [&](motion_controller_handle_t shaped) {
+        move_planner_zigzag(shaped, 12, 5.0, 0);
+    });
+
+    if (s_csv) {
+        fclose(s_csv);
+    }
+    return 0;
+}
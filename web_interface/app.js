@@ -203,6 +203,10 @@ async function handleSendToController() {
             const result = await response.json();
             const commandCount = cleanGCode.split('\n').length;
             sendStatus.textContent = `Success: G-Code uploaded to controller (${commandCount} commands)`;
+            if (result.tour && result.tour.reordered) {
+                sendStatus.textContent += `, ${result.tour.points} points reordered: ` +
+                    `travel ${result.tour.travel_before_s.toFixed(1)} s -> ${result.tour.travel_after_s.toFixed(1)} s`;
+            }
             sendStatus.className = 'upload-status success';
 
             // Enable start button